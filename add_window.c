@@ -96,6 +96,7 @@
 #include "icons.h"
 #include "iconmgr.h"
 #include "session.h"
+#include "etwm.h"
 
 #define gray_width 2
 #define gray_height 2
@@ -111,6 +112,7 @@ unsigned int AddingH;
 
 static int PlaceX = -1;
 static int PlaceY = -1;
+static Bool SmartPlaceWindow (TwmWindow *tmp_win, int *final_x, int *final_y);
 static void CreateWindowTitlebarButtons(TwmWindow *tmp_win);
 void DealWithNonSensicalGeometries(Display *dpy, Window vroot, TwmWindow *tmp_win);
 
@@ -175,6 +177,42 @@ void GetGravityOffsets (TwmWindow *tmp,	/* window from which to get gravity */
 
 
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	PrefetchWindowProperties - queue the reads of all the client
+ *	properties that AddWindow looks at, so that they cost one round
+ *	trip between them rather than one each
+ *
+ *  Inputs:
+ *	w	- the window id of the window to add
+ *
+ ***********************************************************************
+ */
+
+void PrefetchWindowProperties (Window w)
+{
+    Atom atoms [10];
+
+    atoms [0] = XA_WM_NAME;
+    atoms [1] = XA_WM_ICON_NAME;
+    atoms [2] = XA_WM_CLASS;
+    atoms [3] = XA_WM_HINTS;
+    atoms [4] = XA_WM_NORMAL_HINTS;
+    atoms [5] = XA_WM_TRANSIENT_FOR;
+    atoms [6] = _XA_WM_PROTOCOLS;
+    atoms [7] = _XA_WM_COLORMAP_WINDOWS;
+    atoms [8] = _XA_WM_CLIENT_LEADER;
+    atoms [9] = _XA_WM_WINDOW_ROLE;
+    PrefetchProperties (w, atoms, 10);
+#ifdef EWMH
+    PrefetchWindowEwmh (w);
+#endif				/* EWMH */
+}
+
+
+
+
 /***********************************************************************
  *
  *  Procedure:
@@ -218,6 +256,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     Bool height_ever_changed_by_user;
     int saved_occupation; /* <== [ Matthew McNeill Feb 1997 ] == */
     Bool        random_placed = False;
+    int		placex, placey;
     int		found = 0;
 #ifndef VMS
     fd_set	mask;
@@ -271,10 +310,11 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     tmp_win->occupation = 0;
 
     XSelectInput(dpy, tmp_win->w, PropertyChangeMask);
+    PrefetchWindowProperties (tmp_win->w);
     XGetWindowAttributes(dpy, tmp_win->w, &tmp_win->attr);
     tmp_win->name = (char*) GetWMPropertyString(tmp_win->w, XA_WM_NAME);
     tmp_win->class = NoClass;
-    XGetClassHint(dpy, tmp_win->w, &tmp_win->class);
+    TwmGetClassHint(dpy, tmp_win->w, &tmp_win->class);
     FetchWmProtocols (tmp_win);
     FetchWmColormapWindows (tmp_win);
 
@@ -315,7 +355,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     if (tmp_win->attr.height > Scr->MaxWindowHeight)
       tmp_win->attr.height = Scr->MaxWindowHeight;
 
-    tmp_win->wmhints = XGetWMHints(dpy, tmp_win->w);
+    tmp_win->wmhints = TwmGetWMHints(dpy, tmp_win->w);
 
     if (tmp_win->wmhints)
     {
@@ -397,68 +437,60 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 
     namelen = strlen (tmp_win->name);
 
-    if (LookInList(Scr->IgnoreTransientL, tmp_win->full_name, &tmp_win->class))
+    GetWindowPolicy (tmp_win);
+
+    if (tmp_win->policy.ignore_transient)
       tmp_win->transient = 0;
 
-    tmp_win->highlight = Scr->Highlight && 
-	(!LookInList(Scr->NoHighlight, tmp_win->full_name, 
-	    &tmp_win->class));
+    tmp_win->highlight = Scr->Highlight && !tmp_win->policy.no_highlight;
 
-    tmp_win->stackmode = Scr->StackMode &&
-	(!LookInList(Scr->NoStackModeL, tmp_win->full_name, 
-	    &tmp_win->class));
+    tmp_win->stackmode = Scr->StackMode && !tmp_win->policy.no_stack_mode;
 
-    if (LookInList(Scr->AlwaysOnTopL, tmp_win->full_name, &tmp_win->class)) {
+    if (tmp_win->policy.always_on_top) {
 	tmp_win->ontoppriority = ETWM_LAYER_DOCK;
 	tmp_win->initial_layer = ETWM_LAYER_DOCK;
     }
 
-    tmp_win->titlehighlight = Scr->TitleHighlight && 
-	(!LookInList(Scr->NoTitleHighlight, tmp_win->full_name, 
-	    &tmp_win->class));
+    tmp_win->titlehighlight = Scr->TitleHighlight &&
+	!tmp_win->policy.no_title_highlight;
 
-    tmp_win->auto_raise = Scr->AutoRaiseDefault ||
-	LookInList(Scr->AutoRaise, tmp_win->full_name,
-			      &tmp_win->class);
+    tmp_win->auto_raise = Scr->AutoRaiseDefault || tmp_win->policy.auto_raise;
     if (tmp_win->auto_raise) Scr->NumAutoRaises++;
 
-    tmp_win->auto_lower = Scr->AutoLowerDefault ||
-	LookInList(Scr->AutoLower, tmp_win->full_name,
-			      &tmp_win->class);
+    tmp_win->auto_lower = Scr->AutoLowerDefault || tmp_win->policy.auto_lower;
     if (tmp_win->auto_lower) Scr->NumAutoLowers++;
 
     tmp_win->iconify_by_unmapping = Scr->IconifyByUnmapping;
     if (Scr->IconifyByUnmapping)
     {
 	tmp_win->iconify_by_unmapping = iconm ? FALSE :
-	    !LookInList(Scr->DontIconify, tmp_win->full_name,
-		&tmp_win->class);
+	    !tmp_win->policy.dont_iconify;
     }
     tmp_win->iconify_by_unmapping = tmp_win->iconify_by_unmapping ||
-	LookInList(Scr->IconifyByUn, tmp_win->full_name, &tmp_win->class);
+	tmp_win->policy.iconify_by_unmapping;
 
-    if (LookInList (Scr->UnmapByMovingFarAway, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.unmap_by_moving_far_away)
 	tmp_win->UnmapByMovingFarAway = True;
     else
 	tmp_win->UnmapByMovingFarAway = False;
 
-    if (LookInList (Scr->DontSetInactive, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.dont_set_inactive)
 	tmp_win->DontSetInactive = True;
     else
 	tmp_win->DontSetInactive = False;
 
-    if (LookInList (Scr->AutoSqueeze, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.auto_squeeze)
 	tmp_win->AutoSqueeze = True;
     else
 	tmp_win->AutoSqueeze = False;
 
-    if (LookInList (Scr->StartSqueezed, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.start_squeezed)
 	tmp_win->StartSqueezed = True;
     else
 	tmp_win->StartSqueezed = False;
 
     if (Scr->AlwaysSqueezeToGravity
-	|| LookInList (Scr->AlwaysSqueezeToGravityL, tmp_win->full_name, &tmp_win->class))
+	|| tmp_win->policy.always_squeeze_to_gravity)
 	tmp_win->AlwaysSqueezeToGravity = True;
     else
 	tmp_win->AlwaysSqueezeToGravity = False;
@@ -469,9 +501,8 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 	if (!t && tmp_win->group) t = GetTwmWindow(tmp_win->group);
 	if (t) tmp_win->UnmapByMovingFarAway = t->UnmapByMovingFarAway;
     }
-    if (iswman || LookInList(Scr->WindowRingExcludeL, tmp_win->full_name, &tmp_win->class)
-	|| (!Scr->WindowRingAll
-	    && !LookInList(Scr->WindowRingL, tmp_win->full_name, &tmp_win->class)))
+    if (iswman || tmp_win->policy.window_ring_exclude
+	|| (!Scr->WindowRingAll && !tmp_win->policy.window_ring))
 	tmp_win->list.list.window = 0;
 
     if (tmp_win->list.list.window) {
@@ -495,8 +526,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
      * since it is coming from the screen list
      */
     if (HasShape) {
-	if (!LookInList (Scr->DontSqueezeTitleL, tmp_win->full_name, 
-			 &tmp_win->class)) {
+	if (!tmp_win->policy.dont_squeeze_title) {
 	    tmp_win->squeeze_info = (SqueezeInfo *)
 	      LookInList (Scr->SqueezeTitleL, tmp_win->full_name,
 			  &tmp_win->class);
@@ -508,7 +538,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 	}
       }
 
-    if (LookInList(Scr->NoBorder, tmp_win->full_name, &tmp_win->class)) {
+    if (tmp_win->policy.no_border) {
 	tmp_win->decor.decoration.border = 0;
 	tmp_win->decor.decoration.resizeh = 0;
     }
@@ -533,9 +563,8 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     }
     bw2 = tmp_win->frame_bw * 2;
 
-    if ((Scr->NoTitlebar
-	 && !LookInList(Scr->MakeTitle, tmp_win->full_name, &tmp_win->class))
-	|| LookInList(Scr->NoTitle, tmp_win->full_name, &tmp_win->class)
+    if ((Scr->NoTitlebar && !tmp_win->policy.make_title)
+	|| tmp_win->policy.no_title
 	|| (tmp_win->transient && !Scr->DecorateTransients))
 	tmp_win->decor.decoration.titlebar = 0;
 
@@ -545,20 +574,20 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 	tmp_win->title_height = 0;
 
     tmp_win->OpaqueMove = Scr->DoOpaqueMove;
-    if (LookInList(Scr->OpaqueMoveList, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.opaque_move)
 	tmp_win->OpaqueMove = TRUE;
     else
-    if (LookInList(Scr->NoOpaqueMoveList, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.no_opaque_move)
 	tmp_win->OpaqueMove = FALSE;
 
     tmp_win->OpaqueResize = Scr->DoOpaqueResize;
-    if (LookInList(Scr->OpaqueResizeList, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.opaque_resize)
 	tmp_win->OpaqueResize = TRUE;
     else
-    if (LookInList(Scr->NoOpaqueResizeList, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.no_opaque_resize)
 	tmp_win->OpaqueResize = FALSE;
 
-    if (LookInList(Scr->StartIconified, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.start_iconified)
     {
 	if (!tmp_win->wmhints)
 	{
@@ -653,6 +682,16 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
      */
 
     if (HandlingEvents && ask_user && !restoredFromPrevSession) {
+      if (Scr->SmartPlacement && !winbox &&
+	  SmartPlaceWindow (tmp_win, &placex, &placey)) {
+	/* SmartPlaceWindow gives the frame position, undo what is done
+	   to attr when the frame is created */
+	tmp_win->attr.x = placex - tmp_win->old_bw + tmp_win->frame_bw +
+			  tmp_win->frame_bw3D;
+	tmp_win->attr.y = placey - tmp_win->old_bw + tmp_win->frame_bw +
+			  tmp_win->frame_bw3D + tmp_win->title_height;
+	random_placed = True;
+      } else
       if ((Scr->RandomPlacement == RP_ALL) ||
           ((Scr->RandomPlacement == RP_UNMAPPED) &&
 	   ((tmp_win->wmhints && (tmp_win->wmhints->initial_state == IconicState)) ||
@@ -1012,6 +1051,8 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 		lasty = -10000;
 		while (TRUE)
 		{
+		    HandleSyncAlarms ();
+		    WMapFlush ();
 		    XMaskEvent(dpy,
 			       ButtonReleaseMask | ButtonMotionMask, &event);
 
@@ -1115,6 +1156,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     tmp_win->icon_name = (char*) GetWMPropertyString(tmp_win->w, XA_WM_ICON_NAME);
     if (!tmp_win->icon_name)
 	tmp_win->icon_name = tmp_win->name;
+    ReleaseProperties (tmp_win->w);
 
 #ifdef CLAUDE
     if (strstr (tmp_win->icon_name, " - Mozilla")) {
@@ -1122,6 +1164,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
       *moz = '\0';
     }
 #endif
+    GetWindowIconPolicy (tmp_win);
 
     XmbTextExtents (Scr->TitleBarFont.font_set, tmp_win->name, namelen, &ink_rect, &logical_rect);
     tmp_win->name_width = logical_rect.width;
@@ -1241,6 +1284,7 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
 				    Scr->d_depth,
 				    (unsigned int) CopyFromParent,
 				    Scr->d_visual, valuemask, &attributes);
+    StackAddWindow (tmp_win, vroot);
     
     if (tmp_win->title_height)
     {
@@ -1300,10 +1344,8 @@ TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp)
     }
 
     valuemask = (CWEventMask | CWDontPropagate | CWBackingStore | CWWinGravity);
-    attributes.event_mask = (StructureNotifyMask | PropertyChangeMask |
-			     ColormapChangeMask | VisibilityChangeMask |
-			     FocusChangeMask | 
-			     EnterWindowMask | LeaveWindowMask);
+    tmp_win->eventmask = CLIENT_EVENT_MASK;
+    attributes.event_mask = tmp_win->eventmask;
     attributes.do_not_propagate_mask = ButtonPressMask | ButtonReleaseMask | PointerMotionMask;
     attributes.backing_store = NotUseful;
     attributes.win_gravity = NorthWestGravity;
@@ -1499,156 +1541,141 @@ void AddDefaultBindings (void)
 
 /***********************************************************************
  *
- *  Procedure:
- *	GrabButtons - grab needed buttons for the window
+ *  Grab manager
  *
- *  Inputs:
- *	tmp_win - the twm window structure to use
+ *  A binding is grabbed once for every combination of the ignored
+ *  modifiers (IgnoreModifier, and Lock with IgnoreLockModifier) that it
+ *  does not use itself; the combinations are only computed again when
+ *  the ignored modifiers change.  A key bound to a window name does the
+ *  same whatever window it is typed in: when it is bound in no other
+ *  context it is grabbed once on the root window rather than on every
+ *  managed window.  GrabCount counts the passive grabs requested, for
+ *  f.dumpstats.
  *
  ***********************************************************************
  */
 
 #define AltMask (Alt1Mask | Alt2Mask | Alt3Mask | Alt4Mask | Alt5Mask)
+#define ModifierBits (ShiftMask | LockMask | ControlMask | Mod1Mask | \
+		      Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
 #define grabbutton(button, modifier, window, pointer_mode) \
 	XGrabButton (dpy, button, modifier, window,  \
 		True, ButtonPressMask | ButtonReleaseMask, \
 		pointer_mode, GrabModeAsync, None,  \
 		Scr->FrameCursor);
 
-void GrabButtons(TwmWindow *tmp_win)
+unsigned long GrabCount = 0;
+
+static unsigned int GrabMasks [1 << 8];
+static int          NumGrabMasks = 0;
+static unsigned int GrabMasksIgnored = (unsigned int) -1;
+
+static void ComputeGrabMasks (void)
+{
+    unsigned int ignored, mask;
+
+    ignored = Scr->IgnoreModifier & ModifierBits;
+    if (Scr->IgnoreLockModifier) ignored |= LockMask;
+    if (ignored == GrabMasksIgnored) return;
+
+    GrabMasksIgnored = ignored;
+    NumGrabMasks = 0;
+    mask = 0;
+    do {				/* every subset of ignored */
+	GrabMasks [NumGrabMasks++] = mask;
+	mask = (mask - ignored) & ignored;
+    } while (mask != 0);
+}
+
+static void GrabButtonMasks (int button, unsigned int mods, Window w,
+			     int pointer_mode)
 {
-    FuncButton *tmp;
     int i;
-    unsigned int ModifierMask[8] = { ShiftMask, ControlMask, LockMask,
-				     Mod1Mask, Mod2Mask, Mod3Mask, Mod4Mask,
-				     Mod5Mask };
 
-    for (tmp = Scr->FuncButtonRoot.next; tmp != NULL; tmp = tmp->next) {
-	if ((tmp->cont != C_WINDOW) || (tmp->func == 0)) continue;
-	grabbutton (tmp->num, tmp->mods, tmp_win->frame, GrabModeAsync);
-	    
-	if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask)) {
-	    grabbutton (tmp->num, tmp->mods | LockMask, tmp_win->frame, GrabModeAsync);
-	}
-	for (i = 0 ; i < 8 ; i++) {
-	    if ((Scr->IgnoreModifier & ModifierMask [i]) && !(tmp->mods & ModifierMask [i]))
-		grabbutton (tmp->num, tmp->mods | ModifierMask [i],
-			  tmp_win->frame, GrabModeAsync);
-	}
+    ComputeGrabMasks ();
+    for (i = 0; i < NumGrabMasks; i++) {
+	if (GrabMasks [i] & mods) continue;
+	grabbutton (button, mods | GrabMasks [i], w, pointer_mode);
+	GrabCount++;
     }
-    if (Scr->ClickToFocus) {
-	grabbutton (AnyButton, None, tmp_win->w, GrabModeSync);
-	for (i = 0 ; i < 8 ; i++) {
-	    grabbutton (AnyButton, ModifierMask [i], tmp_win->w, GrabModeSync);
-	}
-    } else
-    if (Scr->RaiseOnClick) {
-	grabbutton (Scr->RaiseOnClickButton, None, tmp_win->w, GrabModeSync);
-	for (i = 0 ; i < 8 ; i++) {
-	    grabbutton (Scr->RaiseOnClickButton,
-			ModifierMask [i], tmp_win->w, GrabModeSync);
+}
+
+static void GrabKeyMasks (FuncKey *key, Window w, Bool grab)
+{
+    int i;
+
+    if (key->keycode == 0) return;	/* that would be AnyKey */
+    ComputeGrabMasks ();
+    for (i = 0; i < NumGrabMasks; i++) {
+	if (GrabMasks [i] & key->mods) continue;
+	if (grab) {
+	    XGrabKey (dpy, key->keycode, key->mods | GrabMasks [i], w, True,
+		      GrabModeAsync, GrabModeAsync);
+	    GrabCount++;
 	}
+	else
+	    XUngrabKey (dpy, key->keycode, key->mods | GrabMasks [i], w);
     }
 }
 
-/***********************************************************************
- *
- *  Procedure:
- *	GrabKeys - grab needed keys for the window
- *
- *  Inputs:
- *	tmp_win - the twm window structure to use
- *
- ***********************************************************************
+/*
+ * Whether the key of a binding is also bound, with the same modifiers, in
+ * context cont, or in any context but C_NAME when cont is C_NO_CONTEXT.
  */
+static Bool KeyAlsoBound (FuncKey *key, int cont)
+{
+    FuncKey *tmp;
 
-#define MAX_KEYCODE 256
-#define grabkey(funckey, modifier, window) \
-	XGrabKey(dpy, funckey->keycode, funckey->mods | modifier, window, True, \
-		GrabModeAsync, GrabModeAsync);
-#define ungrabkey(funckey, modifier, window) \
-	XUngrabKey (dpy, funckey->keycode, funckey->mods | modifier, window);
+    for (tmp = Scr->FuncKeyHash [KEY_HASH (key->keycode, key->mods)];
+	 tmp != NULL; tmp = tmp->hnext) {
+	if (tmp == key || tmp->keycode != key->keycode || tmp->mods != key->mods)
+	    continue;
+	if (cont == C_NO_CONTEXT ? tmp->cont != C_NAME : tmp->cont == cont)
+	    return True;
+    }
+    return False;
+}
 
-void GrabKeys(TwmWindow *tmp_win)
+static Bool RootGrabbable (FuncKey *key)
 {
-    FuncKey *tmp;
-    IconMgr *p;
-    int i;
-    unsigned int ModifierMask[8] = { ShiftMask, ControlMask, LockMask,
-				     Mod1Mask, Mod2Mask, Mod3Mask, Mod4Mask,
-				     Mod5Mask };
+    return (key->cont == C_NAME && !(key->mods & AltMask) &&
+	    !KeyAlsoBound (key, C_NO_CONTEXT));
+}
 
-    for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next)
-    {
-	switch (tmp->cont)
-	{
+/*
+ * Grab or ungrab one key on the windows of tmp_win its context needs.
+ * The icon manager bindings win over the others on the icon managers.
+ */
+static void GrabKeyWindows (FuncKey *key, TwmWindow *tmp_win, Bool grab)
+{
+    Bool iconmgrkey;
+
+    iconmgrkey = tmp_win->iconmgr && !Scr->NoIconManagers &&
+		 KeyAlsoBound (key, C_ICONMGR);
+    switch (key->cont) {
 	case C_WINDOW:
 	/* case C_WORKSPACE: */
-	    if (tmp->mods & AltMask) break;
-	    grabkey (tmp, 0, tmp_win->w);
-	    if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		grabkey (tmp, LockMask, tmp_win->w);
-	    for (i = 0 ; i < 8 ; i++) {
-		if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-		    !(tmp->mods & ModifierMask [i]))
-		  grabkey (tmp, ModifierMask [i], tmp_win->w);
-	    }
+	    if (key->mods & AltMask) break;
+	    if (!iconmgrkey) GrabKeyMasks (key, tmp_win->w, grab);
 	    break;
 
 	case C_ICON:
-	    if (!tmp_win->icon || tmp_win->icon->w) break;
-	    grabkey (tmp, 0, tmp_win->icon->w);
-	    if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		grabkey (tmp, LockMask, tmp_win->icon->w);
-	    for (i = 0 ; i < 8 ; i++) {
-		if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-		    !(tmp->mods & ModifierMask [i]))
-		    grabkey (tmp, ModifierMask [i], tmp_win->icon->w);
-	    }
+	    if (!tmp_win->icon || !tmp_win->icon->w) break;
+	    GrabKeyMasks (key, tmp_win->icon->w, grab);
 	    break;
 
 	case C_TITLE:
 	    if (!tmp_win->title_w) break;
-	    grabkey (tmp, 0, tmp_win->title_w);
-	    if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		grabkey (tmp, LockMask, tmp_win->title_w);
-	    for (i = 0 ; i < 8 ; i++) {
-		if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-		    !(tmp->mods & ModifierMask [i]))
-		    grabkey (tmp, ModifierMask [i], tmp_win->title_w);
-	    }
+	    GrabKeyMasks (key, tmp_win->title_w, grab);
 	    break;
 
 	case C_NAME:
-	    grabkey (tmp, 0, tmp_win->w);
-	    if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask)) {
-		grabkey (tmp, LockMask, tmp_win->w);
-	    }
-	    for (i = 0 ; i < 8 ; i++) {
-		if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-		    !(tmp->mods & ModifierMask [i]))
-		    grabkey (tmp, ModifierMask [i], tmp_win->w);
-	    }
-	    if (tmp_win->icon && tmp_win->icon->w) {
-		grabkey (tmp, 0, tmp_win->icon->w);
-		if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		    grabkey (tmp, LockMask, tmp_win->icon->w);
-		for (i = 0 ; i < 8 ; i++) {
-		    if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-			!(tmp->mods & ModifierMask [i]))
-			grabkey (tmp, ModifierMask [i], tmp_win->icon->w);
-		}
-	    }
-	    if (tmp_win->title_w) {
-		grabkey (tmp, 0, tmp_win->title_w);
-		if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		    grabkey (tmp, LockMask, tmp_win->title_w);
-		for (i = 0 ; i < 8 ; i++) {
-		    if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-			!(tmp->mods & ModifierMask [i]))
-			grabkey (tmp, ModifierMask [i], tmp_win->title_w);
-		}
-	    }
+	    if (key->rootgrab) break;
+	    if (!iconmgrkey) GrabKeyMasks (key, tmp_win->w, grab);
+	    if (tmp_win->icon && tmp_win->icon->w)
+		GrabKeyMasks (key, tmp_win->icon->w, grab);
+	    if (tmp_win->title_w)
+		GrabKeyMasks (key, tmp_win->title_w, grab);
 	    break;
 	/*
 	case C_ROOT:
@@ -1656,24 +1683,137 @@ void GrabKeys(TwmWindow *tmp_win)
 		GrabModeAsync, GrabModeAsync);
 	    break;
 	*/
-	}
     }
+}
+
+static void GrabKeyEverywhere (FuncKey *key, Bool grab)
+{
+    TwmWindow *tmp_win;
+
+    if (key->rootgrab) {
+	GrabKeyMasks (key, Scr->Root, grab);
+	return;
+    }
+    for (tmp_win = Scr->FirstWindow; tmp_win != NULL; tmp_win = tmp_win->next)
+	GrabKeyWindows (key, tmp_win, grab);
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	GrabButtons - grab needed buttons for the window
+ *
+ *  Inputs:
+ *	tmp_win - the twm window structure to use
+ *
+ ***********************************************************************
+ */
+
+void GrabButtons(TwmWindow *tmp_win)
+{
+    FuncButton *tmp;
+
+    for (tmp = Scr->FuncButtonRoot.next; tmp != NULL; tmp = tmp->next) {
+	if ((tmp->cont != C_WINDOW) || (tmp->func == 0)) continue;
+	GrabButtonMasks (tmp->num, tmp->mods, tmp_win->frame, GrabModeAsync);
+    }
+    if (Scr->ClickToFocus) {
+	grabbutton (AnyButton, AnyModifier, tmp_win->w, GrabModeSync);
+	GrabCount++;
+    } else
+    if (Scr->RaiseOnClick) {
+	grabbutton (Scr->RaiseOnClickButton, AnyModifier, tmp_win->w, GrabModeSync);
+	GrabCount++;
+    }
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	GrabKeys - grab needed keys for the window
+ *
+ *  Inputs:
+ *	tmp_win - the twm window structure to use
+ *
+ ***********************************************************************
+ */
+
+void GrabKeys(TwmWindow *tmp_win)
+{
+    FuncKey *tmp;
+
     for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next)
-    {
-	if (tmp->cont == C_ICONMGR && !Scr->NoIconManagers)
-	{
-	    for (p = Scr->iconmgr; p != NULL; p = p->next) {
-		ungrabkey (tmp, 0, p->twm_win->w);
-		if (Scr->IgnoreLockModifier && !(tmp->mods & LockMask))
-		    ungrabkey (tmp, LockMask, p->twm_win->w);
-		for (i = 0 ; i < 8 ; i++) {
-		    if ((Scr->IgnoreModifier & ModifierMask [i]) &&
-			!(tmp->mods & ModifierMask [i]))
-			ungrabkey (tmp, ModifierMask [i], p->twm_win->w);
-		}
-	    }
+	GrabKeyWindows (tmp, tmp_win, True);
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	GrabRootKeys - grab on the root window the keys that can be,
+ *		once the bindings are all known
+ *
+ ***********************************************************************
+ */
+
+void GrabRootKeys (void)
+{
+    FuncKey *tmp;
+
+    for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next) {
+	tmp->rootgrab = RootGrabbable (tmp);
+	if (tmp->rootgrab) GrabKeyMasks (tmp, Scr->Root, True);
+    }
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	RefreshKeyGrabs - follow a change of the keyboard mapping
+ *
+ *  Only the bindings whose keycode moved, and those sharing one of the
+ *  keycodes involved, are ungrabbed and grabbed again.
+ *
+ *  Inputs:
+ *	event - the MappingNotify event
+ *
+ ***********************************************************************
+ */
+
+#define KEYCODE_BIT(k)	(touched [(k) / 8] & (1 << ((k) % 8)))
+
+void RefreshKeyGrabs (XMappingEvent *event)
+{
+    ScreenInfo    *savedScr = Scr;
+    unsigned char touched [256 / 8];
+    FuncKey       *tmp;
+    KeyCode       keycode;
+    int           scrnum;
+
+    XRefreshKeyboardMapping (event);
+    if (event->request != MappingKeyboard) return;
+
+    for (scrnum = 0; scrnum < NumScreens; scrnum++) {
+	if ((Scr = ScreenList [scrnum]) == NULL) continue;
+	memset (touched, 0, sizeof (touched));
+	for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next) {
+	    keycode = XKeysymToKeycode (dpy, tmp->keysym);
+	    if (keycode == tmp->keycode) continue;
+	    touched [tmp->keycode / 8] |= 1 << (tmp->keycode % 8);
+	    touched [keycode / 8]      |= 1 << (keycode % 8);
+	}
+	for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next) {
+	    if (KEYCODE_BIT (tmp->keycode)) GrabKeyEverywhere (tmp, False);
+	}
+	for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next)
+	    tmp->keycode = XKeysymToKeycode (dpy, tmp->keysym);
+	HashFuncKeys ();
+	for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next) {
+	    if (! KEYCODE_BIT (tmp->keycode)) continue;
+	    tmp->rootgrab = RootGrabbable (tmp);
+	    GrabKeyEverywhere (tmp, True);
 	}
     }
+    Scr = savedScr;
 }
 
 void ComputeCommonTitleOffsets (void)
@@ -1789,10 +1929,10 @@ void DeleteHighlightWindows(TwmWindow *tmp_win)
     if (tmp_win->HiliteImage) {
 	if (Scr->HighlightPixmapName) {
 	    /*
-	     * Image obtained from GetImage(): it is in a cache
-	     * so we don't need to free it. There will not be multiple
-	     * copies if the same xpm:foo image is requested again.
+	     * Image obtained from GetImage(): drop our reference
+	     * and let the image cache decide when to free it.
 	     */
+	    ReleaseImage (tmp_win->HiliteImage);
 	} else {
 	    XFreePixmap (dpy, tmp_win->HiliteImage->pixmap);
 	    free(tmp_win->HiliteImage);
@@ -2059,13 +2199,151 @@ void SetHighlightPixmap (char *filename)
 }
 
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	GetWindowPolicy - evaluate the boolean name lists for a window
+ *
+ *  Inputs:
+ *	tmp	- the window to evaluate
+ *
+ *  Special Considerations
+ *	Must be called again whenever full_name or class change.  The
+ *	icon name part is kept up to date by GetWindowIconPolicy.
+ *
+ ***********************************************************************
+ */
+
+/*
+ * The boolean name lists making up a WindowPolicy, in the order they are
+ * given to the screen PolicyLists matcher.
+ */
+enum {
+    WPL_IGNORE_TRANSIENT, WPL_NO_HIGHLIGHT, WPL_NO_STACK_MODE,
+    WPL_ALWAYS_ON_TOP, WPL_NO_TITLE_HIGHLIGHT, WPL_AUTO_RAISE,
+    WPL_AUTO_LOWER, WPL_DONT_ICONIFY, WPL_ICONIFY_BY_UNMAPPING,
+    WPL_UNMAP_BY_MOVING_FAR_AWAY, WPL_DONT_SET_INACTIVE, WPL_AUTO_SQUEEZE,
+    WPL_START_SQUEEZED, WPL_ALWAYS_SQUEEZE_TO_GRAVITY, WPL_WINDOW_RING,
+    WPL_WINDOW_RING_EXCLUDE, WPL_DONT_SQUEEZE_TITLE, WPL_NO_BORDER,
+    WPL_MAKE_TITLE, WPL_NO_TITLE, WPL_OPAQUE_MOVE, WPL_NO_OPAQUE_MOVE,
+    WPL_OPAQUE_RESIZE, WPL_NO_OPAQUE_RESIZE, WPL_START_ICONIFIED,
+    WPL_NO_ICON_TITLE, WPL_WARP_ON_DEICONIFY, WPL_WARP_CURSOR,
+    WPL_ICON_MGR_NO_SHOW, WPL_ICON_MGR_SHOW, WPL_ICON_MENU_DONT_SHOW,
+    WPL_OCCUPY_ALL,
+    WPL_COUNT
+};
+
+static void GetPolicyLists (name_list **l)
+{
+    l [WPL_IGNORE_TRANSIENT]		= Scr->IgnoreTransientL;
+    l [WPL_NO_HIGHLIGHT]		= Scr->NoHighlight;
+    l [WPL_NO_STACK_MODE]		= Scr->NoStackModeL;
+    l [WPL_ALWAYS_ON_TOP]		= Scr->AlwaysOnTopL;
+    l [WPL_NO_TITLE_HIGHLIGHT]		= Scr->NoTitleHighlight;
+    l [WPL_AUTO_RAISE]			= Scr->AutoRaise;
+    l [WPL_AUTO_LOWER]			= Scr->AutoLower;
+    l [WPL_DONT_ICONIFY]		= Scr->DontIconify;
+    l [WPL_ICONIFY_BY_UNMAPPING]	= Scr->IconifyByUn;
+    l [WPL_UNMAP_BY_MOVING_FAR_AWAY]	= Scr->UnmapByMovingFarAway;
+    l [WPL_DONT_SET_INACTIVE]		= Scr->DontSetInactive;
+    l [WPL_AUTO_SQUEEZE]		= Scr->AutoSqueeze;
+    l [WPL_START_SQUEEZED]		= Scr->StartSqueezed;
+    l [WPL_ALWAYS_SQUEEZE_TO_GRAVITY]	= Scr->AlwaysSqueezeToGravityL;
+    l [WPL_WINDOW_RING]			= Scr->WindowRingL;
+    l [WPL_WINDOW_RING_EXCLUDE]		= Scr->WindowRingExcludeL;
+    l [WPL_DONT_SQUEEZE_TITLE]		= Scr->DontSqueezeTitleL;
+    l [WPL_NO_BORDER]			= Scr->NoBorder;
+    l [WPL_MAKE_TITLE]			= Scr->MakeTitle;
+    l [WPL_NO_TITLE]			= Scr->NoTitle;
+    l [WPL_OPAQUE_MOVE]			= Scr->OpaqueMoveList;
+    l [WPL_NO_OPAQUE_MOVE]		= Scr->NoOpaqueMoveList;
+    l [WPL_OPAQUE_RESIZE]		= Scr->OpaqueResizeList;
+    l [WPL_NO_OPAQUE_RESIZE]		= Scr->NoOpaqueResizeList;
+    l [WPL_START_ICONIFIED]		= Scr->StartIconified;
+    l [WPL_NO_ICON_TITLE]		= Scr->NoIconTitle;
+    l [WPL_WARP_ON_DEICONIFY]		= Scr->WarpOnDeIconify;
+    l [WPL_WARP_CURSOR]			= Scr->WarpCursorL;
+    l [WPL_ICON_MGR_NO_SHOW]		= Scr->IconMgrNoShow;
+    l [WPL_ICON_MGR_SHOW]		= Scr->IconMgrShow;
+    l [WPL_ICON_MENU_DONT_SHOW]		= Scr->IconMenuDontShow;
+    l [WPL_OCCUPY_ALL]			= Scr->OccupyAll;
+}
+
+/*
+ * Build the matcher for the policy lists of the current screen.  To be
+ * called once the configuration file has been parsed.
+ */
+void CreatePolicyLists (void)
+{
+    name_list *lists [WPL_COUNT];
+
+    FreeNameListSet (&Scr->PolicyLists);
+    GetPolicyLists (lists);
+    Scr->PolicyLists = CreateNameListSet (lists, WPL_COUNT);
+}
+
+void GetWindowPolicy (TwmWindow *tmp)
+{
+    WindowPolicy *p = &tmp->policy;
+    name_list *lists [WPL_COUNT];
+    char hit [WPL_COUNT];
+    int i;
+
+    if (Scr->PolicyLists) {
+	MatchNameListSet (Scr->PolicyLists, tmp->full_name, &tmp->class, hit);
+    } else {
+	GetPolicyLists (lists);
+	for (i = 0; i < WPL_COUNT; i++)
+	    hit [i] = (LookInList (lists [i], tmp->full_name, &tmp->class) != NULL);
+    }
+
+    p->ignore_transient		 = hit [WPL_IGNORE_TRANSIENT];
+    p->no_highlight		 = hit [WPL_NO_HIGHLIGHT];
+    p->no_stack_mode		 = hit [WPL_NO_STACK_MODE];
+    p->always_on_top		 = hit [WPL_ALWAYS_ON_TOP];
+    p->no_title_highlight	 = hit [WPL_NO_TITLE_HIGHLIGHT];
+    p->auto_raise		 = hit [WPL_AUTO_RAISE];
+    p->auto_lower		 = hit [WPL_AUTO_LOWER];
+    p->dont_iconify		 = hit [WPL_DONT_ICONIFY];
+    p->iconify_by_unmapping	 = hit [WPL_ICONIFY_BY_UNMAPPING];
+    p->unmap_by_moving_far_away	 = hit [WPL_UNMAP_BY_MOVING_FAR_AWAY];
+    p->dont_set_inactive	 = hit [WPL_DONT_SET_INACTIVE];
+    p->auto_squeeze		 = hit [WPL_AUTO_SQUEEZE];
+    p->start_squeezed		 = hit [WPL_START_SQUEEZED];
+    p->always_squeeze_to_gravity = hit [WPL_ALWAYS_SQUEEZE_TO_GRAVITY];
+    p->window_ring		 = hit [WPL_WINDOW_RING];
+    p->window_ring_exclude	 = hit [WPL_WINDOW_RING_EXCLUDE];
+    p->dont_squeeze_title	 = hit [WPL_DONT_SQUEEZE_TITLE];
+    p->no_border		 = hit [WPL_NO_BORDER];
+    p->make_title		 = hit [WPL_MAKE_TITLE];
+    p->no_title			 = hit [WPL_NO_TITLE];
+    p->opaque_move		 = hit [WPL_OPAQUE_MOVE];
+    p->no_opaque_move		 = hit [WPL_NO_OPAQUE_MOVE];
+    p->opaque_resize		 = hit [WPL_OPAQUE_RESIZE];
+    p->no_opaque_resize		 = hit [WPL_NO_OPAQUE_RESIZE];
+    p->start_iconified		 = hit [WPL_START_ICONIFIED];
+    p->no_icon_title		 = hit [WPL_NO_ICON_TITLE];
+    p->warp_on_deiconify	 = hit [WPL_WARP_ON_DEICONIFY];
+    p->warp_cursor		 = hit [WPL_WARP_CURSOR];
+    p->icon_mgr_no_show		 = hit [WPL_ICON_MGR_NO_SHOW];
+    p->icon_mgr_show		 = hit [WPL_ICON_MGR_SHOW];
+    p->icon_menu_dont_show	 = hit [WPL_ICON_MENU_DONT_SHOW];
+    p->occupy_all		 = hit [WPL_OCCUPY_ALL];
+}
+
+void GetWindowIconPolicy (TwmWindow *tmp)
+{
+    tmp->policy.no_icon_title_icon =
+	(LookInNameList (Scr->NoIconTitle, tmp->icon_name) != NULL);
+}
+
 void FetchWmProtocols (TwmWindow *tmp)
 {
     unsigned long flags = 0L;
     Atom *protocols = NULL;
     int n;
 
-    if (XGetWMProtocols (dpy, tmp->w, &protocols, &n)) {
+    if (TwmGetWMProtocols (dpy, tmp->w, &protocols, &n)) {
 	register int i;
 	register Atom *ap;
 
@@ -2170,8 +2448,8 @@ void FetchWmColormapWindows (TwmWindow *tmp)
 	    cwins[i]->colormap->state = 0;
     }
 
-    if (XGetWMColormapWindows (dpy, tmp->w, &cmap_windows, 
-			       &number_cmap_windows) &&
+    if (TwmGetWMColormapWindows (dpy, tmp->w, &cmap_windows, 
+				 &number_cmap_windows) &&
 	number_cmap_windows > 0) {
 
 	can_free_cmap_windows = False;
@@ -2283,7 +2561,7 @@ void GetWindowSizeHints (TwmWindow *tmp)
 {
     long supplied = 0;
 
-    if (!XGetWMNormalHints (dpy, tmp->w, &tmp->hints, &supplied))
+    if (!TwmGetWMNormalHints (dpy, tmp->w, &tmp->hints, &supplied))
       tmp->hints.flags = 0;
 
     if (tmp->hints.flags & PResizeInc) {
@@ -2386,6 +2664,198 @@ void CreateWindowRegions (void) {
 }
 
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	SmartPlaceWindow - find where the frame of a new window overlaps
+ *	the windows already there the least
+ *
+ *  Returned Value:
+ *	True if a position was found
+ *
+ *  Inputs:
+ *	tmp_win	- the window being added, with its frame size known
+ *
+ *  Outputs:
+ *	final_x, final_y - the position of the frame
+ *
+ *  Special Considerations:
+ *	Only the positions where the frame touches the edge of the
+ *	placement area or of another window can be better than their
+ *	neighbours, so those are the only ones tried.  The rows are swept
+ *	from top to bottom, looking at the windows crossing each row only,
+ *	and the first position with no overlap at all wins.  The search
+ *	gives up on the rows left after SMART_PLACEMENT_BUDGET and keeps
+ *	the best position found so far.
+ *
+ ***********************************************************************
+ */
+
+#define SMART_PLACEMENT_BUDGET	10000	/* microseconds */
+
+typedef struct SmartRect {
+    int x0, y0, x1, y1;
+} SmartRect;
+
+static int SmartCompare (const void *a, const void *b)
+{
+    return (*(const int*) a - *(const int*) b);
+}
+
+/*
+ * Sorts the candidate coordinates, drops the duplicates and the ones
+ * outside [lo, hi], and returns how many are left.
+ */
+static int SmartCandidates (int *c, int n, int lo, int hi)
+{
+    int i, m;
+
+    qsort (c, n, sizeof (int), SmartCompare);
+    for (i = 0, m = 0; i < n; i++) {
+	if (c [i] < lo || c [i] > hi) continue;
+	if (m > 0 && c [m - 1] == c [i]) continue;
+	c [m++] = c [i];
+    }
+    return m;
+}
+
+static Bool SmartPlaceWindow (TwmWindow *tmp_win, int *final_x, int *final_y)
+{
+    TwmWindow	 *t;
+    SmartRect	 area, *rects, *band;
+    int		 *xs, *ys;
+    int		 winw, winh, hix, hiy, nrects, nband, nx, ny, n, i, j, k;
+    int		 w, h, bestx, besty;
+    long	 overlap, best;
+    unsigned long start;
+
+    start = TimerNowUsec ();
+    winw  = tmp_win->frame_width  + 2 * tmp_win->frame_bw;
+    winh  = tmp_win->frame_height + 2 * tmp_win->frame_bw;
+
+    area.x0 = Scr->BorderLeft;
+    area.y0 = Scr->BorderTop;
+    area.x1 = Scr->rootw - Scr->BorderRight;
+    area.y1 = Scr->rooth - Scr->BorderBottom;
+#ifdef USE_XINERAMA
+    /*
+     * Stay on the head the pointer is on.
+     */
+    if (HasXinerama && Scr->heads > 1) {
+	XineramaScreenInfo *head;
+	int px, py, offx = 0, offy = 0;
+
+	if (tmp_win->vs) {
+	    offx = tmp_win->vs->x;
+	    offy = tmp_win->vs->y;
+	}
+	if (XQueryPointer (dpy, Scr->Root, &JunkRoot, &JunkChild,
+			   &px, &py, &JunkX, &JunkY, &JunkMask)) {
+	    for (i = 0; i < Scr->heads; i++) {
+		head = &Scr->head [i];
+		if (px < head->x_org || px >= head->x_org + head->width ||
+		    py < head->y_org || py >= head->y_org + head->height)
+		    continue;
+		area.x0 = MAX (area.x0, head->x_org - offx);
+		area.y0 = MAX (area.y0, head->y_org - offy);
+		area.x1 = MIN (area.x1, head->x_org + head->width  - offx);
+		area.y1 = MIN (area.y1, head->y_org + head->height - offy);
+		break;
+	    }
+	}
+    }
+#endif /* USE_XINERAMA */
+    if (area.x1 <= area.x0 || area.y1 <= area.y0) return False;
+    hix = MAX (area.x0, area.x1 - winw);
+    hiy = MAX (area.y0, area.y1 - winh);
+
+    n = 0;
+    for (t = Scr->FirstWindow; t != NULL; t = t->next) n++;
+    rects = (SmartRect*) malloc ((n + 1) * sizeof (SmartRect));
+    band  = (SmartRect*) malloc ((n + 1) * sizeof (SmartRect));
+    xs    = (int*) malloc ((2 * n + 2) * sizeof (int));
+    ys    = (int*) malloc ((2 * n + 2) * sizeof (int));
+    if (!rects || !band || !xs || !ys) {
+	free (rects);
+	free (band);
+	free (xs);
+	free (ys);
+	return False;
+    }
+
+    nrects = 0;
+    nx = ny = 0;
+    xs [nx++] = area.x0;
+    xs [nx++] = hix;
+    ys [ny++] = area.y0;
+    ys [ny++] = hiy;
+    for (t = Scr->FirstWindow; t != NULL; t = t->next) {
+	if (t == tmp_win) continue;
+	if (!t->mapped) continue;
+	if (t->winbox) continue;
+	if (tmp_win->vs) {
+	    if (t->vs != tmp_win->vs) continue;
+	} else {
+	    if (!(t->occupation & tmp_win->occupation)) continue;
+	}
+	w = t->frame_width  + 2 * t->frame_bw;
+	h = t->frame_height + 2 * t->frame_bw;
+	if (t->frame_x >= area.x1 || t->frame_x + w <= area.x0) continue;
+	if (t->frame_y >= area.y1 || t->frame_y + h <= area.y0) continue;
+	rects [nrects].x0 = t->frame_x;
+	rects [nrects].y0 = t->frame_y;
+	rects [nrects].x1 = t->frame_x + w;
+	rects [nrects].y1 = t->frame_y + h;
+	nrects++;
+	xs [nx++] = t->frame_x + w;
+	xs [nx++] = t->frame_x - winw;
+	ys [ny++] = t->frame_y + h;
+	ys [ny++] = t->frame_y - winh;
+    }
+    nx = SmartCandidates (xs, nx, area.x0, hix);
+    ny = SmartCandidates (ys, ny, area.y0, hiy);
+
+    best  = -1;
+    bestx = area.x0;
+    besty = area.y0;
+    for (j = 0; j < ny && best != 0; j++) {
+	/*
+	 * The windows crossing this row, with their height in it.
+	 */
+	nband = 0;
+	for (k = 0; k < nrects; k++) {
+	    if (rects [k].y0 >= ys [j] + winh || rects [k].y1 <= ys [j]) continue;
+	    band [nband].x0 = rects [k].x0;
+	    band [nband].x1 = rects [k].x1;
+	    band [nband].y0 = MIN (rects [k].y1, ys [j] + winh) -
+			      MAX (rects [k].y0, ys [j]);
+	    nband++;
+	}
+	for (i = 0; i < nx; i++) {
+	    overlap = 0;
+	    for (k = 0; k < nband; k++) {
+		w = MIN (band [k].x1, xs [i] + winw) - MAX (band [k].x0, xs [i]);
+		if (w > 0) overlap += (long) w * band [k].y0;
+	    }
+	    if (best < 0 || overlap < best) {
+		best  = overlap;
+		bestx = xs [i];
+		besty = ys [j];
+		if (best == 0) break;
+	    }
+	}
+	if (TimerNowUsec () - start > SMART_PLACEMENT_BUDGET) break;
+    }
+    free (rects);
+    free (band);
+    free (xs);
+    free (ys);
+
+    *final_x = bestx;
+    *final_y = besty;
+    return True;
+}
+
 Bool PlaceWindowInRegion (TwmWindow *tmp_win, int *final_x, int *final_y)
 {
     WindowRegion  *wr;
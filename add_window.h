@@ -75,9 +75,13 @@ extern TwmWindow *AddWindow(Window w, int iconm, IconMgr *iconp);
 extern TwmWindow *GetTwmWindow(Window w);
 extern void DeleteHighlightWindows(TwmWindow *tmp_win);
 extern int MappedNotOverride(Window w);
+extern void PrefetchWindowProperties (Window w);
 extern void AddDefaultBindings (void);
 extern void GrabButtons(TwmWindow *tmp_win);
 extern void GrabKeys(TwmWindow *tmp_win);
+extern void GrabRootKeys (void);
+extern void RefreshKeyGrabs (XMappingEvent *event);
+extern unsigned long GrabCount;
 #if 0 /* Not implemented! */
 extern void UngrabButtons();
 extern void UngrabKeys();
@@ -98,6 +102,9 @@ extern unsigned int AddingH;
 extern void SetHighlightPixmap (char *filename);
 extern void FetchWmColormapWindows (TwmWindow *tmp);
 extern void FetchWmProtocols (TwmWindow *tmp);
+extern void CreatePolicyLists (void);
+extern void GetWindowPolicy (TwmWindow *tmp);
+extern void GetWindowIconPolicy (TwmWindow *tmp);
 
 extern TwmColormap *CreateTwmColormap(Colormap c);
 extern ColormapWindow *CreateColormapWindow(Window w,
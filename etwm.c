@@ -121,6 +121,9 @@
 #  include <X11/Xmu/Error.h>
 #  include <X11/SM/SMlib.h>
 #  include <X11/Xlocale.h>
+#  ifdef USE_XCB
+#    include <X11/Xlib-xcb.h>
+#  endif
 
 #  ifndef PIXMAP_DIRECTORY
 #    define PIXMAP_DIRECTORY "/usr/lib/X11/twm"
@@ -146,6 +149,8 @@ int Monochrome  = FALSE;	/* Force monochrome, for testing purpose */
 int NumScreens;			/* number of screens in ScreenList */
 int HasShape;			/* server supports shape extension? */
 int ShapeEventBase, ShapeErrorBase;
+int HasSync;			/* server supports sync extension? */
+int SyncEventBase, SyncErrorBase;
 ScreenInfo **ScreenList;	/* structures for each screen */
 ScreenInfo *Scr = NULL;		/* the cur and prev screens */
 int PreviousScreen;		/* last screen that we were on */
@@ -172,6 +177,8 @@ static Window CreateRootWindow (int x, int y,
 static void DisplayInfo (void);
 static void InternUsefulAtoms (void);
 static void InitVariables(void);
+static long GetFrameInterval (ScreenInfo *scr);
+static void AdoptExistingWindows (void);
 
 Cursor	UpperLeftCursor;
 Cursor	TopRightCursor,
@@ -253,14 +260,14 @@ int main(int argc, char **argv)
 int main(int argc, char **argv, char **environ)
 #endif
 {
-    Window croot, parent, *children, selwin = None;
-    unsigned int nchildren;
-    int i, j;
+    Window croot, selwin = None;
+    int i;
     unsigned long valuemask;	/* mask for create windows */
     XSetWindowAttributes attributes;	/* attributes for create windows */
     int numManaged, firstscrn, lastscrn, scrnum;
     int zero = 0;
     char *restore_filename = NULL;
+    char *profile_file = NULL;
     char *client_id = NULL;
     char *welcomefile;
     int  screenmasked;
@@ -336,6 +343,11 @@ int main(int argc, char **argv, char **environ)
 		if (++i >= argc) goto usage;
 		restore_filename = argv[i];
 		continue;
+	      case 'p':				/* -profile file */
+		if (strcmp(argv[i],"-profile")) goto usage;
+		if (++i >= argc) goto usage;
+		profile_file = argv[i];
+		continue;
 	      case 'q':				/* -quiet */
 		PrintErrorMessages = False;
 		continue;
@@ -385,9 +397,9 @@ int main(int argc, char **argv, char **environ)
       usage:
 	fprintf (stderr, "usage: %s [-display dpy] [-version] [-info]", ProgramName);
 #ifdef USEM4
-	fprintf (stderr, " [-cfgchk] [-f file] [-s] [-q] [-v] [-W] [-w [wid]] [-k] [-K file] [-n] [-name name]\n");
+	fprintf (stderr, " [-cfgchk] [-f file] [-s] [-q] [-v] [-W] [-w [wid]] [-k] [-K file] [-n] [-name name] [-profile file]\n");
 #else
-	fprintf (stderr, " [-cfgchk] [-f file] [-s] [-q] [-v] [-W] [-w [wid]] [-name name] \n");
+	fprintf (stderr, " [-cfgchk] [-f file] [-s] [-q] [-v] [-W] [-w [wid]] [-name name] [-profile file]\n");
 #endif
 	exit (1);
     }
@@ -423,6 +435,8 @@ int main(int argc, char **argv, char **environ)
     NoClass.res_name = NoName;
     NoClass.res_class = NoName;
 
+    ProfileStart (profile_file ? profile_file : getenv ("ETWM_PROFILE"));
+    ProfileBegin ("connect");
     XtToolkitInitialize ();
     appContext = XtCreateApplicationContext ();
 
@@ -478,6 +492,14 @@ int main(int argc, char **argv, char **environ)
 #endif
     if (restore_filename) ReadWinConfigFile (restore_filename);
     HasShape = XShapeQueryExtension (dpy, &ShapeEventBase, &ShapeErrorBase);
+#ifndef VMS
+    {
+	int major, minor;
+
+	HasSync = XSyncQueryExtension (dpy, &SyncEventBase, &SyncErrorBase)
+		  && XSyncInitialize (dpy, &major, &minor);
+    }
+#endif
     TwmContext = XUniqueContext();
     MenuContext = XUniqueContext();
     IconManagerContext = XUniqueContext();
@@ -489,7 +511,7 @@ int main(int argc, char **argv, char **environ)
 #endif				/* EWMH */
 
     InternUsefulAtoms ();
-
+    ProfileEnd ();
 
     /* Set up the per-screen global information. */
 
@@ -732,6 +754,7 @@ int main(int argc, char **argv, char **environ)
 	Scr->IconMenuDontShow = NULL;
 	Scr->VirtualScreens = NULL;
 	Scr->IgnoreTransientL = NULL;
+	Scr->PolicyLists = NULL;
 
 	/* remember to put an initialization in InitVariables also
 	 */
@@ -744,6 +767,7 @@ int main(int argc, char **argv, char **environ)
 	Scr->Root = croot;
 	Scr->XineramaRoot = croot;
 	Scr->ManagerWindow = selwin;
+	Scr->RootEventMask = attrmask;
 	XSaveContext (dpy, Scr->Root, ScreenContext, (XPointer) Scr);
 	XSaveContext (dpy, selwin,    ScreenContext, (XPointer) Scr);
 
@@ -771,7 +795,9 @@ int main(int argc, char **argv, char **environ)
 		Scr->head = XineramaQueryScreens(dpy, &Scr->heads);
 #endif				/* USE_XINERAMA */
 #ifdef EWMH
+	    ProfileBegin ("InitEwmh");
 	    InitEwmh(Scr);
+	    ProfileEnd ();
 #endif				/* EWMH */
 #ifdef WMH
 	    InitWmh(Scr);
@@ -780,6 +806,7 @@ int main(int argc, char **argv, char **environ)
 	    InitMwmh(Scr);
 #endif				/* MWMH */
 	}
+	Scr->FrameInterval = GetFrameInterval (Scr);
 	Scr->RootColormaps.number_cwins = 1;
 	Scr->RootColormaps.cwins = (ColormapWindow **) malloc(sizeof(ColormapWindow *));
 	Scr->RootColormaps.cwins[0] = CreateColormapWindow(Scr->Root, True, False);
@@ -854,6 +881,7 @@ int main(int argc, char **argv, char **environ)
 
 	Scr->IconDirectory = NULL;
 	Scr->PixmapDirectory = PIXMAP_DIRECTORY;
+	Scr->ImageCacheDirectory = NULL;
 	Scr->siconifyPm = None;
 	Scr->pullPm = None;
 	Scr->tbpm.xlogo = None;
@@ -885,8 +913,11 @@ int main(int argc, char **argv, char **environ)
 	}
 	else
 	  {
+	    ProfileBegin ("ParseTwmrc");
 	    ParseTwmrc(InitFile);
+	    ProfileEnd ();
 	  }
+	CreatePolicyLists ();
 
 	InitVirtualScreens (Scr);
 	ConfigureWorkSpaceManager ();
@@ -934,9 +965,15 @@ int main(int argc, char **argv, char **environ)
 
 	assign_var_savecolor(); /* storeing pixels for twmrc "entities" */
 	if (Scr->SqueezeTitle == -1) Scr->SqueezeTitle = FALSE;
-	if (!Scr->HaveFonts) CreateFonts();
+	if (!Scr->HaveFonts) {
+	    ProfileBegin ("CreateFonts");
+	    CreateFonts();
+	    ProfileEnd ();
+	}
 	CreateGCs();
+	ProfileBegin ("MakeMenus");
 	MakeMenus();
+	ProfileEnd ();
 
 	Scr->TitleBarFont.y += Scr->FramePadding;
 	Scr->TitleHeight = Scr->TitleBarFont.height + Scr->FramePadding * 2;
@@ -944,7 +981,10 @@ int main(int argc, char **argv, char **environ)
 	/* make title height be odd so buttons look nice and centered */
 	if (!(Scr->TitleHeight & 1)) Scr->TitleHeight++;
 
+	ProfileBegin ("InitTitlebarButtons");
 	InitTitlebarButtons ();		/* menus are now loaded! */
+	ProfileEnd ();
+	GrabRootKeys ();		/* and so are the key bindings */
 
 	XGrabServer(dpy);
 	XSync(dpy, 0);
@@ -953,17 +993,23 @@ int main(int argc, char **argv, char **environ)
 	JunkY = 0;
 
 	CreateWindowRegions ();
+	ProfileBegin ("CreateIconManagers");
 	AllocateOthersIconManagers ();
 	CreateIconManagers();
+	ProfileEnd ();
+	ProfileBegin ("CreateWorkSpaceManager");
 	CreateWorkSpaceManager ();
 	MakeWorkspacesMenu ();
+	ProfileEnd ();
 	createWindowBoxes ();
 
 #ifdef GNOME
 	InitGnome ();
 #endif /* GNOME */
 #ifdef EWMH
+	ProfileBegin ("UpdateEwmh");
 	UpdateEwmh(Scr);
+	ProfileEnd ();
 #endif				/* EWMH */
 #ifdef WMH
 	UpdateWmh(Scr);
@@ -972,39 +1018,10 @@ int main(int argc, char **argv, char **environ)
 	UpdateMwmh(Scr);
 #endif				/* MWMH */
 
-	XQueryTree(dpy, Scr->Root, &croot, &parent, &children, &nchildren);
-	/*
-	 * weed out icon windows
-	 */
-	for (i = 0; i < nchildren; i++) {
-	    if (children[i]) {
-		XWMHints *wmhintsp = XGetWMHints (dpy, children[i]);
-
-		if (wmhintsp) {
-		    if (wmhintsp->flags & IconWindowHint) {
-			for (j = 0; j < nchildren; j++) {
-			    if (children[j] == wmhintsp->icon_window) {
-				children[j] = None;
-				break;
-			    }
-			}
-		    }
-		    XFree ((char *) wmhintsp);
-		}
-	    }
-	}
+	ProfileBegin ("AdoptExistingWindows");
+	AdoptExistingWindows ();
+	ProfileEnd ();
 
-	/*
-	 * map all of the non-override windows
-	 */
-	for (i = 0; i < nchildren; i++)
-	{
-	    if (children[i] && MappedNotOverride(children[i]))
-	    {
-		XUnmapWindow(dpy, children[i]);
-		SimulateMapRequest(children[i]);
-	    }
-	}
 	if (Scr->ShowWorkspaceManager && Scr->workSpaceManagerActive)
 	{
 	    VirtualScreen *vs;
@@ -1132,6 +1149,7 @@ int main(int argc, char **argv, char **environ)
 	}
     }
 
+    ProfileReport ();
     RestartPreviousState = True;
     HandlingEvents = TRUE;
     InitEvents();
@@ -1150,6 +1168,7 @@ int main(int argc, char **argv, char **environ)
 
 static void InitVariables(void)
 {
+    FreeNameListSet(&Scr->PolicyLists);
     FreeList(&Scr->BorderColorL);
     FreeList(&Scr->IconBorderColorL);
     FreeList(&Scr->BorderTileForegroundL);
@@ -1255,6 +1274,7 @@ static void InitVariables(void)
     Scr->WarpCursor = FALSE;
     Scr->ForceIcon = FALSE;
     Scr->NoGrabServer = FALSE;
+    Scr->CompressMotion = FALSE;
     Scr->NoRaiseMove = FALSE;
     Scr->NoRaiseResize = FALSE;
     Scr->NoRaiseDeicon = FALSE;
@@ -1291,6 +1311,7 @@ static void InitVariables(void)
     Scr->RandomPlacement = RP_OFF;
     Scr->RandomDisplacementX = 30;
     Scr->RandomDisplacementY = 30;
+    Scr->SmartPlacement = FALSE;
     Scr->DoOpaqueMove = FALSE;
     Scr->OpaqueMove = FALSE;
     Scr->OpaqueMoveThreshold = 200;
@@ -1302,6 +1323,7 @@ static void InitVariables(void)
     Scr->TitleHighlight = TRUE;
     Scr->MoveDelta = 1;		/* so that f.deltastop will work */
     Scr->MoveOffResistance = -1;
+    Scr->ImageCacheSize = 4096 * 1024;
     Scr->MovePackResistance = 20;
     Scr->ZoomCount = 8;
     Scr->SortIconMgr = FALSE;
@@ -1337,6 +1359,8 @@ static void InitVariables(void)
     Scr->IconifyStyle = ICONIFY_NORMAL;
     Scr->MaxIconTitleWidth = Scr->rootw;
     Scr->ReallyMoveInWorkspaceManager = FALSE;
+    Scr->FlatWorkSpaceMap = FALSE;
+    Scr->KillUnresponsiveClients = FALSE;
     Scr->ShowWinWhenMovingInWmgr = FALSE;
     Scr->ReverseCurrentWorkspace = FALSE;
     Scr->DontWarpCursorInWMap = FALSE;
@@ -1606,6 +1630,170 @@ ChildExit (int signum)
 Bool ErrorOccurred = False;
 XErrorEvent LastErrorEvent;
 
+/*
+ * The time between two refreshes of the fastest monitor of scr, in
+ * microseconds, for pacing opaque moves.  60Hz when it is not known.
+ */
+static long GetFrameInterval (ScreenInfo *scr)
+{
+    long interval = 1000000 / 60;
+#ifdef USE_XRANDR
+    int n, m;
+
+    for (n = 0; n < scr->crtcs; n++) {
+	XRRCrtcInfo *crtc = scr->crtc[n];
+
+	if (crtc == NULL || crtc->mode == None)
+	    continue;
+	for (m = 0; m < scr->randr->nmode; m++) {
+	    XRRModeInfo *mode = &scr->randr->modes[m];
+	    double rate;
+
+	    if (mode->id != crtc->mode)
+		continue;
+	    if (mode->hTotal == 0 || mode->vTotal == 0)
+		break;
+	    rate = (double) mode->dotClock / ((double) mode->hTotal * mode->vTotal);
+	    if (rate >= 1.0 && 1000000 / rate < interval)
+		interval = 1000000 / rate;
+	    break;
+	}
+    }
+#endif				/* USE_XRANDR */
+    return interval;
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	AdoptExistingWindows - frame the clients that are already mapped
+ *	on Scr->Root when etwm starts or restarts
+ *
+ *  Called with the server grabbed, so the time taken here is time
+ *  every client spends frozen.  Each step runs over all of the
+ *  children before the next one starts, so that the replies a step
+ *  needs can be asked for together: the attributes and WM_HINTS of
+ *  every child first (to weed out override-redirect, unmapped and
+ *  icon windows), then everything AddWindow reads for every client
+ *  that is left, and only then the clients are framed one after the
+ *  other.  With -v, the time spent in each step is reported.
+ *
+ ***********************************************************************
+ */
+
+#define ADOPT_CLIENT	1	/* not override-redirect */
+#define ADOPT_MAPPED	2
+
+static void AdoptExistingWindows (void)
+{
+    Window root, parent, *children;
+    unsigned int nchildren, i, j, nadopted;
+    unsigned char *state;
+    XWMHints *wmhintsp;
+    unsigned long t0, t1, t2, t3, t4;
+#ifdef USE_XCB
+    xcb_connection_t *c = XGetXCBConnection (dpy);
+    xcb_get_window_attributes_cookie_t *cookies;
+    xcb_get_window_attributes_reply_t *r;
+    xcb_generic_error_t *e;
+    Atom hints_atom = XA_WM_HINTS;
+#else
+    XWindowAttributes wa;
+#endif
+
+    t0 = TimerNow ();
+    if (!XQueryTree (dpy, Scr->Root, &root, &parent, &children, &nchildren))
+	return;
+    t1 = TimerNow ();
+    if (nchildren == 0) return;
+    if ((state = (unsigned char *) calloc (nchildren, 1)) == NULL) {
+	XFree ((char *) children);
+	return;
+    }
+
+    /*
+     * find the clients, and weed out icon windows
+     */
+#ifdef USE_XCB
+    cookies = (xcb_get_window_attributes_cookie_t *)
+		malloc (nchildren * sizeof (xcb_get_window_attributes_cookie_t));
+    if (cookies != NULL) {
+	for (i = 0; i < nchildren; i++) {
+	    cookies [i] = xcb_get_window_attributes (c, children [i]);
+	    PrefetchProperties (children [i], &hints_atom, 1);
+	}
+	for (i = 0; i < nchildren; i++) {
+	    e = NULL;
+	    r = xcb_get_window_attributes_reply (c, cookies [i], &e);
+	    if (r != NULL) {
+		if (!r->override_redirect) state [i] |= ADOPT_CLIENT;
+		if (r->map_state != XCB_MAP_STATE_UNMAPPED)
+		    state [i] |= ADOPT_MAPPED;
+		free (r);
+	    }
+	    if (e != NULL) free (e);
+	}
+	free (cookies);
+    }
+#else
+    for (i = 0; i < nchildren; i++) {
+	if (!XGetWindowAttributes (dpy, children [i], &wa)) continue;
+	if (wa.override_redirect != True) state [i] |= ADOPT_CLIENT;
+	if (wa.map_state != IsUnmapped)   state [i] |= ADOPT_MAPPED;
+    }
+#endif
+    for (i = 0; i < nchildren; i++) {
+	if (!(state [i] & ADOPT_CLIENT)) continue;
+	wmhintsp = TwmGetWMHints (dpy, children [i]);
+	if (wmhintsp) {
+	    if (wmhintsp->flags & IconWindowHint) {
+		for (j = 0; j < nchildren; j++) {
+		    if (children [j] == wmhintsp->icon_window) {
+			state [j] = 0;
+			break;
+		    }
+		}
+	    }
+	    XFree ((char *) wmhintsp);
+	}
+    }
+    t2 = TimerNow ();
+
+    /*
+     * ask for everything AddWindow will want, for all of them at once
+     */
+    for (i = 0; i < nchildren; i++) {
+	if (state [i] == (ADOPT_CLIENT | ADOPT_MAPPED))
+	    PrefetchWindowProperties (children [i]);
+	else
+	    ReleaseProperties (children [i]);
+    }
+    t3 = TimerNow ();
+
+    /*
+     * map all of the non-override windows
+     */
+    nadopted = 0;
+    for (i = 0; i < nchildren; i++) {
+	if (state [i] != (ADOPT_CLIENT | ADOPT_MAPPED)) continue;
+	XUnmapWindow (dpy, children [i]);
+	SimulateMapRequest (children [i]);
+	ReleaseProperties (children [i]);	/* if it was not managed */
+	nadopted++;
+    }
+    XFlush (dpy);
+    t4 = TimerNow ();
+
+    if (PrintErrorMessages)
+	fprintf (stderr, "%s: screen %d: adopted %u of %u windows in %lu ms "
+		 "(query %lu, scan %lu, prefetch %lu, adopt %lu)\n",
+		 ProgramName, Scr->screen, nadopted, nchildren, t4 - t0,
+		 t1 - t0, t2 - t1, t3 - t2, t4 - t3);
+
+    free (state);
+    XFree ((char *) children);
+}
+
 static int TwmErrorHandler(Display *display, XErrorEvent *event)
 {
     LastErrorEvent = *event;
@@ -1655,6 +1843,7 @@ Atom _XA_WM_CURRENTWORKSPACE;
 Atom _XA_WM_NOREDIRECT;
 Atom _XA_WM_OCCUPATION;
 Atom _XA_WM_ETWM_VSCREENMAP;
+Atom _XA_WM_ETWM_EVENT_STATS;
 Atom _XA_MANAGER;
 Atom _OL_WIN_ATTR;
 Atom _XA_KDE_WM_CHANGE_STATE;
@@ -1693,6 +1882,7 @@ void InternUsefulAtoms (void)
     _XA_WM_OCCUPATION = XInternAtom (dpy, "WM_OCCUPATION", False);
 
     _XA_WM_ETWM_VSCREENMAP  = XInternAtom (dpy, "WM_ETWM_VSCREENMAP", False);
+    _XA_WM_ETWM_EVENT_STATS = XInternAtom (dpy, "WM_ETWM_EVENT_STATS", False);
 #ifdef GNOME
     _XA_WM_WORKSPACESLIST   = XInternAtom (dpy, "_WIN_WORKSPACE_NAMES", False);
 #else /* GNOME */
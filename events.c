@@ -95,6 +95,7 @@
 #include "icons.h"
 #include "iconmgr.h"
 #include "version.h"
+#include "windowbox.h"
 
 #ifdef VMS
 #include <starlet.h>
@@ -104,6 +105,7 @@
 #endif
 
 static void EtwmNextEvent (Display *display, XEvent  *event);
+static void FlushHints (void);
 void RedoIcon(void);
 static void do_key_menu (MenuRoot *menu,	/* menu to pop up */
 			 Window w);		/* invoking window or None */
@@ -143,12 +145,17 @@ static int enter_flag;
 static int leave_flag;
 static int ColortableThrashing;
 static TwmWindow *enter_win, *raise_win, *leave_win, *lower_win;
+static TwmWindow *delay_win;		/* waiting out RaiseDelay */
+static int delay_x, delay_y;
 
 int ButtonPressed = -1;
 int Cancel = FALSE;
 
 void HandleCreateNotify(void);
 void HandleShapeNotify (void);
+#ifdef EWMH
+void HandleSyncAlarmNotify (void);
+#endif				/* EWMH */
 void HandleFocusChange (void);
 
 #ifdef GNOME
@@ -164,6 +171,7 @@ int GnomeProxyButtonPress = -1;
 /*#define TRACE*/
 
 static void dumpevent (XEvent *e);
+static char *EventName (int type);
 
 #if defined(__hpux) && !defined(_XPG4_EXTENDED)
 #   define FDSET int*
@@ -185,6 +193,73 @@ static unsigned int set_mask_ignore (unsigned int modifier)
     return modifier;
 }
 
+/*
+ * Raising or lowering a window generates a flurry of crossing events of
+ * its own.  enter_flag and leave_flag are set while those are drained;
+ * once the queue is empty the settle timers below either clear the flag
+ * or act on a window the pointer has really entered (or left) since.
+ */
+static void AutoRaiseSettle (void *closure)
+{
+    if (! enter_flag) return;
+    if (enter_win && enter_win != raise_win) {
+	AutoRaiseWindow (enter_win);  /* sets enter_flag T */
+    } else {
+	enter_flag = FALSE;
+    }
+}
+
+static void AutoLowerSettle (void *closure)
+{
+    if (! leave_flag) return;
+    if (leave_win && leave_win != lower_win) {
+	AutoLowerWindow (leave_win); /* sets leave_flag T */
+    } else {
+	leave_flag = FALSE;
+    }
+}
+
+/*
+ * RaiseDelay: the pointer has to rest in the window for RaiseDelay
+ * milliseconds before it is raised.  Leaving the frame cancels it.
+ */
+static void AutoRaiseDelayed (void *closure)
+{
+    TwmWindow *tmp = delay_win;
+    Window w;
+    int x, y, d;
+
+    if (tmp == NULL) return;
+    XQueryPointer (dpy, tmp->frame, &w, &w, &x, &y, &d, &d, (unsigned int *)&d);
+    if (x != delay_x || y != delay_y) {
+	delay_x = x;
+	delay_y = y;
+	TimerSet (AutoRaiseDelayed, NULL, RaiseDelay);
+	return;
+    }
+    delay_win = NULL;
+    if (enter_win == tmp && enter_flag == FALSE) AutoRaiseWindow (tmp);
+}
+
+static void DelayAutoRaise (TwmWindow *tmp)
+{
+    Window w;
+    int d;
+
+    if (delay_win == tmp) return;
+    delay_win = tmp;
+    XQueryPointer (dpy, tmp->frame, &w, &w, &delay_x, &delay_y,
+		   &d, &d, (unsigned int *)&d);
+    TimerSet (AutoRaiseDelayed, NULL, RaiseDelay);
+}
+
+static void CancelAutoRaise (TwmWindow *tmp)
+{
+    if (delay_win != tmp) return;
+    delay_win = NULL;
+    TimerClear (AutoRaiseDelayed, NULL);
+}
+
 void AutoRaiseWindow (TwmWindow *tmp)
 {
     RaiseWindow (tmp);
@@ -194,6 +269,7 @@ void AutoRaiseWindow (TwmWindow *tmp)
     enter_win = NULL;
     enter_flag = TRUE;
     raise_win = tmp;
+    TimerSet (AutoRaiseSettle, NULL, 0);
     WMapRaise (tmp);
 }
 
@@ -205,6 +281,7 @@ void SetRaiseWindow (TwmWindow *tmp)
     leave_win = NULL;
     leave_flag = FALSE;
     lower_win = NULL;
+    TimerSet (AutoRaiseSettle, NULL, 0);
     XSync (dpy, 0);
 }
 
@@ -220,6 +297,7 @@ void AutoLowerWindow (TwmWindow *tmp)
     leave_win = NULL;
     leave_flag = TRUE;
     lower_win = tmp;
+    TimerSet (AutoLowerSettle, NULL, 0);
     WMapLower (tmp);
 }
 
@@ -244,6 +322,7 @@ void InitEvents(void)
     enter_win = raise_win = NULL;
     leave_flag = FALSE;
     leave_win = lower_win = NULL;
+    delay_win = NULL;
 
     for (i = 0; i < MAX_X_EVENT; i++)
 	EventHandler[i] = HandleUnknown;
@@ -271,6 +350,10 @@ void InitEvents(void)
     EventHandler[FocusOut] = HandleFocusChange;
     if (HasShape)
 	EventHandler[ShapeEventBase+ShapeNotify] = HandleShapeNotify;
+#ifdef EWMH
+    if (HasSync)
+	EventHandler[SyncEventBase+XSyncAlarmNotify] = HandleSyncAlarmNotify;
+#endif				/* EWMH */
 }
 
 
@@ -364,6 +447,25 @@ Window WindowOfEvent (XEvent *e)
     return None;
 }
 
+/*
+ * Replace the motion event e with the last of the motion events for the
+ * same window that are queued, or can be read without blocking, so that
+ * following the pointer needs no XQueryPointer.
+ */
+void CoalesceMotion (XEvent *e)
+{
+    XEvent next;
+
+    while (XEventsQueued (dpy, QueuedAfterReading) > 0) {
+	XPeekEvent (dpy, &next);
+	if (next.type != MotionNotify || next.xany.window != e->xany.window)
+	    break;
+	XNextEvent (dpy, e);
+	StashEventTime (e);
+	FixRootEvent (e);
+    }
+}
+
 void FixRootEvent (XEvent *e)
 {
     if (Scr->Root == Scr->RealRoot)
@@ -413,6 +515,167 @@ static ScreenInfo *GetTwmScreen(XEvent *event)
     return scr;
 }
 
+/***********************************************************************
+ *
+ *  Event statistics
+ *
+ *  With EventStatistics set, every handler run by DispatchEvent or
+ *  DispatchEvent2 is timed and the round trips it makes are counted
+ *  (see CountRequests), both per event type and per handler, into a
+ *  histogram of decades from 10us to 1s.  Times include the events a
+ *  handler dispatches itself, as interactive moves and resizes do.
+ *  f.dumpstats reports them.
+ *
+ ***********************************************************************
+ */
+
+#define STAT_BUCKETS	7	/* <10us <100us <1ms <10ms <100ms <1s more */
+#define STATS_SIZE	16384
+
+typedef struct EventStat {
+    unsigned long	calls;
+    unsigned long	time;		/* microseconds, all calls */
+    unsigned long	max;
+    unsigned long	roundtrips;
+    unsigned long	hist [STAT_BUCKETS];
+} EventStat;
+
+static struct {
+    event_proc	proc;
+    char	*name;
+} HandlerNames [] = {
+    { HandleExpose,		"HandleExpose" },
+    { HandleCreateNotify,	"HandleCreateNotify" },
+    { HandleDestroyNotify,	"HandleDestroyNotify" },
+    { HandleMapRequest,		"HandleMapRequest" },
+    { HandleMapNotify,		"HandleMapNotify" },
+    { HandleUnmapNotify,	"HandleUnmapNotify" },
+    { HandleMotionNotify,	"HandleMotionNotify" },
+    { HandleButtonRelease,	"HandleButtonRelease" },
+    { HandleButtonPress,	"HandleButtonPress" },
+    { HandleEnterNotify,	"HandleEnterNotify" },
+    { HandleLeaveNotify,	"HandleLeaveNotify" },
+    { HandleConfigureRequest,	"HandleConfigureRequest" },
+    { HandleClientMessage,	"HandleClientMessage" },
+    { HandleSelectionClear,	"HandleSelectionClear" },
+    { HandlePropertyNotify,	"HandlePropertyNotify" },
+    { HandleKeyPress,		"HandleKeyPress" },
+    { HandleKeyRelease,		"HandleKeyRelease" },
+    { HandleColormapNotify,	"HandleColormapNotify" },
+    { HandleVisibilityNotify,	"HandleVisibilityNotify" },
+    { HandleFocusChange,	"HandleFocusChange" },
+    { HandleShapeNotify,	"HandleShapeNotify" },
+#ifdef EWMH
+    { HandleSyncAlarmNotify,	"HandleSyncAlarmNotify" },
+#endif				/* EWMH */
+    { HandleUnknown,		"HandleUnknown" },
+    { NULL,			"other" }
+};
+#define NUM_HANDLERS	(sizeof (HandlerNames) / sizeof (HandlerNames [0]))
+
+Bool EventStatistics = False;
+static EventStat TypeStats [MAX_X_EVENT];
+static EventStat HandlerStats [NUM_HANDLERS];
+static unsigned long StatsSince;
+
+static void AddEventStat (EventStat *stat, unsigned long time,
+			  unsigned long roundtrips)
+{
+    unsigned long bound;
+    int b;
+
+    stat->calls++;
+    stat->time += time;
+    if (time > stat->max) stat->max = time;
+    stat->roundtrips += roundtrips;
+    for (b = 0, bound = 10; b < STAT_BUCKETS - 1 && time >= bound; b++)
+	bound *= 10;
+    stat->hist [b]++;
+}
+
+static void RunEventHandler (void)
+{
+    int type = Event.type;
+    event_proc proc = EventHandler [type];
+    unsigned long start, requests, before, after;
+    unsigned int h;
+
+    if (! EventStatistics) {
+	(*proc) ();
+	return;
+    }
+    if (StatsSince == 0) StatsSince = TimerNowUsec ();
+    CountRequests (&requests, &before);
+    start = TimerNowUsec ();
+    (*proc) ();
+    start = TimerNowUsec () - start;
+    CountRequests (&requests, &after);
+    for (h = 0; h < NUM_HANDLERS - 1; h++)
+	if (HandlerNames [h].proc == proc) break;
+    AddEventStat (&TypeStats [type], start, after - before);
+    AddEventStat (&HandlerStats [h], start, after - before);
+}
+
+static int FormatEventStat (char *buf, int size, char *name, EventStat *stat)
+{
+    int len, b;
+
+    len = snprintf (buf, size, "%-24s %8lu %10.1f %8lu %8lu %8lu ",
+		    name, stat->calls, stat->time / 1000.0,
+		    stat->time / stat->calls, stat->max, stat->roundtrips);
+    for (b = 0; b < STAT_BUCKETS && len < size; b++)
+	len += snprintf (buf + len, size - len, " %6lu", stat->hist [b]);
+    if (len < size) len += snprintf (buf + len, size - len, "\n");
+    return ((len < size) ? len : size);
+}
+
+/*
+ * f.dumpstats: write the statistics to stderr and to the
+ * WM_ETWM_EVENT_STATS property of the root window, or start collecting
+ * them if that was not being done.
+ */
+void DumpEventStats (void)
+{
+    static char header [] =
+	"%-24s %8s %10s %8s %8s %8s   <10us <100us   <1ms  <10ms <100ms"
+	"    <1s   more\n";
+    char *text;
+    int len, i;
+
+    if (! EventStatistics) {
+	EventStatistics = True;
+	StatsSince = TimerNowUsec ();
+	fprintf (stderr, "%s: collecting event statistics\n", ProgramName);
+	return;
+    }
+    if ((text = malloc (STATS_SIZE)) == NULL) return;
+    len = snprintf (text, STATS_SIZE, "event statistics over %.1f s\n",
+		    (TimerNowUsec () - StatsSince) / 1000000.0);
+    len += snprintf (text + len, STATS_SIZE - len,
+		     "passive grabs requested: %lu\n", GrabCount);
+    len += snprintf (text + len, STATS_SIZE - len, header, "event",
+		     "calls", "total ms", "mean us", "max us", "rtrips");
+    for (i = 0; i < MAX_X_EVENT && len < STATS_SIZE; i++) {
+	if (TypeStats [i].calls == 0) continue;
+	len += FormatEventStat (text + len, STATS_SIZE - len,
+				EventName (i), &TypeStats [i]);
+    }
+    if (len < STATS_SIZE)
+	len += snprintf (text + len, STATS_SIZE - len, header, "handler",
+			 "calls", "total ms", "mean us", "max us", "rtrips");
+    for (i = 0; i < NUM_HANDLERS && len < STATS_SIZE; i++) {
+	if (HandlerStats [i].calls == 0) continue;
+	len += FormatEventStat (text + len, STATS_SIZE - len,
+				HandlerNames [i].name, &HandlerStats [i]);
+    }
+    if (len >= STATS_SIZE) len = STATS_SIZE - 1;
+
+    fputs (text, stderr);
+    XChangeProperty (dpy, Scr->Root, _XA_WM_ETWM_EVENT_STATS, XA_STRING, 8,
+		     PropModeReplace, (unsigned char *) text, len);
+    free (text);
+}
+
 /***********************************************************************
  *
  *  Procedure:
@@ -448,7 +711,7 @@ Bool DispatchEvent2 (void)
 	    HandleExpose();
     } else {
 	if (Event.type>= 0 && Event.type < MAX_X_EVENT)
-	    (*EventHandler[Event.type])();
+	    RunEventHandler ();
     }
 
     return True;
@@ -472,6 +735,12 @@ Bool DispatchEvent (void)
 
     dumpevent(&Event);
 
+    if (Event.type == MappingNotify) {
+	/* for no screen in particular: the key bindings may have moved */
+	Scr = lastScr;
+	RefreshKeyGrabs (&Event.xmapping);
+	return True;
+    }
     if (!Scr) {
 	Scr = lastScr;	    /* XXX_MIKE - try not to leave Scr NULL */
 	return False;
@@ -488,13 +757,41 @@ Bool DispatchEvent (void)
 #ifdef SOUNDS
         play_sound(Event.type);
 #endif
-	(*EventHandler[Event.type])();
+	RunEventHandler ();
     }
     return True;
 }
 
 
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	FlushHints - publish the EWMH and WMH properties that the event
+ *		handlers marked stale
+ *
+ ***********************************************************************
+ */
+
+static void FlushHints (void)
+{
+#if defined(EWMH) || defined(WMH)
+    int scrnum;
+
+    for (scrnum = 0; scrnum < NumScreens; scrnum++) {
+	if (ScreenList [scrnum] == NULL) continue;
+#ifdef EWMH
+	FlushEwmh (ScreenList [scrnum]);
+#endif				/* EWMH */
+#ifdef WMH
+	FlushWmh (ScreenList [scrnum]);
+#endif				/* WMH */
+    }
+#endif
+}
+
+
+
 /***********************************************************************
  *
  *  Procedure:
@@ -507,24 +804,14 @@ void HandleEvents(void)
 {
     while (TRUE)
     {
-	if (enter_flag && !QLength(dpy)) {
-	    if (enter_win && enter_win != raise_win) {
-		AutoRaiseWindow (enter_win);  /* sets enter_flag T */
-	    } else {
-		enter_flag = FALSE;
-	    }
-	}
-	if ( leave_flag && !QLength(dpy) ) {
-	    if (leave_win && leave_win != lower_win) {
-		AutoLowerWindow (leave_win); /* sets leave_flag T */
-	    } else {
-		leave_flag = FALSE;
-	    }
-	}
 	if (ColortableThrashing && !QLength(dpy) && Scr) {
 	    InstallColormaps(ColormapNotify, NULL);
 	}
 	WindowMoved = FALSE;
+	if (!QLength (dpy)) {
+	    WMapFlush ();
+	    FlushHints ();
+	}
 
 	EtwmNextEvent (dpy, &Event);
 
@@ -544,19 +831,22 @@ extern unsigned long timefe;
 
 static void EtwmNextEvent (Display *display, XEvent  *event)
 {
+#ifdef VMS
     int animate = (AnimationActive && MaybeAnimate);
 
-#ifdef VMS
     if (QLength (display) != 0) {
 	nextEvent (event);
 	return;
     }
     if (animate && AnimationPending) Animate ();
+    TimerRun ();
     while (1) {
+       TimerWake (TimerNext ());
        sys$waitfr(timefe);
        sys$clref(timefe);
 
        if (animate && AnimationPending) Animate ();
+       TimerRun ();
        if (QLength (display) != 0) {
 	  nextEvent (event);
 	  return;
@@ -566,9 +856,8 @@ static void EtwmNextEvent (Display *display, XEvent  *event)
     int		found;
     fd_set	mask;
     int		fd;
-#ifndef USE_SIGNALS
-    struct timeval timeout, *tout = NULL;
-#endif
+    long	wait;
+    struct timeval timeout;
 
     if (RestartFlag)
 	DoRestart(CurrentTime);
@@ -578,65 +867,49 @@ static void EtwmNextEvent (Display *display, XEvent  *event)
     }
     fd = ConnectionNumber (display);
 
-#ifdef USE_SIGNALS
-    if (animate && AnimationPending) Animate ();
     while (1) {
-	FD_ZERO (&mask);
-	FD_SET  (fd, &mask);
-	found = select (fd + 1, (FDSET)&mask, (FDSET) 0, (FDSET) 0, 0);
+	/*
+	 * The queue is empty: run whatever timers are due (they may
+	 * well generate events of their own) and sleep until either
+	 * the server talks or the next deadline comes up.
+	 */
+	ScheduleAnimation ();
+	TimerRun ();
 	if (RestartFlag)
 	    DoRestart(CurrentTime);
-	if (found < 0) {
-	    if (errno == EINTR) {
-		if (animate)
-		    Animate ();
-	    }
-	    else perror ("select");
-	    continue;
-	}
-	if (FD_ISSET (fd, &mask)) {
+	if (XEventsQueued (display, QueuedAfterFlush) != 0) {
 	    nextEvent (event);
 	    return;
 	}
-    }
-#else /* USE_SIGNALS */
-    if (animate) TryToAnimate ();
-    if (RestartFlag)
-	DoRestart(CurrentTime);
-    if (! MaybeAnimate) {
-	nextEvent (event);
-	return;
-    }
-    if (animate) tout = (AnimationSpeed > 0) ? &timeout : NULL;
-    while (1) {
 	FD_ZERO (&mask);
 	FD_SET  (fd, &mask);
-	if (animate) {
-	    timeout = AnimateTimeout;
+	if (DecodePipe >= 0) FD_SET (DecodePipe, &mask);
+	if ((wait = TimerNext ()) >= 0) {
+	    timeout.tv_sec  = wait / 1000;
+	    timeout.tv_usec = (wait % 1000) * 1000;
 	}
-	found = select (fd + 1, (FDSET)&mask, (FDSET) 0, (FDSET) 0, tout);
+	found = select (((DecodePipe > fd) ? DecodePipe : fd) + 1, (FDSET)&mask,
+			(FDSET) 0, (FDSET) 0, (wait >= 0) ? &timeout : NULL);
 	if (RestartFlag)
 	    DoRestart(CurrentTime);
 	if (found < 0) {
 	    if (errno != EINTR) perror ("select");
 	    continue;
 	}
-	if (FD_ISSET (fd, &mask)) {
-	    nextEvent (event);
-	    return;
-	}
-	if (found == 0) {
-	    if (animate) TryToAnimate ();
-	    if (RestartFlag)
-		DoRestart(CurrentTime);
-	    if (! MaybeAnimate) {
+	if (found == 0)
+	    continue;
+	if ((DecodePipe >= 0) && FD_ISSET (DecodePipe, &mask)) {
+	    HandleDecodedImages ();
+	    if (XEventsQueued (display, QueuedAfterFlush) != 0) {
 		nextEvent (event);
 		return;
 	    }
-	    continue;
+	}
+	if (FD_ISSET (fd, &mask)) {
+	    nextEvent (event);
+	    return;
 	}
     }
-#endif /* USE_SIGNALS */
 #endif /* VMS */
 }
 
@@ -863,8 +1136,8 @@ void HandleFocusIn(XFocusInEvent *event)
     SetFocusVisualAttributes (Tmp_win, True);
     Scr->Focus = Tmp_win;
 #ifdef EWMH
-    Upd_NET_ACTIVE_WINDOW(Scr);
-    Upd_NET_WM_STATE(Scr, Tmp_win);
+    Dfr_NET_ACTIVE_WINDOW(Scr);
+    Dfr_NET_WM_STATE(Scr, Tmp_win);
 #endif				/* EWMH */
 }
 
@@ -882,8 +1155,8 @@ void HandleFocusOut(XFocusOutEvent *event)
     SetFocusVisualAttributes (Tmp_win, False);
     Scr->Focus= NULL;
 #ifdef EWMH
-    Upd_NET_ACTIVE_WINDOW(Scr);
-    Upd_NET_WM_STATE(Scr, Tmp_win);
+    Dfr_NET_ACTIVE_WINDOW(Scr);
+    Dfr_NET_WM_STATE(Scr, Tmp_win);
 #endif				/* EWMH */
 }
 
@@ -1229,7 +1502,8 @@ void HandleKeyPress(void)
 	XUngrabKeyboard (dpy, CurrentTime);
 	AlternateKeymap = 0;
     }
-    for (key = Scr->FuncKeyRoot.next; key != NULL; key = key->next)
+    for (key = Scr->FuncKeyHash [KEY_HASH (Event.xkey.keycode, modifier)];
+	 key != NULL; key = key->hnext)
     {
 	if (key->keycode == Event.xkey.keycode &&
 	    key->mods == modifier &&
@@ -1422,7 +1696,8 @@ void HandlePropertyNotify(void)
     unsigned long valuemask;		/* mask for create windows */
     XSetWindowAttributes attributes;	/* attributes for create windows */
     Pixmap pm;
-    int icon_change;
+    int icon_change, name_change;
+    XClassHint class;
     XRectangle inc_rect;
     XRectangle logical_rect;
 
@@ -1493,11 +1768,13 @@ void HandlePropertyNotify(void)
 	  *moz = '\0';
 	}
 #endif
+	name_change = strcmp (Tmp_win->full_name, (char*) prop);
 	free_window_names (Tmp_win, True, True, False);
 
 	Tmp_win->full_name = (char*) prop;
 	Tmp_win->name = (char*) prop;
 	Tmp_win->nameChanged = 1;
+	if (name_change) GetWindowPolicy (Tmp_win);
 	XmbTextExtents(Scr->TitleBarFont.font_set,
 		       Tmp_win->name, strlen (Tmp_win->name),
 		       &inc_rect, &logical_rect);
@@ -1547,6 +1824,7 @@ void HandlePropertyNotify(void)
 	 */
 	if (Tmp_win->icon_name == NoName) {
 	    Tmp_win->icon_name = Tmp_win->name;
+	    GetWindowIconPolicy (Tmp_win);
 	    RedoIcon();
 	}
 	break;
@@ -1566,10 +1844,30 @@ void HandlePropertyNotify(void)
 	Tmp_win->icon_name = (char*) prop;
 
 	if (icon_change) {
+	    GetWindowIconPolicy (Tmp_win);
 	    RedoIcon();
 	}
 	break;
 
+      case XA_WM_CLASS:
+	class = NoClass;
+	if (!XGetClassHint (dpy, Tmp_win->w, &class)) return;
+	if (class.res_name  == NULL) class.res_name  = NoName;
+	if (class.res_class == NULL) class.res_class = NoName;
+	if (!strcmp (class.res_name,  Tmp_win->class.res_name) &&
+	    !strcmp (class.res_class, Tmp_win->class.res_class)) {
+	    if (class.res_name  != NoName) XFree (class.res_name);
+	    if (class.res_class != NoName) XFree (class.res_class);
+	    return;
+	}
+	if (Tmp_win->class.res_name && Tmp_win->class.res_name != NoName)
+	    XFree ((char *) Tmp_win->class.res_name);
+	if (Tmp_win->class.res_class && Tmp_win->class.res_class != NoName)
+	    XFree ((char *) Tmp_win->class.res_class);
+	Tmp_win->class = class;
+	GetWindowPolicy (Tmp_win);
+	break;
+
       case XA_WM_HINTS:
 	if (Tmp_win->wmhints) XFree ((char *) Tmp_win->wmhints);
 	Tmp_win->wmhints = XGetWMHints(dpy, Event.xany.window);
@@ -1831,9 +2129,9 @@ void RedoIconName(void)
     XRectangle ink_rect;
     XRectangle logical_rect;
 
-    if (Scr->NoIconTitlebar || 
-	LookInNameList (Scr->NoIconTitle, Tmp_win->icon_name) ||
-	LookInList (Scr->NoIconTitle, Tmp_win->full_name, &Tmp_win->class)) goto wmapupd;
+    if (Scr->NoIconTitlebar ||
+	Tmp_win->policy.no_icon_title_icon ||
+	Tmp_win->policy.no_icon_title) goto wmapupd;
     if (Tmp_win->iconmanagerlist)
     {
 	/* let the expose event cause the repaint */
@@ -2112,7 +2410,7 @@ void HandleExpose(void)
 	}
 	else if (Tmp_win->icon && (Event.xany.window == Tmp_win->icon->w) &&
 		! Scr->NoIconTitlebar &&
-		! LookInList (Scr->NoIconTitle, Tmp_win->full_name, &Tmp_win->class))
+		! Tmp_win->policy.no_icon_title)
 	{
 	    PaintIcon (Tmp_win);
 	    flush_expose (Event.xany.window);
@@ -2211,6 +2509,7 @@ static void remove_window_from_ring (TwmWindow *tmp)
 	leave_win = NULL;
     }
     if (lower_win == Tmp_win) lower_win = NULL;
+    CancelAutoRaise (tmp);
 
     /*
      * 1. Unlink window
@@ -2269,7 +2568,7 @@ void HandleDestroyNotify(void)
 	Scr->Focus = (TwmWindow*) NULL;
 	FocusOnRoot();
 #ifdef EWMH
-	Upd_NET_ACTIVE_WINDOW(Scr);
+	Dfr_NET_ACTIVE_WINDOW(Scr);
 #endif				/* EWMH */
     }
     if (Scr->SaveWorkspaceFocus) {
@@ -2356,17 +2655,21 @@ void HandleDestroyNotify(void)
      * anything related to them must be done before here.
      * Icons are not child windows.
      */
+    StackRemoveWindow(Tmp_win);
     XDestroyWindow(dpy, Tmp_win->frame);
     if (Tmp_win->icon) {
 	if (Tmp_win->icon->w && !Tmp_win->icon_not_ours) {
 	    XDestroyWindow(dpy, Tmp_win->icon->w);
 	    IconDown (Tmp_win);
 	}
+	if (Tmp_win->icon->image != Scr->UnknownImage)
+	    ReleaseImage (Tmp_win->icon->image);
 	free (Tmp_win->icon);
 	Tmp_win->icon = NULL;
     }
     Tmp_win->occupation = 0;
     RemoveIconManager(Tmp_win);					/* 7 */
+    SpatialRemove(Tmp_win);
     if (Scr->FirstWindow == Tmp_win)
 	Scr->FirstWindow = Tmp_win->next;
     if (Tmp_win->prev != NULL)
@@ -2388,6 +2691,9 @@ void HandleDestroyNotify(void)
       XFree ((char *)Tmp_win->class.res_class);
     free_cwins (Tmp_win);					/* 9 */
     if (Tmp_win->titlebuttons) { 				/* 10 */ 
+	int i, nb = Scr->TBInfo.nleft + Scr->TBInfo.nright;
+
+	for (i = 0; i < nb; i++) ReleaseImage (Tmp_win->titlebuttons [i].image);
 	free(Tmp_win->titlebuttons);
 	Tmp_win->titlebuttons = NULL;
     }
@@ -2398,6 +2704,7 @@ void HandleDestroyNotify(void)
 	Tmp_win->squeeze_info = NULL;
     }
     DeleteHighlightWindows(Tmp_win);				/* 13 */
+    ReleaseImage (Tmp_win->LoliteImage);
     DeleteIconsList (Tmp_win);					/* 14 */
 
     free((char *)Tmp_win);
@@ -2446,7 +2753,7 @@ void HandleMapRequest(void)
 	GnomeAddClientWindow (Tmp_win); /* add the new window to the gnome client list */
 #endif /* GNOME */
 #ifdef EWMH
-	UpdWindowEwmh(Scr, Tmp_win);
+	DfrWindowEwmh(Scr, Tmp_win);
 #endif				/* EWMH */
 #ifdef WMH
 	UpdWindowWmh(Scr, Tmp_win);
@@ -2513,9 +2820,10 @@ void HandleMapRequest(void)
 	    case InactiveState:
                 if (!OCCUPY (Tmp_win, Scr->currentvs->wsw->currentwspc) &&
                     HandlingEvents && /* to avoid warping during startup */
-                    LookInList(Scr->WarpOnDeIconify, Tmp_win->full_name, &Tmp_win->class)) {
+                    Tmp_win->policy.warp_on_deiconify) {
                     if (!Scr->NoRaiseDeicon) {
 			XMapRaised(dpy, Tmp_win->frame);
+			StackRaised(Tmp_win);
                         //OtpRaise(Tmp_win, WinWin);
 		    }
                     AddToWorkSpace(Scr->currentvs->wsw->currentwspc->name, Tmp_win);
@@ -2541,7 +2849,7 @@ void HandleMapRequest(void)
     else
     {
       if (!OCCUPY (Tmp_win, Scr->currentvs->wsw->currentwspc) &&
-	  LookInList(Scr->WarpOnDeIconify, Tmp_win->full_name, &Tmp_win->class)) {
+	  Tmp_win->policy.warp_on_deiconify) {
 	  AddToWorkSpace(Scr->currentvs->wsw->currentwspc->name, Tmp_win);
       }
       if (1/*OCCUPY (Tmp_win, Scr->workSpaceMgr.activeWSPC)*/) {
@@ -2692,13 +3000,17 @@ void HandleMotionNotify(void)
 {
     if (ResizeWindow != (Window) 0)
     {
-	XQueryPointer( dpy, Event.xany.window,
-	    &(Event.xmotion.root), &JunkChild,
-	    &(Event.xmotion.x_root), &(Event.xmotion.y_root),
-	    &(Event.xmotion.x), &(Event.xmotion.y),
-	    &JunkMask);
+	if (Scr->CompressMotion) {
+	    CoalesceMotion (&Event);
+	} else {
+	    XQueryPointer( dpy, Event.xany.window,
+		&(Event.xmotion.root), &JunkChild,
+		&(Event.xmotion.x_root), &(Event.xmotion.y_root),
+		&(Event.xmotion.x), &(Event.xmotion.y),
+		&JunkMask);
 
-	FixRootEvent (&Event);
+	    FixRootEvent (&Event);
+	}
 	/* Set WindowMoved appropriately so that f.deltastop will
 	   work with resize as well as move. */
 	if (abs (Event.xmotion.x - ResizeOrigX) >= Scr->MoveDelta
@@ -2707,9 +3019,14 @@ void HandleMotionNotify(void)
 
 	Tmp_win = GetTwmWindow(ResizeWindow);
 	if (Tmp_win && Tmp_win->winbox) {
-	    XTranslateCoordinates (dpy, Scr->Root, Tmp_win->winbox->window,
-		Event.xmotion.x_root, Event.xmotion.y_root,
-		&(Event.xmotion.x_root), &(Event.xmotion.y_root), &JunkChild);
+	    if (Scr->CompressMotion)
+		RootToWinBox (Tmp_win->winbox,
+		    Event.xmotion.x_root, Event.xmotion.y_root,
+		    &(Event.xmotion.x_root), &(Event.xmotion.y_root));
+	    else
+		XTranslateCoordinates (dpy, Scr->Root, Tmp_win->winbox->window,
+		    Event.xmotion.x_root, Event.xmotion.y_root,
+		    &(Event.xmotion.x_root), &(Event.xmotion.y_root), &JunkChild);
 	}
 	DoResize(Event.xmotion.x_root, Event.xmotion.y_root, Tmp_win);
     }
@@ -2860,6 +3177,7 @@ void HandleButtonRelease(void)
 	    enter_win = NULL;
 	    raise_win = ((DragWindow == Tmp_win->frame && !Scr->NoRaiseMove)
 			 ? Tmp_win : NULL);
+	    TimerSet (AutoRaiseSettle, NULL, 0);
 	}
 
 	/* CCC equivalent code for auto lower not needed? */
@@ -2870,6 +3188,7 @@ void HandleButtonRelease(void)
 	    leave_win = NULL;
 	    lower_win = ((DragWindow == Tmp_win->frame)
 			 ? Tmp_win : NULL);
+	    TimerSet (AutoLowerSettle, NULL, 0);
 	}
 #endif
 
@@ -3368,7 +3687,9 @@ void HandleButtonPress(void)
     RootFunction = 0;
 
     /* see if there already is a key defined for this context */
-    for (tmp = Scr->FuncButtonRoot.next; tmp != NULL; tmp = tmp->next) {
+    for (tmp = Scr->FuncButtonHash [BUTTON_HASH (Event.xbutton.button,
+						 Context, modifier)];
+	 tmp != NULL; tmp = tmp->hnext) {
 	if ((tmp->num  == Event.xbutton.button) &&
 	    (tmp->cont == Context) && (tmp->mods == modifier))
 	    break;
@@ -3543,11 +3864,6 @@ void HandleEnterNotify(void)
 		    (!Tmp_win->iconmanagerlist ||
 		      Tmp_win->iconmanagerlist->w != ewp->window)) {
 		ColormapWindow *cwin;
-#ifdef VMS
-		float timeout = 0.0125;
-#else
-		static struct timeval tout, timeout = {0,12500};
-#endif
 
 		if (XFindContext(dpy, Tmp_win->w, ColormapContext,
 				 (XPointer *)&cwin) == XCNOENT) {
@@ -3557,42 +3873,7 @@ void HandleEnterNotify(void)
 		if ((ewp->detail != NotifyInferior
 		     || Tmp_win->frame == ewp->window)
 		     && (!cwin || cwin->visibility != VisibilityUnobscured)) {
-		    int x, y, px, py, d, i;
-		    Window w;
-
-		    XQueryPointer(dpy, Scr->Root, &w, &w, &px, &py,
-				  &d, &d, (unsigned int *)&d);
-
-		    /* The granularity of RaiseDelay is about 25 ms.
-		     * The timeout variable is set to 12.5 ms since we
-		     * pass this way twice each time a twm window is
-		     * entered.
-		     */
-		    for (i = 25; i < RaiseDelay; i += 25) {
-#ifdef VMS
-			lib$wait(&timeout);
-#else
-			tout = timeout;
-			select(0, 0, 0, 0, &tout);
-#endif
-			/* Did we leave this window already? */
-			scanArgs.w = ewp->window;
-			scanArgs.leaves = scanArgs.enters = False;
-			(void) XCheckIfEvent(dpy, &dummy, HENQueueScanner,
-					     (char *) &scanArgs);
-			if (scanArgs.leaves && !scanArgs.inferior) return;
-
-			XQueryPointer(dpy, Scr->Root, &w, &w, &x, &y,
-				      &d, &d, (unsigned int *)&d);
-
-			/* Has the pointer moved?  If so reset the loop cnt.
-			 * We want the pointer to be still for RaiseDelay
-			 * milliseconds before terminating the loop
-			 */
-			if (x != px || y != py) {
-			    i = 0; px = x; py = y;
-			}
-		    }
+		    DelayAutoRaise (Tmp_win);
 		}
 	    }
 
@@ -3764,7 +4045,8 @@ void HandleEnterNotify(void)
 	     */
 	    if (Tmp_win->auto_raise) {
 		enter_win = Tmp_win;
-		if (enter_flag == FALSE) AutoRaiseWindow (Tmp_win);
+		if (enter_flag == FALSE && delay_win != Tmp_win)
+		    AutoRaiseWindow (Tmp_win);
 	    } else if (enter_flag && raise_win == Tmp_win)
 	      enter_win = Tmp_win;
 	    /*
@@ -3967,6 +4249,10 @@ void HandleLeaveNotify(void)
 		}
 	    }
 	}
+	if (Event.xcrossing.window == Tmp_win->frame &&
+	    Event.xcrossing.detail != NotifyInferior)
+	    CancelAutoRaise (Tmp_win);
+
 	/* Autolower modification. */
 	if (Tmp_win->auto_lower) {
 	    leave_win = Tmp_win;
@@ -4049,6 +4335,7 @@ void HandleConfigureRequest(void)
 	xwc.stack_mode = cre->detail;
 	XConfigureWindow (dpy, Tmp_win->frame, 
 			  cre->value_mask & (CWSibling | CWStackMode), &xwc);
+	StackConfigured (Tmp_win, cre->value_mask & (CWSibling | CWStackMode), &xwc);
 	sendEvent = True;
     }
 
@@ -4146,6 +4433,52 @@ void HandleShapeNotify (void)
     SetFrameShape (Tmp_win);
 }
 
+#ifdef EWMH
+/***********************************************************************
+ *
+ *  Procedure:
+ *	HandleSyncAlarmNotify - a client has caught up with a
+ *	_NET_WM_SYNC_REQUEST; the alarm is associated with its window
+ *
+ ***********************************************************************
+ */
+
+void HandleSyncAlarmNotify (void)
+{
+    if (Tmp_win == NULL)
+	return;
+    if (TwmGotSyncAlarm (Tmp_win, &Event))
+	ResizeSyncDone (Tmp_win);
+}
+#endif				/* EWMH */
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	HandleSyncAlarms - handle the alarms already queued; XMaskEvent
+ *	never returns extension events, so the resize loops call this
+ *	before they block, or the client would be throttled by the
+ *	_NET_WM_SYNC_REQUEST timeout for the whole drag
+ *
+ ***********************************************************************
+ */
+
+void HandleSyncAlarms (void)
+{
+#ifdef EWMH
+    XEvent ev;
+    TwmWindow *twin;
+
+    if (!HasSync)
+	return;
+    while (XCheckTypedEvent (dpy, SyncEventBase + XSyncAlarmNotify, &ev)) {
+	twin = GetTwmWindow (ev.xany.window);
+	if (twin != NULL && TwmGotSyncAlarm (twin, &ev))
+	    ResizeSyncDone (twin);
+    }
+#endif				/* EWMH */
+}
+
 
 
 /***********************************************************************
@@ -4182,7 +4515,7 @@ void HandleUnknown(void)
 
 int Transient(Window w, Window *propw)
 {
-    return (XGetTransientForHint(dpy, w, propw));
+    return (TwmGetTransientForHint(dpy, w, propw));
 }
 
 
@@ -4450,12 +4783,11 @@ void ConfigureRootWindow (XEvent *ev)
     }
 }
 
-static void dumpevent (XEvent *e)
+static char *EventName (int type)
 {
     char *name = "Unknown event";
 
-    if (! tracefile) return;
-    switch (e->type) {
+    switch (type) {
       case KeyPress:  name = "KeyPress"; break;
       case KeyRelease:  name = "KeyRelease"; break;
       case ButtonPress:  name = "ButtonPress"; break;
@@ -4489,8 +4821,22 @@ static void dumpevent (XEvent *e)
       case ColormapNotify:  name = "ColormapNotify"; break;
       case ClientMessage:  name = "ClientMessage"; break;
       case MappingNotify:  name = "MappingNotify"; break;
+      default:
+	if (HasShape && type == ShapeEventBase + ShapeNotify)
+	    name = "ShapeNotify";
+#ifdef EWMH
+	if (HasSync && type == SyncEventBase + XSyncAlarmNotify)
+	    name = "XSyncAlarmNotify";
+#endif				/* EWMH */
+	break;
     }
-    fprintf (tracefile, "event:  %s in window 0x%x\n", name,
+    return (name);
+}
+
+static void dumpevent (XEvent *e)
+{
+    if (! tracefile) return;
+    fprintf (tracefile, "event:  %s in window 0x%x\n", EventName (e->type),
 	     (unsigned int)e->xany.window);
     switch (e->type) {
       case KeyPress:
@@ -80,9 +80,12 @@ extern void AutoLowerWindow(TwmWindow *tmp);
 #define LastTimestamp() lastTimestamp
 extern Window WindowOfEvent (XEvent *e);
 extern void FixRootEvent (XEvent *e);
+extern void CoalesceMotion (XEvent *e);
 extern Bool DispatchEvent(void);
 extern Bool DispatchEvent2(void);
+extern void HandleSyncAlarms(void);
 extern void HandleEvents(void);
+extern void DumpEventStats(void);
 extern void HandleExpose(void);
 extern void HandleDestroyNotify(void);
 extern void HandleMapRequest(void);
@@ -131,6 +134,7 @@ extern int CurrentDragX;
 extern int CurrentDragY;
 extern int Context;
 extern FILE *tracefile;
+extern Bool EventStatistics;
 
 extern int ButtonPressed;
 extern int Cancel;
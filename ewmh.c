@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "ewmh.h"
 #include "screen.h"
+#include "util.h"
 #include <X11/Xos.h>
 #include <X11/Xatom.h>
 #include <X11/Xmu/CharSet.h>
@@ -18,6 +19,8 @@
   *		value according to the window manager
   * - Ret_*	retrieves the root or window property and synchronizes the
   *		setting with the window manager
+  * - Dfr_*	marks the root or window property stale, so that the next
+  *		FlushEwmh() updates it only once however many times it changed
   * - Rcv_*	processes a client message
   * - Snd_*	sends a client message
   */
@@ -349,7 +352,7 @@ Set_NET_WM_atoms(Window window, Atom property, const Atom **defs, unsigned flags
     int count = 0;
 
     bits_to_atoms(data, &count, defs, flags);
-    XChangeProperty(dpy, window, property, XA_ATOM, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, property, XA_ATOM, 32, PropModeReplace,
 		    (unsigned char *) data, count);
 }
 
@@ -393,7 +396,7 @@ Get_NET_WM_atoms(Window window, Atom property, const Atom **defs, unsigned *flag
     long *prop = NULL;
 
     status =
-	XGetWindowProperty(dpy, window, property, 0L, 32L, False, XA_ATOM, &actual_type,
+	TwmGetWindowProperty(dpy, window, property, 0L, 32L, False, XA_ATOM, &actual_type,
 			   &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None) {
@@ -849,7 +852,7 @@ Set_NET_SUPPORTED(Window root)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_SUPPORTED, XA_ATOM, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_SUPPORTED, XA_ATOM, 32, PropModeReplace,
 		    (unsigned char *) data, sizeof(data) / sizeof(long));
 }
 
@@ -873,7 +876,7 @@ Ini_NET_SUPPORTED(ScreenInfo *scr)
 static void
 Del_NET_SUPPORTED(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_SUPPORTED);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_SUPPORTED);
     scr->ewmh.props._NET_SUPPORTED = 0;
 }
 
@@ -901,7 +904,7 @@ Set_NET_CLIENT_LIST(Window root, Window *windows, int count)
 	count = 0;
     for (i = 0; i < count; i++)
 	data[i] = (long) windows[i];
-    XChangeProperty(dpy, root, _XA_NET_CLIENT_LIST, XA_WINDOW, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_CLIENT_LIST, XA_WINDOW, 32, PropModeReplace,
 		    (unsigned char *) data, count);
     free(data);
 }
@@ -930,7 +933,19 @@ Upd_NET_CLIENT_LIST(ScreenInfo *scr)
 	scr->ewmh.props._NET_CLIENT_LIST = 1;
 	free(scr->ewmh.clients);
 	scr->ewmh.clients = clients;
-    }
+    } else
+	free(clients);
+}
+
+/** @brief Defer updating the client list.
+  * @param scr - screen
+  *
+  * The list is only rebuilt by the next FlushEwmh().
+  */
+void
+Dfr_NET_CLIENT_LIST(ScreenInfo *scr)
+{
+    scr->ewmh.dirty._NET_CLIENT_LIST = 1;
 }
 
 /** @brief Delete the client list.
@@ -940,7 +955,7 @@ Upd_NET_CLIENT_LIST(ScreenInfo *scr)
 static void
 Del_NET_CLIENT_LIST(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_CLIENT_LIST);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_CLIENT_LIST);
     scr->ewmh.props._NET_CLIENT_LIST = 0;
 }
 
@@ -983,7 +998,7 @@ Set_NET_CLIENT_LIST_STACKING(Window root, Window *windows, int count)
 	count = 0;
     for (i = 0; i < count; i++)
 	data[i] = (long) windows[i];
-    XChangeProperty(dpy, root, _XA_NET_CLIENT_LIST_STACKING, XA_WINDOW, 32,
+    TwmChangeProperty(dpy, root, _XA_NET_CLIENT_LIST_STACKING, XA_WINDOW, 32,
 		    PropModeReplace, (unsigned char *) data, count);
     free(data);
 }
@@ -1012,13 +1027,26 @@ Upd_NET_CLIENT_LIST_STACKING(ScreenInfo *scr)
 	scr->ewmh.props._NET_CLIENT_LIST_STACKING = 1;
 	free(scr->ewmh.stacking);
 	scr->ewmh.stacking = stacking;
-    }
+    } else
+	free(stacking);
+}
+
+/** @brief Defer updating the client list in stacking order.
+  * @param scr - screen
+  *
+  * Raising a window occupying several workspaces restacks each of them: the
+  * list is only rebuilt once, by the next FlushEwmh().
+  */
+void
+Dfr_NET_CLIENT_LIST_STACKING(ScreenInfo *scr)
+{
+    scr->ewmh.dirty._NET_CLIENT_LIST_STACKING = 1;
 }
 
 static void
 Del_NET_CLIENT_LIST_STACKING(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_CLIENT_LIST_STACKING);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_CLIENT_LIST_STACKING);
 }
 
 /** @} */
@@ -1036,7 +1064,7 @@ Set_NET_NUMBER_OF_DESKTOPS(Window root, long number)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_NUMBER_OF_DESKTOPS, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, root, _XA_NET_NUMBER_OF_DESKTOPS, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) &number, 1);
 }
 
@@ -1053,7 +1081,7 @@ Get_NET_NUMBER_OF_DESKTOPS(Window root, int *number)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_NUMBER_OF_DESKTOPS, 0L, 1L, False,
+	TwmGetWindowProperty(dpy, root, _XA_NET_NUMBER_OF_DESKTOPS, 0L, 1L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -1153,7 +1181,7 @@ Set_NET_DESKTOP_GEOMETRY(Window root, struct NetSize *geometry)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_DESKTOP_GEOMETRY, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_DESKTOP_GEOMETRY, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) geometry, 2);
 }
 
@@ -1170,7 +1198,7 @@ Get_NET_DESKTOP_GEOMETRY(Window root, struct NetSize *geometry)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_DESKTOP_GEOMETRY, 0L, 2L, False,
+	TwmGetWindowProperty(dpy, root, _XA_NET_DESKTOP_GEOMETRY, 0L, 2L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 2) {
@@ -1258,7 +1286,7 @@ Set_NET_DESKTOP_VIEWPORT(Window root, struct NetPosition *pos, int desktops)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) pos, desktops * 2);
 }
 
@@ -1280,7 +1308,7 @@ Get_NET_DESKTOP_VIEWPORT(Window root, struct NetPosition **pos, int *desktops)
 	*desktops = 0;
     }
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, 0L, 2L, False,
+	TwmGetWindowProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, 0L, 2L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 2) {
@@ -1291,7 +1319,7 @@ Get_NET_DESKTOP_VIEWPORT(Window root, struct NetPosition **pos, int *desktops)
     XFree(prop);
     len = ((bytes_after + 3) >> 2) + 2;
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, 0L, len, False,
+	TwmGetWindowProperty(dpy, root, _XA_NET_DESKTOP_VIEWPORT, 0L, len, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < len || nitems & 0x1) {
@@ -1393,7 +1421,7 @@ Set_NET_CURRENT_DESKTOP(Window root, long desktop)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_CURRENT_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_CURRENT_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) &desktop, 1);
 }
 
@@ -1410,7 +1438,7 @@ Get_NET_CURRENT_DESKTOP(Window root, int *desktop)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_CURRENT_DESKTOP, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, root, _XA_NET_CURRENT_DESKTOP, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -1515,7 +1543,7 @@ Set_NET_DESKTOP_NAMES(Window root, char **names, int count)
 	    /* Nul terminated, not null separated */
 	    text.value[text.nitems] = '\0';
 	    text.nitems += 1;
-	    XSetTextProperty(dpy, root, &text, _XA_NET_DESKTOP_NAMES);
+	    TwmSetTextProperty(dpy, root, &text, _XA_NET_DESKTOP_NAMES);
 	    XFree(text.value);
 	}
     } else {
@@ -1523,7 +1551,7 @@ Set_NET_DESKTOP_NAMES(Window root, char **names, int count)
 	fprintf(stderr, "ERROR: no desktop names!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, root, _XA_NET_DESKTOP_NAMES);
+	TwmDeleteProperty(dpy, root, _XA_NET_DESKTOP_NAMES);
     }
 }
 
@@ -1536,7 +1564,7 @@ Get_NET_DESKTOP_NAMES(Window root, char ***names, int *count)
     fprintf(stderr, "%s for root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, root, &text, _XA_NET_DESKTOP_NAMES) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, root, &text, _XA_NET_DESKTOP_NAMES) && text.nitems > 0) {
 	/* Nul terminated, not null separated */
 	text.nitems -= 1;
 	if (XmbTextPropertyToTextList(dpy, &text, names, count) == Success) {
@@ -1626,7 +1654,7 @@ Set_NET_ACTIVE_WINDOW(Window root, Window window)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_ACTIVE_WINDOW, XA_WINDOW, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_ACTIVE_WINDOW, XA_WINDOW, 32, PropModeReplace,
 		    (unsigned char *) &data, 1);
 }
 
@@ -1643,7 +1671,7 @@ Get_NET_ACTIVE_WINDOW(Window root, Window *window)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_ACTIVE_WINDOW, 0L, 1L, False, XA_WINDOW,
+	TwmGetWindowProperty(dpy, root, _XA_NET_ACTIVE_WINDOW, 0L, 1L, False, XA_WINDOW,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -1680,6 +1708,18 @@ Upd_NET_ACTIVE_WINDOW(ScreenInfo *scr)
     }
 }
 
+/** @brief Defer updating the active window.
+  * @param scr - screen
+  *
+  * A FocusOut followed by a FocusIn only changes the property once, or not at
+  * all when the focus comes back to the same window.
+  */
+void
+Dfr_NET_ACTIVE_WINDOW(ScreenInfo *scr)
+{
+    scr->ewmh.dirty._NET_ACTIVE_WINDOW = 1;
+}
+
 static void
 Ini_NET_ACTIVE_WINDOW(ScreenInfo *scr)
 {
@@ -1757,7 +1797,7 @@ Set_NET_WORKAREA(Window root, struct NetGeometry *workarea, int workareas)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_WORKAREA, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_WORKAREA, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) workarea, workareas * 4);
 }
 
@@ -1797,7 +1837,7 @@ Upd_NET_WORKAREA(ScreenInfo *scr)
 static void
 Del_NET_WORKAREA(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_WORKAREA);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_WORKAREA);
     scr->ewmh.props._NET_WORKAREA = 0;
 }
 
@@ -1828,9 +1868,9 @@ Set_NET_SUPPORTING_WM_CHECK(Window root, Window window)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_SUPPORTING_WM_CHECK, XA_WINDOW, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_SUPPORTING_WM_CHECK, XA_WINDOW, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
-    XChangeProperty(dpy, root, _XA_NET_SUPPORTING_WM_CHECK, XA_WINDOW, 32,
+    TwmChangeProperty(dpy, root, _XA_NET_SUPPORTING_WM_CHECK, XA_WINDOW, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
 }
 
@@ -1863,7 +1903,7 @@ Upd_NET_SUPPORTING_WM_CHECK(ScreenInfo *scr)
 static void
 Del_NET_SUPPORTING_WM_CHECK(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_SUPPORTING_WM_CHECK);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_SUPPORTING_WM_CHECK);
     scr->ewmh.props._NET_SUPPORTING_WM_CHECK = 0;
     scr->ewmh.check = None;
 }
@@ -1894,7 +1934,7 @@ Set_NET_VIRTUAL_ROOTS(Window root, Window *windows, int count)
 	count = 0;
     for (i = 0; i < count; i++)
 	data[i] = (long) windows[i];
-    XChangeProperty(dpy, root, _XA_NET_VIRTUAL_ROOTS, XA_WINDOW, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_VIRTUAL_ROOTS, XA_WINDOW, 32, PropModeReplace,
 		    (unsigned char *) data, count);
     free(data);
 }
@@ -1932,7 +1972,7 @@ Upd_NET_VIRTUAL_ROOTS(ScreenInfo *scr)
 void
 Del_NET_VIRTUAL_ROOTS(ScreenInfo *scr)
 {
-    XDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_VIRTUAL_ROOTS);
+    TwmDeleteProperty(dpy, TwmNetRoot(scr), _XA_NET_VIRTUAL_ROOTS);
     scr->ewmh.props._NET_VIRTUAL_ROOTS = 0;
 }
 
@@ -1954,7 +1994,7 @@ Set_NET_DESKTOP_LAYOUT(Window root, struct NetLayout *layout)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_DESKTOP_LAYOUT, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_DESKTOP_LAYOUT, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) layout, 4);
 }
 
@@ -1971,7 +2011,7 @@ Get_NET_DESKTOP_LAYOUT(Window root, struct NetLayout *layout)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_DESKTOP_LAYOUT, 0L, 4L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, root, _XA_NET_DESKTOP_LAYOUT, 0L, 4L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || actual_format != 32 || nitems < 3) {
@@ -2177,7 +2217,7 @@ Set_NET_SHOWING_DESKTOP(Window root, Bool showing)
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_SHOWING_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, root, _XA_NET_SHOWING_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) &data, 1);
 }
 
@@ -2198,7 +2238,7 @@ Get_NET_SHOWING_DESKTOP(Window root, Bool *flag)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, root, _XA_NET_SHOWING_DESKTOP, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, root, _XA_NET_SHOWING_DESKTOP, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -2297,7 +2337,7 @@ Set_WM_CLASS(Window window, XClassHint *class)
     if (list[1] == NULL)
 	list[1] = "";
     if (XmbTextListToTextProperty(dpy, list, 2, XStdICCTextStyle, &text) == Success) {
-	XSetTextProperty(dpy, window, &text, XA_WM_CLASS);
+	TwmSetTextProperty(dpy, window, &text, XA_WM_CLASS);
 	if (text.value != NULL)
 	    XFree(text.value);
     }
@@ -2314,7 +2354,7 @@ Get_WM_CLASS(Window window, XClassHint *class)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, window, &text, XA_WM_CLASS) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, XA_WM_CLASS) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		if (count >= 1)
@@ -2427,7 +2467,7 @@ Set_WM_CLIENT_MACHINE(Window window, char *machine)
 	char *list[2] = { machine, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XStdICCTextStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, XA_WM_CLIENT_MACHINE);
+	    TwmSetTextProperty(dpy, window, &text, XA_WM_CLIENT_MACHINE);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2436,7 +2476,7 @@ Set_WM_CLIENT_MACHINE(Window window, char *machine)
 	fprintf(stderr, "ERROR: no client machine!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, XA_WM_CLIENT_MACHINE);
+	TwmDeleteProperty(dpy, window, XA_WM_CLIENT_MACHINE);
     }
 }
 
@@ -2451,7 +2491,7 @@ Get_WM_CLIENT_MACHINE(Window window, char **machine)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, window, &text, XA_WM_CLIENT_MACHINE) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, XA_WM_CLIENT_MACHINE) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*machine = strdup(list[0]);
@@ -2551,7 +2591,7 @@ Set_WM_COMMAND(Window window, char **command, int count)
 
 	if (XmbTextListToTextProperty(dpy, command, count, XStdICCTextStyle, &text) ==
 	    Success) {
-	    XSetTextProperty(dpy, window, &text, XA_WM_COMMAND);
+	    TwmSetTextProperty(dpy, window, &text, XA_WM_COMMAND);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2560,7 +2600,7 @@ Set_WM_COMMAND(Window window, char **command, int count)
 	fprintf(stderr, "ERROR: no command!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, XA_WM_COMMAND);
+	TwmDeleteProperty(dpy, window, XA_WM_COMMAND);
     }
 }
 
@@ -2573,7 +2613,7 @@ Get_WM_COMMAND(Window window, char ***command, int *count)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, window, &text, XA_WM_COMMAND) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, XA_WM_COMMAND) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, command, count) == Success) {
 	    if (*count > 0) {
 		XFree(text.value);
@@ -2632,7 +2672,7 @@ Set_NET_WM_NAME(Window window, char *name)
 	char *list[2] = { name, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XUTF8StringStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, _XA_NET_WM_NAME);
+	    TwmSetTextProperty(dpy, window, &text, _XA_NET_WM_NAME);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2641,7 +2681,7 @@ Set_NET_WM_NAME(Window window, char *name)
 	fprintf(stderr, "ERROR: no name!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, _XA_NET_WM_NAME);
+	TwmDeleteProperty(dpy, window, _XA_NET_WM_NAME);
     }
 }
 
@@ -2656,7 +2696,7 @@ Get_NET_WM_NAME(Window window, char **name)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, window, &text, _XA_NET_WM_NAME) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, _XA_NET_WM_NAME) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*name = strdup(list[0]);
@@ -2669,7 +2709,7 @@ Get_NET_WM_NAME(Window window, char **name)
 	XFree(text.value);
     }
     /* when no _NET_WM_NAME go after WM_NAME */
-    if (XGetTextProperty(dpy, window, &text, XA_WM_NAME) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, XA_WM_NAME) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*name = strdup(list[0]);
@@ -2749,7 +2789,7 @@ Set_NET_WM_VISIBLE_NAME(Window window, char *name)
 	char *list[2] = { name, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XUTF8StringStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, _XA_NET_WM_VISIBLE_NAME);
+	    TwmSetTextProperty(dpy, window, &text, _XA_NET_WM_VISIBLE_NAME);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2758,14 +2798,14 @@ Set_NET_WM_VISIBLE_NAME(Window window, char *name)
 	fprintf(stderr, "ERROR: no visible name!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, _XA_NET_WM_VISIBLE_NAME);
+	TwmDeleteProperty(dpy, window, _XA_NET_WM_VISIBLE_NAME);
     }
 }
 
 void
 Del_NET_WM_VISIBLE_NAME(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_VISIBLE_NAME);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_VISIBLE_NAME);
     twin->ewmh.props._NET_WM_VISIBLE_NAME = 0;
     free(twin->ewmh.visible_name);
     twin->ewmh.visible_name = NULL;
@@ -2823,7 +2863,7 @@ Set_NET_WM_ICON_NAME(Window window, char *name)
 	char *list[2] = { name, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XUTF8StringStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, _XA_NET_WM_ICON_NAME);
+	    TwmSetTextProperty(dpy, window, &text, _XA_NET_WM_ICON_NAME);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2832,7 +2872,7 @@ Set_NET_WM_ICON_NAME(Window window, char *name)
 	fprintf(stderr, "ERROR: no icon name!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, _XA_NET_WM_ICON_NAME);
+	TwmDeleteProperty(dpy, window, _XA_NET_WM_ICON_NAME);
     }
 }
 
@@ -2847,7 +2887,7 @@ Get_NET_WM_ICON_NAME(Window window, char **name)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    if (XGetTextProperty(dpy, window, &text, _XA_NET_WM_ICON_NAME) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, _XA_NET_WM_ICON_NAME) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*name = strdup(list[0]);
@@ -2860,7 +2900,7 @@ Get_NET_WM_ICON_NAME(Window window, char **name)
 	XFree(text.value);
     }
     /* when no _NET_WM_ICON_NAME go after WM_ICON_NAME */
-    if (XGetTextProperty(dpy, window, &text, XA_WM_ICON_NAME) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, XA_WM_ICON_NAME) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*name = strdup(list[0]);
@@ -2925,7 +2965,7 @@ Set_NET_WM_VISIBLE_ICON_NAME(Window window, char *name)
 	char *list[2] = { name, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XUTF8StringStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, _XA_NET_WM_VISIBLE_ICON_NAME);
+	    TwmSetTextProperty(dpy, window, &text, _XA_NET_WM_VISIBLE_ICON_NAME);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -2934,14 +2974,14 @@ Set_NET_WM_VISIBLE_ICON_NAME(Window window, char *name)
 	fprintf(stderr, "ERROR: no visible icon name!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, _XA_NET_WM_VISIBLE_ICON_NAME);
+	TwmDeleteProperty(dpy, window, _XA_NET_WM_VISIBLE_ICON_NAME);
     }
 }
 
 void
 Del_NET_WM_VISIBLE_ICON_NAME(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_VISIBLE_ICON_NAME);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_VISIBLE_ICON_NAME);
     twin->ewmh.props._NET_WM_VISIBLE_ICON_NAME = 0;
     free(twin->ewmh.visible_icon_name);
     twin->ewmh.visible_icon_name = NULL;
@@ -3012,7 +3052,7 @@ Set_NET_WM_DESKTOP(Window window, long desktop)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_DESKTOP, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) &desktop, 1);
 }
 
@@ -3035,7 +3075,7 @@ Get_NET_WM_DESKTOP(Window window, int *desktop)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None) {
@@ -3057,7 +3097,7 @@ Get_NET_WM_DESKTOP(Window window, int *desktop)
 void
 Del_NET_WM_DESKTOP(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_DESKTOP);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_DESKTOP);
     twin->ewmh.props._NET_WM_DESKTOP = 0;
     twin->ewmh.desktop = -2;
 }
@@ -3507,6 +3547,31 @@ Upd_NET_WM_STATE(ScreenInfo *scr, TwmWindow *twin)
     }
 }
 
+/** @brief Queue a window whose properties are stale.
+  * @param twin - TWM window
+  *
+  * FlushEwmh() updates the dirty properties of the queued windows.
+  */
+static void
+queue_window(ScreenInfo *scr, TwmWindow *twin)
+{
+    if (!twin->ewmh.queued) {
+	twin->ewmh.queued = True;
+	twin->ewmh.next_dirty = scr->ewmh.dirty_windows;
+	scr->ewmh.dirty_windows = twin;
+    }
+}
+
+/** @brief Defer updating the window state.
+  * @param twin - TWM window
+  */
+void
+Dfr_NET_WM_STATE(ScreenInfo *scr, TwmWindow *twin)
+{
+    twin->ewmh.dirty._NET_WM_STATE = 1;
+    queue_window(scr, twin);
+}
+
 /** @brief Initialize the window state.
   * @param twin - TWM window
   *
@@ -3527,7 +3592,7 @@ Ini_NET_WM_STATE(TwmWindow *twin)
 void
 Del_NET_WM_STATE(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_STATE);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_STATE);
     twin->ewmh.props._NET_WM_STATE = 0;
     twin->ewmh.state = 0;
 }
@@ -3673,7 +3738,7 @@ Get_NET_WM_ALLOWED_ACTIONS(Window window, unsigned *allowed)
 void
 Del_NET_WM_ALLOWED_ACTIONS(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_ALLOWED_ACTIONS);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_ALLOWED_ACTIONS);
     twin->ewmh.props._NET_WM_ALLOWED_ACTIONS = 0;
     twin->ewmh.allowed = -1U;
 }
@@ -3729,7 +3794,7 @@ Set_NET_WM_STRUT(Window window, struct NetStrut *strut)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_STRUT, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_STRUT, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) strut, 4);
 }
 
@@ -3750,7 +3815,7 @@ Get_NET_WM_STRUT(Window window, struct NetStrut *strut)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_STRUT, 0L, 4L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_STRUT, 0L, 4L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     memset(strut, 0, sizeof(*strut));
@@ -3831,7 +3896,7 @@ Set_NET_WM_STRUT_PARTIAL(Window window, struct NetStrut *strut)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_STRUT_PARTIAL, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_STRUT_PARTIAL, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) strut, 12);
 }
 
@@ -3852,7 +3917,7 @@ Get_NET_WM_STRUT_PARTIAL(Window window, struct NetStrut *strut)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_STRUT_PARTIAL, 0L, 12L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_STRUT_PARTIAL, 0L, 12L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     memset(strut, 0, sizeof(*strut));
@@ -3935,7 +4000,7 @@ Get_NET_WM_ICON_GEOMETRY(Window window, struct NetGeometry *icon_geometry)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_ICON_GEOMETRY, 0L, 4L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_ICON_GEOMETRY, 0L, 4L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 4UL) {
@@ -4012,7 +4077,7 @@ Get_NET_WM_ICON(Window window, struct NetIcon *icon)
     icon->data = NULL;
     icon->length = 0;
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_ICON, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_ICON, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1UL || bytes_after <= 0) {
@@ -4023,7 +4088,7 @@ Get_NET_WM_ICON(Window window, struct NetIcon *icon)
     XFree(prop);
     prop = NULL;
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_ICON, 0L, ((bytes_after + 3) >> 2) + 1,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_ICON, 0L, ((bytes_after + 3) >> 2) + 1,
 			   False, XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 2UL || bytes_after > 0) {
@@ -4106,7 +4171,7 @@ Set_NET_WM_PID(Window window, pid_t pid)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_PID, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_PID, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) &data, 1);
 }
 
@@ -4123,7 +4188,7 @@ Get_NET_WM_PID(Window window, pid_t *pid)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_PID, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_PID, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1UL) {
@@ -4218,7 +4283,7 @@ Get_NET_WM_HANDLED_ICONS(Window window)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_HANDLED_ICONS, 0L, 1L, False, None,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_HANDLED_ICONS, 0L, 1L, False, None,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_format == 0) {
@@ -4278,7 +4343,7 @@ Set_NET_WM_USER_TIME_WINDOW(Window window, Window time_window)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_USER_TIME_WINDOW, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_USER_TIME_WINDOW, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
 }
 
@@ -4296,7 +4361,7 @@ Get_NET_WM_USER_TIME_WINDOW(Window window, Window *time_window)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_USER_TIME_WINDOW, 0L, 1L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_USER_TIME_WINDOW, 0L, 1L, False,
 			   XA_WINDOW, &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -4308,7 +4373,7 @@ Get_NET_WM_USER_TIME_WINDOW(Window window, Window *time_window)
     XFree(prop);
     prop = NULL;
     status =
-	XGetWindowProperty(dpy, check, _XA_NET_WM_USER_TIME_WINDOW, 0L, 1L, False,
+	TwmGetWindowProperty(dpy, check, _XA_NET_WM_USER_TIME_WINDOW, 0L, 1L, False,
 			   XA_WINDOW, &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -4397,7 +4462,7 @@ Set_NET_WM_USER_TIME(Window window, Time time)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_USER_TIME, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_USER_TIME, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) &data, 1);
 }
 
@@ -4418,7 +4483,7 @@ Get_NET_WM_USER_TIME(Window window, Time *time)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_USER_TIME, 0L, 1L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_USER_TIME, 0L, 1L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -4534,9 +4599,9 @@ Set_NET_FRAME_EXTENTS(Window window, struct NetExtents *extents)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_FRAME_EXTENTS, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_FRAME_EXTENTS, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) extents, 4);
-    XChangeProperty(dpy, window, _XA_KDE_NET_WM_FRAME_STRUT, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_KDE_NET_WM_FRAME_STRUT, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) extents, 4);
 }
 
@@ -4569,8 +4634,8 @@ Upd_NET_FRAME_EXTENTS(TwmWindow *twin)
 void
 Del_NET_FRAME_EXTENTS(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_FRAME_EXTENTS);
-    XDeleteProperty(dpy, twin->w, _XA_KDE_NET_WM_FRAME_STRUT);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_FRAME_EXTENTS);
+    TwmDeleteProperty(dpy, twin->w, _XA_KDE_NET_WM_FRAME_STRUT);
 }
 
 /** @} */
@@ -4632,7 +4697,7 @@ Set_NET_WM_BYPASS_COMPOSITOR(Window window, enum _NET_COMPOSITOR_HINT hint)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_BYPASS_COMPOSITOR, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_BYPASS_COMPOSITOR, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
 }
 
@@ -5009,8 +5074,7 @@ Snd_NET_WM_PING(TwmWindow *twin, Time timestamp)
     event.data.l[1] = timestamp;
     event.data.l[2] = twin->w;
     event.data.l[3] = event.data.l[4] = 0;
-    XSendEvent(dpy, twin->w, False, SubstructureRedirectMask | SubstructureNotifyMask,
-	       (XEvent *) &event);
+    XSendEvent(dpy, twin->w, False, NoEventMask, (XEvent *) &event);
 }
 
 /** @} */
@@ -5070,10 +5134,12 @@ Snd_NET_WM_SYNC_REQUEST(TwmWindow *twin, Time timestamp, struct NetCounter *coun
 
 /** @} */
 
-/** @name _NET_WM_SYNC_REQUEST_COUNTER counter_low, counter_high [2]/CARDINAL
+/** @name _NET_WM_SYNC_REQUEST_COUNTER counter, extended_counter [1-2]/CARDINAL
   *
-  * The value of the last _NET_WM_SYNC_REQUEST client message received in a
-  * synchronized ConfigureNotify sequence.
+  * The XSync counter that the client sets to the value of the last
+  * _NET_WM_SYNC_REQUEST client message received in a synchronized
+  * ConfigureNotify sequence, optionally followed by an extended counter.  They
+  * are kept in the low and high members of the NetCounter.
   *
   * @{ */
 static Bool
@@ -5089,16 +5155,16 @@ Get_NET_WM_SYNC_REQUEST_COUNTER(Window window, struct NetCounter *counter)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_SYNC_REQUEST_COUNTER, 0L, 2L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_SYNC_REQUEST_COUNTER, 0L, 2L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
-    if (status != Success || actual_type == None || nitems < 2) {
+    if (status != Success || actual_type == None || nitems < 1) {
 	if (prop != NULL)
 	    XFree(prop);
 	return False;
     }
     counter->low = prop[0];
-    counter->high = prop[1];
+    counter->high = nitems > 1 ? prop[1] : None;
     XFree(prop);
     return True;
 }
@@ -5113,8 +5179,8 @@ Ret_NET_WM_SYNC_REQUEST_COUNTER(TwmWindow *twin)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
     fflush(stderr);
 #endif
-    if ((present = Get_NET_WM_SYNC_REQUEST_COUNTER(twin->w, &counter)))
-	TwmSetWMSyncRequestCounter(twin, &counter);
+    present = Get_NET_WM_SYNC_REQUEST_COUNTER(twin->w, &counter);
+    TwmSetWMSyncRequestCounter(twin, present ? &counter : NULL);
     twin->ewmh.props._NET_WM_SYNC_REQUEST_COUNTER = present;
     twin->ewmh.sync_counter = counter;
 }
@@ -5141,7 +5207,7 @@ Set_NET_WM_FULLSCREEN_MONITORS(Window window, struct NetMonitors *monitors)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_FULLSCREEN_MONITORS, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_FULLSCREEN_MONITORS, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) monitors, 4);
 }
 
@@ -5158,7 +5224,7 @@ Get_NET_WM_FULLSCREEN_MONITORS(Window window, struct NetMonitors *monitors)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_FULLSCREEN_MONITORS, 0L, 4L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_FULLSCREEN_MONITORS, 0L, 4L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 4) {
@@ -5334,7 +5400,7 @@ Set_NET_WM_WINDOW_OPACITY(Window window, unsigned char opacity)
     fflush(stderr);
 #endif
     /* TODO: set error handler */
-    XChangeProperty(dpy, window, _XA_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
     XSync(dpy, False);
 }
@@ -5386,7 +5452,7 @@ Set_NET_STARTUP_ID(Window window, char *startup_id)
 	char *list[2] = { startup_id, NULL };
 
 	if (XmbTextListToTextProperty(dpy, list, 1, XUTF8StringStyle, &text) == Success) {
-	    XSetTextProperty(dpy, window, &text, _XA_NET_STARTUP_ID);
+	    TwmSetTextProperty(dpy, window, &text, _XA_NET_STARTUP_ID);
 	    if (text.value != NULL)
 		XFree(text.value);
 	}
@@ -5395,7 +5461,7 @@ Set_NET_STARTUP_ID(Window window, char *startup_id)
 	fprintf(stderr, "ERROR: no startup id!\n");
 	fflush(stderr);
 #endif
-	XDeleteProperty(dpy, window, _XA_NET_STARTUP_ID);
+	TwmDeleteProperty(dpy, window, _XA_NET_STARTUP_ID);
     }
 }
 
@@ -5418,7 +5484,7 @@ Get_NET_STARTUP_ID(Window window, char **startup_id)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_WM_CLIENT_LEADER, 0L, 1L, False, XA_WINDOW,
+	TwmGetWindowProperty(dpy, window, _XA_WM_CLIENT_LEADER, 0L, 1L, False, XA_WINDOW,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status == Success && actual_type != None && nitems >= 1) {
@@ -5429,7 +5495,7 @@ Get_NET_STARTUP_ID(Window window, char **startup_id)
 	    XFree(prop);
     }
 
-    if (XGetTextProperty(dpy, window, &text, _XA_NET_STARTUP_ID) && text.nitems > 0) {
+    if (TwmGetTextProperty(dpy, window, &text, _XA_NET_STARTUP_ID) && text.nitems > 0) {
 	if (XmbTextPropertyToTextList(dpy, &text, &list, &count) == Success) {
 	    if (count > 0) {
 		*startup_id = strdup(list[0]);
@@ -5667,6 +5733,8 @@ free_sequence_fields(EwmhSequence *seq)
 	free(seq->fields[i]);
 }
 
+static void expire_seq(void *closure);
+
 /** @brief Remove a startup notification sequence from the screen list.
   * @param seq - startup notification sequence
   *
@@ -5680,6 +5748,7 @@ remove_seq(EwmhSequence *seq)
 {
     if (seq != NULL) {
 	if (seq->prev != NULL) {
+	    TimerClear(expire_seq, (void *) seq);
 	    if ((*(seq->prev) = seq->next) != NULL)
 		seq->next->prev = seq->prev;
 	    seq->prev = NULL;
@@ -5730,6 +5799,7 @@ free_seq(EwmhSequence *seq)
 	    seq->twm = NULL;
 	}
 	if (seq->prev != NULL) {
+	    TimerClear(expire_seq, (void *) seq);
 	    if ((*(seq->prev) = seq->next) != NULL)
 		seq->next->prev = seq->prev;
 	    seq->prev = NULL;
@@ -5844,7 +5914,7 @@ static void
 Del_NET_STARTUP_ID(TwmWindow *twin)
 {
     if (twin->ewmh.props._NET_STARTUP_ID) {
-	XDeleteProperty(dpy, twin->w, _XA_NET_STARTUP_ID);
+	TwmDeleteProperty(dpy, twin->w, _XA_NET_STARTUP_ID);
 	free(twin->ewmh.startup_id);
 	twin->ewmh.startup_id = NULL;
 	twin->ewmh.props._NET_STARTUP_ID = 0;
@@ -5884,6 +5954,8 @@ static const char *NetFields[] = {
     NULL
 };
 
+#define STARTUP_TIMEOUT		15000	/* milliseconds */
+
 static void
 copy_sequence_fields(EwmhSequence *old, EwmhSequence *new)
 {
@@ -6007,6 +6079,7 @@ End_NET_STARTUP_INFO(ScreenInfo *scr, EwmhNotify *notify)
 	seq->prev = &scr->ewmh.sequence;
 	seq->twm = NULL;
 	seq->changed = False;
+	TimerSet(expire_seq, (void *) seq, STARTUP_TIMEOUT);
 	return;
     }
     switch (seq->state) {
@@ -6240,6 +6313,34 @@ Snd_NET_STARTUP_INFO_MSG(ScreenInfo *scr, EwmhSequence *seq, enum _NET_NOTIFY_MS
     Snd_NET_STARTUP_INFO(TwmNetManager(scr), TwmNetRoot(scr), msg);
 }
 
+/** @brief Expire a startup notification sequence.
+  * @param closure - startup notification sequence
+  *
+  * A launcher that never completes its sequence would leave it (and whatever
+  * launch feedback it drives) around for good.  STARTUP_TIMEOUT after the
+  * "new:" message, the window manager sends the "remove:" message itself and
+  * drops the sequence.
+  */
+static void
+expire_seq(void *closure)
+{
+    EwmhSequence *seq = (EwmhSequence *) closure, *s;
+    ScreenInfo *scr;
+    int i;
+
+    for (i = 0; i < NumScreens; i++) {
+	if ((scr = ScreenList[i]) == NULL)
+	    continue;
+	for (s = scr->ewmh.sequence; s != NULL; s = s->next) {
+	    if (s == seq) {
+		Snd_NET_STARTUP_INFO_MSG(scr, seq, _NET_NOTIFY_MSG_REMOVE);
+		free_seq(seq);
+		return;
+	    }
+	}
+    }
+}
+
 /** @brief Send change message if possible.
   * @param scr - screen
   * @param twin - TWM window
@@ -6418,7 +6519,7 @@ Set_NET_SYSTEM_TRAY_ORIENTATION(Window root,
     fprintf(stderr, "%s on root 0x%08lx\n", __FUNCTION__, root);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, root, _XA_NET_SYSTEM_TRAY_ORIENTATION, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, root, _XA_NET_SYSTEM_TRAY_ORIENTATION, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) &data, 1);
 }
 
@@ -6461,7 +6562,7 @@ Set_KDE_NET_SYSTEM_TRAY_WINDOWS(Window root, Window *systray, int count)
     for (n = 0; n < count; n++)
 	windows[n] = systray[n];
 
-    XChangeProperty(dpy, root, _XA_KDE_NET_SYSTEM_TRAY_WINDOWS, XA_WINDOW, 32,
+    TwmChangeProperty(dpy, root, _XA_KDE_NET_SYSTEM_TRAY_WINDOWS, XA_WINDOW, 32,
 		    PropModeReplace, (unsigned char *) windows, count);
 }
 
@@ -6526,7 +6627,7 @@ Get_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR(Window window)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR, 0L, 1L,
+	TwmGetWindowProperty(dpy, window, _XA_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR, 0L, 1L,
 			   False, AnyPropertyType, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None) {
@@ -6576,7 +6677,7 @@ Get_KDE_NET_WM_WINDOW_TYPE_OVERRIDE(Window window)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_KDE_NET_WM_WINDOW_TYPE_OVERRIDE, 0L, 1L,
+	TwmGetWindowProperty(dpy, window, _XA_KDE_NET_WM_WINDOW_TYPE_OVERRIDE, 0L, 1L,
 			   False, AnyPropertyType, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None) {
@@ -6639,7 +6740,7 @@ Set_NET_MAXIMIZED_RESTORE(Window window, struct NetRestore *restore)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_MAXIMIZED_RESTORE, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_MAXIMIZED_RESTORE, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) restore, 6);
 }
 
@@ -6656,7 +6757,7 @@ Get_NET_MAXIMIZED_RESTORE(Window window, struct NetRestore *restore)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_MAXIMIZED_RESTORE, 0L, 6L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_MAXIMIZED_RESTORE, 0L, 6L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 6) {
@@ -6720,7 +6821,7 @@ Ret_NET_MAXIMIZED_RESTORE(ScreenInfo *scr, TwmWindow *twin)
 void
 Del_NET_MAXIMIZED_RESTORE(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_MAXIMIZED_RESTORE);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_MAXIMIZED_RESTORE);
 }
 
 /** @} */
@@ -6761,7 +6862,7 @@ Set_NET_WM_DESKTOP_MASK(Window window, long *mask, int count)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, XA_CARDINAL, 32,
+    TwmChangeProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, XA_CARDINAL, 32,
 		    PropModeReplace, (unsigned char *) mask, count);
 }
 
@@ -6783,7 +6884,7 @@ Get_NET_WM_DESKTOP_MASK(Window window, long **mask, int *count)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, 0L, 1L, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, 0L, 1L, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 1) {
@@ -6796,7 +6897,7 @@ Get_NET_WM_DESKTOP_MASK(Window window, long **mask, int *count)
     prop = NULL;
 
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, 0L, len, False,
+	TwmGetWindowProperty(dpy, window, _XA_NET_WM_DESKTOP_MASK, 0L, len, False,
 			   XA_CARDINAL, &actual_type, &actual_format, &nitems,
 			   &bytes_after, (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < len) {
@@ -6887,7 +6988,7 @@ Ret_NET_WM_DESKTOP_MASK(ScreenInfo *scr, TwmWindow *twin)
 void
 Del_NET_WM_DESKTOP_MASK(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_WM_DESKTOP_MASK);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_WM_DESKTOP_MASK);
     twin->ewmh.props._NET_WM_DESKTOP_MASK = 0;
     free(twin->ewmh.mask);
     twin->ewmh.mask = NULL;
@@ -6923,7 +7024,7 @@ Set_NET_VIRTUAL_POS(Window window, struct NetPosition *virtual_pos)
     fprintf(stderr, "%s on window 0x%08lx\n", __FUNCTION__, window);
     fflush(stderr);
 #endif
-    XChangeProperty(dpy, window, _XA_NET_VIRTUAL_POS, XA_CARDINAL, 32, PropModeReplace,
+    TwmChangeProperty(dpy, window, _XA_NET_VIRTUAL_POS, XA_CARDINAL, 32, PropModeReplace,
 		    (unsigned char *) virtual_pos, 2);
 }
 
@@ -6940,7 +7041,7 @@ Get_NET_VIRTUAL_POS(Window window, struct NetPosition *virtual_pos)
     fflush(stderr);
 #endif
     status =
-	XGetWindowProperty(dpy, window, _XA_NET_VIRTUAL_POS, 0L, 2L, False, XA_CARDINAL,
+	TwmGetWindowProperty(dpy, window, _XA_NET_VIRTUAL_POS, 0L, 2L, False, XA_CARDINAL,
 			   &actual_type, &actual_format, &nitems, &bytes_after,
 			   (unsigned char **) &prop);
     if (status != Success || actual_type == None || nitems < 2) {
@@ -7010,7 +7111,7 @@ Ret_NET_VIRTUAL_POS(ScreenInfo *scr, TwmWindow *twin)
 static void
 Del_NET_VIRTUAL_POS(TwmWindow *twin)
 {
-    XDeleteProperty(dpy, twin->w, _XA_NET_VIRTUAL_POS);
+    TwmDeleteProperty(dpy, twin->w, _XA_NET_VIRTUAL_POS);
     twin->ewmh.props._NET_VIRTUAL_POS = 0;
     twin->ewmh.virtual_pos.x = 0;
     twin->ewmh.virtual_pos.y = 0;
@@ -7285,6 +7386,42 @@ TermEwmh(ScreenInfo *scr)
   *
   * @{ */
 
+/** @brief Prefetch the client properties read by AddWindowEwmh().
+  * @param window - the client window about to be managed
+  *
+  * Queues the reads of all of the client-owned properties that the Ini_
+  * functions below retrieve, so that AddWindowEwmh() does not wait on the
+  * server once for each of them.  See PrefetchProperties().
+  */
+void
+PrefetchWindowEwmh(Window window)
+{
+    Atom atoms[] = {
+	XA_WM_CLIENT_MACHINE,
+	XA_WM_COMMAND,
+	_XA_NET_WM_PID,
+	_XA_NET_WM_USER_TIME_WINDOW,
+	_XA_NET_WM_USER_TIME,
+	_XA_NET_STARTUP_ID,
+	_XA_NET_WM_DESKTOP,
+	_XA_NET_WM_DESKTOP_MASK,
+	_XA_NET_WM_NAME,
+	_XA_NET_WM_ICON_NAME,
+	_XA_NET_WM_WINDOW_TYPE,
+	_XA_NET_WM_STATE,
+	_XA_NET_WM_STRUT_PARTIAL,
+	_XA_NET_WM_STRUT,
+	_XA_NET_WM_ICON_GEOMETRY,
+	_XA_NET_WM_ICON,
+	_XA_NET_WM_FULLSCREEN_MONITORS,
+	_XA_NET_WM_SYNC_REQUEST_COUNTER,
+	_XA_NET_VIRTUAL_POS,
+	_XA_KDE_NET_WM_WINDOW_TYPE_OVERRIDE,
+    };
+
+    PrefetchProperties(window, atoms, sizeof(atoms) / sizeof(atoms[0]));
+}
+
 /** @brief Add a window in the EWMH sense.
   * @param twin - the window to add
   *
@@ -7321,6 +7458,7 @@ AddWindowEwmh(ScreenInfo *scr, TwmWindow *twin)
     // Ret_NET_WM_OPAQUE_REGION(twin);
     // Ret_NET_WM_BYPASS_COMPOSITOR(twin);
     Ini_NET_WM_FULLSCREEN_MONITORS(scr, twin);
+    Ret_NET_WM_SYNC_REQUEST_COUNTER(twin);
     // Ret_NET_WM_WINDOW_OPACITY(twin);
     Ini_NET_VIRTUAL_POS(scr, twin);
     Ini_KDE_NET_WM_WINDOW_TYPE_OVERRIDE(twin);
@@ -7349,8 +7487,34 @@ UpdWindowEwmh(ScreenInfo *scr, TwmWindow *twin)
     Upd_NET_VIRTUAL_POS(scr, twin);
     Upd_NET_MAXIMIZED_RESTORE(scr, twin);
 
-    Upd_NET_CLIENT_LIST(scr);
-    Upd_NET_CLIENT_LIST_STACKING(scr);
+    Dfr_NET_CLIENT_LIST(scr);
+    Dfr_NET_CLIENT_LIST_STACKING(scr);
+}
+
+/** @brief Defer updating a window in the EWMH sense.
+  * @param twin - the window to update
+  *
+  * Same as UpdWindowEwmh(), but the properties are only updated by the next
+  * FlushEwmh().
+  */
+void
+DfrWindowEwmh(ScreenInfo *scr, TwmWindow *twin)
+{
+    struct NetWindowBits *dirty = &twin->ewmh.dirty;
+
+    dirty->_NET_WM_VISIBLE_NAME = 1;
+    dirty->_NET_WM_VISIBLE_ICON_NAME = 1;
+    dirty->_NET_WM_DESKTOP = 1;
+    dirty->_NET_WM_STATE = 1;
+    dirty->_NET_WM_ALLOWED_ACTIONS = 1;
+    dirty->_NET_FRAME_EXTENTS = 1;
+    dirty->_NET_WM_DESKTOP_MASK = 1;
+    dirty->_NET_VIRTUAL_POS = 1;
+    dirty->_NET_MAXIMIZED_RESTORE = 1;
+    queue_window(scr, twin);
+
+    Dfr_NET_CLIENT_LIST(scr);
+    Dfr_NET_CLIENT_LIST_STACKING(scr);
 }
 
 /** @brief Withdraw a window in the EWMH sense.
@@ -7379,9 +7543,25 @@ DelWindowEwmh(ScreenInfo *scr, TwmWindow *twin)
     Del_NET_MAXIMIZED_RESTORE(twin);
     Del_NET_WM_USER_TIME_WINDOW(scr, twin);
     Del_NET_STARTUP_ID(twin);
+    TwmSetWMSyncRequestCounter(twin, NULL);
+    TwmCancelWMPing(twin);
+
+    /* The window is about to be freed: take it off the dirty list. */
+    if (twin->ewmh.queued) {
+	TwmWindow **prev;
+
+	for (prev = &scr->ewmh.dirty_windows; *prev != NULL;
+	     prev = &(*prev)->ewmh.next_dirty) {
+	    if (*prev == twin) {
+		*prev = twin->ewmh.next_dirty;
+		break;
+	    }
+	}
+	twin->ewmh.queued = False;
+    }
 
-    Upd_NET_CLIENT_LIST(scr);
-    Upd_NET_CLIENT_LIST_STACKING(scr);
+    Dfr_NET_CLIENT_LIST(scr);
+    Dfr_NET_CLIENT_LIST_STACKING(scr);
 
     /* free various EwmhWindow allocations */
     ewin = &twin->ewmh;
@@ -7400,6 +7580,55 @@ DelWindowEwmh(ScreenInfo *scr, TwmWindow *twin)
     free(ewin->mask);
 }
 
+/** @brief Publish the properties marked stale by the Dfr_* functions.
+  * @param scr - screen
+  *
+  * Called by the event loop once the event queue is drained, so that a burst
+  * of events changing the same properties causes a single update of each, and
+  * none at all for properties that ended up unchanged.
+  */
+void
+FlushEwmh(ScreenInfo *scr)
+{
+    static const struct NetScreenBits clean;
+    static const struct NetWindowBits clean_window;
+    TwmWindow *twin;
+    struct NetWindowBits dirty;
+
+    while ((twin = scr->ewmh.dirty_windows) != NULL) {
+	scr->ewmh.dirty_windows = twin->ewmh.next_dirty;
+	twin->ewmh.next_dirty = NULL;
+	twin->ewmh.queued = False;
+	dirty = twin->ewmh.dirty;
+	twin->ewmh.dirty = clean_window;
+	if (dirty._NET_WM_VISIBLE_NAME)
+	    Upd_NET_WM_VISIBLE_NAME(twin);
+	if (dirty._NET_WM_VISIBLE_ICON_NAME)
+	    Upd_NET_WM_VISIBLE_ICON_NAME(twin);
+	if (dirty._NET_WM_DESKTOP)
+	    Upd_NET_WM_DESKTOP(scr, twin);
+	if (dirty._NET_WM_STATE)
+	    Upd_NET_WM_STATE(scr, twin);
+	if (dirty._NET_WM_ALLOWED_ACTIONS)
+	    Upd_NET_WM_ALLOWED_ACTIONS(twin);
+	if (dirty._NET_FRAME_EXTENTS)
+	    Upd_NET_FRAME_EXTENTS(twin);
+	if (dirty._NET_WM_DESKTOP_MASK)
+	    Upd_NET_WM_DESKTOP_MASK(scr, twin);
+	if (dirty._NET_VIRTUAL_POS)
+	    Upd_NET_VIRTUAL_POS(scr, twin);
+	if (dirty._NET_MAXIMIZED_RESTORE)
+	    Upd_NET_MAXIMIZED_RESTORE(scr, twin);
+    }
+    if (scr->ewmh.dirty._NET_ACTIVE_WINDOW)
+	Upd_NET_ACTIVE_WINDOW(scr);
+    if (scr->ewmh.dirty._NET_CLIENT_LIST)
+	Upd_NET_CLIENT_LIST(scr);
+    if (scr->ewmh.dirty._NET_CLIENT_LIST_STACKING)
+	Upd_NET_CLIENT_LIST_STACKING(scr);
+    scr->ewmh.dirty = clean;
+}
+
 /** @} */
 
 /** @name Handling of NetWM/EWMH events.
@@ -7490,6 +7719,16 @@ HandleNetClientMessage(ScreenInfo *scr, TwmWindow *twin, XEvent *xev)
 		return False;
 	} else if (message_type == _XA_NET_REQUEST_FRAME_EXTENTS) {
 	    Rcv_NET_REQUEST_FRAME_EXTENTS(scr, event);
+	} else if (message_type == _XA_WM_PROTOCOLS) {
+	    /* _NET_WM_PING replies come back with event->window == root */
+	    TwmWindow *client = NULL;
+
+	    if (event->data.l[0] == _XA_NET_WM_PING
+		&& XFindContext(dpy, (Window) event->data.l[2], TwmContext,
+				(XPointer *) &client) == XCSUCCESS && client != NULL)
+		Rcv_NET_WM_PING(client, event);
+	    else
+		return False;
 	} else if (message_type == _XA_NET_STARTUP_INFO_BEGIN
 		   || message_type == _XA_NET_STARTUP_INFO) {
 	    EwmhNotify *notify = NULL;
@@ -7,6 +7,7 @@
 #include <X11/cursorfont.h>
 #include <X11/extensions/shape.h>
 #include <X11/Xfuncs.h>
+#include <sys/time.h>
 
 #include "types.h"
 
@@ -525,6 +526,11 @@ typedef struct EwmhWindow {
     struct NetExtents extents;		/* _NET_FRAME_EXTENTS */
     /* _KDE_NET_WM_FRAME_STRUT */
     struct NetCounter sync_counter;	/* _NET_WM_SYNC_REQUEST_COUNTER */
+    struct NetCounter sync_serial;	/* _NET_WM_SYNC_REQUEST last sent */
+    XID sync_alarm;			/* _NET_WM_SYNC_REQUEST alarm */
+    Bool sync_waiting;			/* _NET_WM_SYNC_REQUEST unanswered */
+    unsigned long sync_sent;		/* _NET_WM_SYNC_REQUEST sent (ms) */
+    Time ping_time;			/* _NET_WM_PING outstanding */
     struct NetMonitors monitors;	/* _NET_WM_FULLSCREEN_MONITORS */
     char *startup_id;			/* _NET_STARTUP_ID */
     EwmhSequence *sequence;		/* _NET_STARTUP_ID */
@@ -533,6 +539,9 @@ typedef struct EwmhWindow {
     long *mask;				/* _NET_WM_DESKTOP_MASK */
     int masks;				/* _NET_WM_DESKTOP_MASK */
     struct NetPosition virtual_pos;	/* _NET_VIRTUAL_POS */
+    struct NetWindowBits dirty;		/* which properties FlushEwmh() updates */
+    Bool queued;			/* on the list of dirty windows */
+    TwmWindow *next_dirty;		/* next window with dirty properties */
 } EwmhWindow;
 
 typedef struct EwmhNotify {
@@ -583,6 +592,8 @@ typedef struct EwmhScreen {
     EwmhNotify *notify;			/* startup notification message list */
     EwmhSequence *sequence;		/* startup notification sequence list */
     short IconifyByUnmapping;		/* save original setting */
+    struct NetScreenBits dirty;		/* which properties FlushEwmh() updates */
+    TwmWindow *dirty_windows;		/* windows with dirty properties */
 } EwmhScreen;
 
 typedef struct EwmhWorkspace {
@@ -624,16 +635,26 @@ void Upd_NET_MAXIMIZED_RESTORE(ScreenInfo *scr, TwmWindow *twin);
 void Upd_NET_WM_DESKTOP_MASK(ScreenInfo *scr, TwmWindow *twin);
 void Upd_NET_VIRTUAL_POS(ScreenInfo *scr, TwmWindow *twin);
 
+void Dfr_NET_CLIENT_LIST(ScreenInfo *scr);
+void Dfr_NET_CLIENT_LIST_STACKING(ScreenInfo *scr);
+void Dfr_NET_ACTIVE_WINDOW(ScreenInfo *scr);
+void Dfr_NET_WM_STATE(ScreenInfo *scr, TwmWindow *twin);
+
 EwmhSequence *Seq_NET_STARTUP_ID(ScreenInfo *scr, TwmWindow *twin);
 void Chg_NET_STARTUP_INFO(ScreenInfo *scr, EwmhSequence *seq);
+void Snd_NET_WM_PING(TwmWindow *twin, Time timestamp);
+void Snd_NET_WM_SYNC_REQUEST(TwmWindow *twin, Time timestamp, struct NetCounter *counter);
 
 void InitEwmh(ScreenInfo *scr);
 void UpdateEwmh(ScreenInfo *scr);
 void TermEwmh(ScreenInfo *scr);
 
+void PrefetchWindowEwmh(Window window);
 void AddWindowEwmh(ScreenInfo *scr, TwmWindow *twin);
 void UpdWindowEwmh(ScreenInfo *scr, TwmWindow *twin);
+void DfrWindowEwmh(ScreenInfo *scr, TwmWindow *twin);
 void DelWindowEwmh(ScreenInfo *scr, TwmWindow *twin);
+void FlushEwmh(ScreenInfo *scr);
 
 /* Event handlers */
 Bool HandleNetClientMessage(ScreenInfo *scr, TwmWindow *twin, XEvent *xev);
@@ -721,6 +742,11 @@ void TwmChgWMDesktopMask(ScreenInfo *scr, TwmWindow *twin, unsigned index, unsig
 void TwmGetWMVirtualPos(ScreenInfo *scr, TwmWindow *twin, struct NetPosition *virtual_pos);
 void TwmSetWMVirtualPos(ScreenInfo *scr, TwmWindow *twin, struct NetPosition *virtual_pos);
 void TwmSetWMSyncRequestCounter(TwmWindow *twin, struct NetCounter *counter);
+Bool TwmSyncRequestPending(TwmWindow *twin);
+void TwmSendSyncRequest(TwmWindow *twin);
+Bool TwmGotSyncAlarm(TwmWindow *twin, XEvent *xev);
+void TwmSendWMPing(TwmWindow *twin, Time timestamp);
+void TwmCancelWMPing(TwmWindow *twin);
 void TwmGotWMPing(TwmWindow *twin, Time timestamp, Window client);
 void TwmGetKdeSystemTrayWindows(ScreenInfo *scr, Window **systray, int *count);
 void TwmGetMaximizedRestore(ScreenInfo *scr, TwmWindow *twin, struct NetRestore *restore);
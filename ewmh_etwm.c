@@ -4,8 +4,12 @@
 #include "mwmh.h"
 #endif				/* MWMH */
 #include "screen.h"
+#include "add_window.h"
+#include "menus.h"
 #include "parse.h"
 #include "icons.h"
+#include "events.h"
+#include "util.h"
 #include <X11/Xos.h>
 #include <X11/Xatom.h>
 #include <X11/Xmu/CharSet.h>
@@ -90,42 +94,34 @@ TwmGetClientList(ScreenInfo *scr, Window **clients, int *count)
   * @param stacking - where to return the list of windows
   * @param count - where to return the count.
   *
-  * Note that windows should be in bottom-to-top stacking order.  We use
-  * XQueryTree() here to give us the children of the current virtual root in
-  * bottom to top stacking order and then translate the frame to the client
-  * window using contexts.  This is good because it lets the X Server determine
-  * stacking order.
+  * Note that windows should be in bottom-to-top stacking order.  We walk the
+  * stacking model kept in menus.c, which follows every restacking of frames
+  * that we do, so that no XQueryTree() is needed here.  The model is only read
+  * back from the X Server after restacking requests whose outcome it cannot
+  * predict.
   */
 void
 TwmGetClientListStacking(ScreenInfo *scr, Window **stacking, int *count)
 {
-    VirtualScreen *vs;
-    Window *list = NULL;
+    TwmWindow *twin;
+    Window *list;
     int number = 0;
 
 #ifdef DEBUG_EWMH
     fprintf(stderr, "%s for root 0x%08lx\n", __FUNCTION__, TwmNetRoot(scr));
     fflush(stderr);
 #endif
-    for (vs = scr->vScreenList; vs != NULL; vs = vs->next) {
-	Window root = None, parent = None, *children = NULL, *newlist;
-	unsigned int nchildren = 0, n;
-
-	if (XQueryTree(dpy, vs->window, &root, &parent, &children, &nchildren) == 0
-	    || nchildren == 0)
-	    continue;
-	if ((newlist = realloc(list, (number + nchildren + 1) * sizeof(Window))) != NULL) {
-	    TwmWindow *twin;
-
-	    list = newlist;
-	    for (n = 0; n < nchildren; n++)
-		if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) ==
-		    XCSUCCESS && twin->frame == children[n])
-		    list[number++] = twin->w;
-	    list[number] = None;
-	}
-	XFree(children);
+    for (twin = scr->FirstWindow; twin != NULL; twin = twin->next)
+	number++;
+    if ((list = calloc(number + 1, sizeof(Window))) == NULL) {
+	*stacking = NULL;
+	*count = 0;
+	return;
     }
+    number = 0;
+    for (twin = StackBottomWindow(scr); twin != NULL; twin = twin->stack_above)
+	list[number++] = twin->w;
+    list[number] = None;
     *stacking = list;
     *count = number;
 }
@@ -698,10 +694,10 @@ TwmSetShowingDesktop(ScreenInfo *scr, Bool showing)
   * Typical behaviour should be to send a WM_DELETE protocol message if the
   * protocol is selected, otherwise, perform an XKillClient on the window.
   *
-  * As a TODO item, we should initiate a _NET_WM_PING protocol when we delete to
-  * ensure that the window eventually closes.  Also, if there is a _NET_WM_PID
+  * A _NET_WM_PING is sent along with the WM_DELETE so that a hung client is
+  * killed rather than left on screen.  As a TODO item, if there is a _NET_WM_PID
   * property on the window and the WM_CLIENT_MACHINE matches that of the window
-  * manager, we can kill the process.
+  * manager, we could kill the process.
   */
 void
 TwmCloseWindow(TwmWindow *twin, Time timestamp, enum _NET_SOURCE source)
@@ -738,6 +734,7 @@ TwmCloseWindow(TwmWindow *twin, Time timestamp, enum _NET_SOURCE source)
 	event.xclient.window = twin->w;
 	event.xclient.data.l[0] = _XA_WM_DELETE_WINDOW;
 	XSendEvent(dpy, twin->w, False, 0, &event);
+	TwmSendWMPing(twin, timestamp);
     }
     XSync(dpy, False);
 }
@@ -997,6 +994,7 @@ TwmRestackWindow(TwmWindow *twin, unsigned mask, XWindowChanges *changes,
 	if ((mask & CWSibling) && (otherwin = GetTwmWindow(changes->sibling)) != NULL)
 	    changes->sibling = otherwin->frame;
 	XConfigureWindow(dpy, twin->frame, mask, changes);
+	StackConfigured(twin, mask, changes);
     }
     SetupFrame(twin, twin->frame_x, twin->frame_y, twin->frame_width, twin->frame_height,
 	       -1, True);
@@ -1063,13 +1061,12 @@ extern void free_window_names(TwmWindow *twin, Bool nukefull, Bool nukename,
 extern void RedoIcon(void);
 extern void SetupWindow(TwmWindow *tmp_win, int x, int y, int w, int h, int bw);
 
-extern char *NoName;
-
 void
 TwmSetWMName(ScreenInfo *scr, TwmWindow *twin, char *name)
 {
     XRectangle inc_rect, logical_rect;
     char *copy;
+    int name_change;
 
 #ifdef DEBUG_EWMH
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
@@ -1089,11 +1086,14 @@ TwmSetWMName(ScreenInfo *scr, TwmWindow *twin, char *name)
     if (strstr(copy, " - Mozilla"))
 	*strstr(copy, " - Mozilla") = '\0';
 #endif				/* CLAUDE */
+    name_change = strcmp(twin->full_name, copy);
     free_window_names(twin, True, True, False);
 
     twin->full_name = copy;
     twin->name = copy;
     twin->nameChanged = 1;
+    if (name_change)
+	GetWindowPolicy(twin);
     Xutf8TextExtents(scr->TitleBarFont.font_set, copy, strlen(copy), &inc_rect,
 		     &logical_rect);
     twin->name_width = logical_rect.width;
@@ -1105,6 +1105,7 @@ TwmSetWMName(ScreenInfo *scr, TwmWindow *twin, char *name)
 	WmgrRedoOccupation(twin);
     if (twin->icon_name == NoName) {
 	twin->icon_name = copy;
+	GetWindowIconPolicy(twin);
 	RedoIcon();
     }
 }
@@ -1161,8 +1162,10 @@ TwmSetWMIconName(TwmWindow *twin, char *name)
     free_window_names(twin, False, False, True);
     twin->icon_name = copy;
 
-    if (redo_icon)
+    if (redo_icon) {
+	GetWindowIconPolicy(twin);
 	RedoIcon();
+    }
 }
 
 /** @brief Get the visible icon name.
@@ -2465,11 +2468,10 @@ TwmUpdWMHandledIcons(ScreenInfo *scr)
 	    t->iconify_by_unmapping = Scr->IconifyByUnmapping;
 	    if (Scr->IconifyByUnmapping) {
 		t->iconify_by_unmapping =
-		    t->iconmgr ? FALSE : !LookInList(Scr->DontIconify, t->full_name,
-						     &t->class);
+		    t->iconmgr ? FALSE : !t->policy.dont_iconify;
 	    }
 	    t->iconify_by_unmapping = t->iconify_by_unmapping
-		|| LookInList(Scr->IconifyByUn, t->full_name, &t->class);
+		|| t->policy.iconify_by_unmapping;
 	    /* bring up icon if necessary */
 	    if (t->isicon && !t->iconify_by_unmapping && !t->icon_on) {
 		if (!t->icon || !t->icon->w)
@@ -2958,13 +2960,185 @@ TwmSetWMVirtualPos(ScreenInfo *scr, TwmWindow *twin, struct NetPosition *virtual
     /* we don't actually change the position of the window */
 }
 
+/** @name _NET_WM_SYNC_REQUEST
+  *
+  * Interactive resizes are paced to the client: a new size is only given to a
+  * window that takes part in the protocol once it has set its counter to the
+  * number sent along with the previous size, or SYNC_REQUEST_TIMEOUT has gone
+  * by.  An XSync alarm on the counter tells when that happens, so there is no
+  * polling nor round trip.
+  *
+  * @{ */
+
+#define SYNC_REQUEST_TIMEOUT	200	/* milliseconds */
+
+static void
+TwmDelSyncAlarm(TwmWindow *twin)
+{
+    if (twin->ewmh.sync_alarm != None) {
+	XDeleteContext(dpy, twin->ewmh.sync_alarm, TwmContext);
+	XDeleteContext(dpy, twin->ewmh.sync_alarm, ScreenContext);
+	XSyncDestroyAlarm(dpy, twin->ewmh.sync_alarm);
+	twin->ewmh.sync_alarm = None;
+    }
+    twin->ewmh.sync_waiting = False;
+}
+
+/** @brief Take a new counter, or none.
+  * @param twin - the window
+  * @param counter - the counter from _NET_WM_SYNC_REQUEST_COUNTER, or NULL
+  *
+  * The window manager must give the counter a value when it first manages the
+  * window: start it at zero, so that the first request is one.
+  */
 void
 TwmSetWMSyncRequestCounter(TwmWindow *twin, struct NetCounter *counter)
 {
+    XSyncValue value;
+
 #ifdef DEBUG_EWMH
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
     fflush(stderr);
 #endif
+    TwmDelSyncAlarm(twin);
+    twin->ewmh.sync_serial.low = twin->ewmh.sync_serial.high = 0;
+    if (counter == NULL || counter->low == None || !HasSync)
+	return;
+    XSyncIntToValue(&value, 0);
+    XSyncSetCounter(dpy, counter->low, value);
+}
+
+static Bool
+TwmSyncRequestWanted(TwmWindow *twin)
+{
+    return (HasSync && (twin->ewmh.protocols & _NET_WM_SYNC_REQUEST)
+	    && twin->ewmh.props._NET_WM_SYNC_REQUEST_COUNTER
+	    && twin->ewmh.sync_counter.low != None);
+}
+
+/** @brief Whether the client is still busy with the last size it was given.
+  * @param twin - the window being resized
+  */
+Bool
+TwmSyncRequestPending(TwmWindow *twin)
+{
+    if (!twin->ewmh.sync_waiting)
+	return False;
+    if ((long) (TimerNow() - twin->ewmh.sync_sent) < SYNC_REQUEST_TIMEOUT)
+	return True;
+    twin->ewmh.sync_waiting = False;	/* give up on this one */
+    return False;
+}
+
+/** @brief Precede the next size given to the window by a sync request.
+  * @param twin - the window being resized
+  */
+void
+TwmSendSyncRequest(TwmWindow *twin)
+{
+    XSyncAlarmAttributes attr;
+    unsigned long mask;
+
+    if (!TwmSyncRequestWanted(twin))
+	return;
+    twin->ewmh.sync_serial.low = (twin->ewmh.sync_serial.low + 1) & 0xffffffff;
+    if (twin->ewmh.sync_serial.low == 0)
+	twin->ewmh.sync_serial.high++;
+
+    XSyncIntsToValue(&attr.trigger.wait_value, twin->ewmh.sync_serial.low,
+		     twin->ewmh.sync_serial.high);
+    mask = XSyncCAValue;
+    if (twin->ewmh.sync_alarm == None) {
+	attr.trigger.counter = twin->ewmh.sync_counter.low;
+	attr.trigger.value_type = XSyncAbsolute;
+	attr.trigger.test_type = XSyncPositiveComparison;
+	XSyncIntToValue(&attr.delta, 0);
+	attr.events = True;
+	mask |= XSyncCACounter | XSyncCAValueType | XSyncCATestType
+	    | XSyncCADelta | XSyncCAEvents;
+	twin->ewmh.sync_alarm = XSyncCreateAlarm(dpy, mask, &attr);
+	XSaveContext(dpy, twin->ewmh.sync_alarm, TwmContext, (XPointer) twin);
+	XSaveContext(dpy, twin->ewmh.sync_alarm, ScreenContext, (XPointer) Scr);
+    } else
+	XSyncChangeAlarm(dpy, twin->ewmh.sync_alarm, mask, &attr);
+
+    Snd_NET_WM_SYNC_REQUEST(twin, lastTimestamp, &twin->ewmh.sync_serial);
+    twin->ewmh.sync_waiting = True;
+    twin->ewmh.sync_sent = TimerNow();
+}
+
+/** @brief The alarm on the counter of the window has gone off.
+  * @param twin - the window
+  * @param xev - the XSyncAlarmNotify event
+  *
+  * Returns True when the client has caught up with the last request.
+  */
+Bool
+TwmGotSyncAlarm(TwmWindow *twin, XEvent *xev)
+{
+    XSyncAlarmNotifyEvent *ev = (XSyncAlarmNotifyEvent *) xev;
+    unsigned long high, low;
+
+    if (ev->alarm != twin->ewmh.sync_alarm || ev->state == XSyncAlarmDestroyed)
+	return False;
+    high = (unsigned long) XSyncValueHigh32(ev->counter_value);
+    low = (unsigned long) XSyncValueLow32(ev->counter_value);
+    if (high < twin->ewmh.sync_serial.high
+	|| (high == twin->ewmh.sync_serial.high && low < twin->ewmh.sync_serial.low))
+	return False;
+    twin->ewmh.sync_waiting = False;
+    return True;
+}
+
+/** @} */
+
+/** @name _NET_WM_PING
+  *
+  * When a window is asked to close, it is also pinged when it takes part in the
+  * protocol.  A client that does not answer within PING_TIMEOUT is taken to be
+  * hung and is killed when KillUnresponsiveClients is set; one that answers is
+  * left alone, whether or not it closes (it may be asking the user first).
+  *
+  * @{ */
+
+#define PING_TIMEOUT		5000	/* milliseconds */
+
+static void
+TwmPingTimeout(void *closure)
+{
+    TwmWindow *twin = (TwmWindow *) closure;
+    ScreenInfo *scr = NULL;
+
+#ifdef DEBUG_EWMH
+    fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
+    fflush(stderr);
+#endif
+    twin->ewmh.ping_time = CurrentTime;
+    if (XFindContext(dpy, twin->w, ScreenContext, (XPointer *) &scr) != XCSUCCESS)
+	return;
+    if (scr->KillUnresponsiveClients)
+	XKillClient(dpy, twin->w);
+}
+
+void
+TwmSendWMPing(TwmWindow *twin, Time timestamp)
+{
+#ifdef DEBUG_EWMH
+    fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
+    fflush(stderr);
+#endif
+    if (!(twin->ewmh.protocols & _NET_WM_PING))
+	return;
+    twin->ewmh.ping_time = timestamp;
+    Snd_NET_WM_PING(twin, timestamp);
+    TimerSet(TwmPingTimeout, (void *) twin, PING_TIMEOUT);
+}
+
+void
+TwmCancelWMPing(TwmWindow *twin)
+{
+    twin->ewmh.ping_time = CurrentTime;
+    TimerClear(TwmPingTimeout, (void *) twin);
 }
 
 void
@@ -2974,8 +3148,13 @@ TwmGotWMPing(TwmWindow *twin, Time timestamp, Window client)
     fprintf(stderr, "%s for window 0x%08lx\n", __FUNCTION__, twin->w);
     fflush(stderr);
 #endif
+    if (client != twin->w || timestamp != twin->ewmh.ping_time)
+	return;
+    TwmCancelWMPing(twin);
 }
 
+/** @} */
+
 void
 TwmGetKdeSystemTrayWindows(ScreenInfo *scr, Window **systray, int *count)
 {
@@ -92,7 +92,7 @@ void GnomeAddClientWindow (TwmWindow *new_win) {
   unsigned long eventMask;
 
   if (Scr->gnomedata->wsSize == 0) return;
-  if ((!LookInList (Scr->IconMgrNoShow, new_win->full_name, &new_win->class)) && 
+  if ((!new_win->policy.icon_mgr_no_show) && 
       (new_win->w != Scr->workSpaceMgr.occupyWindow->w) && 
       (!new_win->iconmgr)) {
     Scr->gnomedata->numWins++;
@@ -122,7 +122,7 @@ void GnomeDeleteClientWindow (TwmWindow *new_win) {
   int i;
 
   if (Scr->gnomedata->wsSize == 0) return;
-  if ((!LookInList(Scr->IconMgrNoShow, new_win->full_name, &new_win->class)) && 
+  if ((!new_win->policy.icon_mgr_no_show) && 
       (new_win->w != Scr->workSpaceMgr.occupyWindow->w) && 
       (!new_win->iconmgr)) {
     for (i = 0; i < Scr->gnomedata->numWins; i++){
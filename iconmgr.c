@@ -578,10 +578,9 @@ WList *AddIconManager(TwmWindow *tmp_win)
 	tmp_win->w == Scr->workSpaceMgr.occupyWindow->w)
 	return NULL;
 
-    if (LookInList(Scr->IconMgrNoShow, tmp_win->full_name, &tmp_win->class))
+    if (tmp_win->policy.icon_mgr_no_show)
 	return NULL;
-    if (Scr->IconManagerDontShow &&
-	!LookInList(Scr->IconMgrShow, tmp_win->full_name, &tmp_win->class))
+    if (Scr->IconManagerDontShow && !tmp_win->policy.icon_mgr_show)
 	return NULL;
     if ((ip = (IconMgr *)LookInList(Scr->IconMgrs, tmp_win->full_name,
 	    &tmp_win->class)) == NULL) {
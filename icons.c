@@ -465,6 +465,7 @@ void CreateIconWindow(TwmWindow *tmp_win, int def_x, int def_y)
     icon->border	= Scr->IconBorderColor;
     icon->iconc.fore	= Scr->IconC.fore;
     icon->iconc.back	= Scr->IconC.back;
+    icon->parent	= Scr->Root;
 
     GetColorFromList(Scr->IconBorderColorL, tmp_win->full_name, &tmp_win->class,
 	&icon->border);
@@ -618,8 +619,8 @@ void CreateIconWindow(TwmWindow *tmp_win, int def_x, int def_y)
 
     icon->border_width = Scr->IconBorderWidth;
     if (Scr->NoIconTitlebar ||
-	LookInNameList (Scr->NoIconTitle, tmp_win->icon_name) ||
-	LookInList (Scr->NoIconTitle, tmp_win->full_name, &tmp_win->class))
+	tmp_win->policy.no_icon_title_icon ||
+	tmp_win->policy.no_icon_title)
     {
 	icon->w_width  = icon->width;
 	icon->w_height = icon->height;
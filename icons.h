@@ -81,6 +81,7 @@ struct Icon
     Bool	has_title, title_shrunk;
     int		border_width;
     struct IconRegion	*ir;
+    Window	parent;		/* parent of the icon window */
 };
 
 struct IconRegion
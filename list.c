@@ -82,6 +82,38 @@
 # include <regex.h>
 #endif /* USE_GNU_REGEX */
 
+/*
+ * Each list keeps a small direct mapped cache of its recent lookups in
+ * its head entry, keyed by the (name, res_name, res_class) triple that
+ * was looked up.  A window asks the same lists the same questions over
+ * and over (at map time, on every expose, ...), so most lookups never
+ * have to run the patterns at all.  The cache records the matching
+ * entry (or the absence of one), so it stays valid until the list
+ * changes, which only happens in AddToList and FreeList.
+ */
+#define LIST_CACHE_SIZE 16
+
+typedef struct name_list_cache_entry {
+    int		valid;
+    int		has_class;
+    char	*name;
+    char	*res_name;
+    char	*res_class;
+    name_list	*hit;		/* matching entry or NULL */
+} name_list_cache_entry;
+
+struct name_list_cache {
+    name_list_cache_entry entries [LIST_CACHE_SIZE];
+};
+
+static name_list *FindInList (name_list *list_head, char *name,
+			      XClassHint *class);
+static void FreeListCache (name_list *nptr);
+static int match_entry (name_list *nptr, char *string);
+#ifdef USE_GNU_REGEX
+static regex_t *CompileListEntry (char *pattern);
+#endif /* USE_GNU_REGEX */
+
 
 
 /***********************************************************************
@@ -129,6 +161,12 @@ void AddToList(name_list **list_head, char *name, char *ptr)
     nptr->name = (char*) strdup (name);
 #endif
     nptr->ptr = (ptr == NULL) ? (char *)TRUE : ptr;
+#ifdef USE_GNU_REGEX
+    nptr->re = CompileListEntry (name);
+#endif /* USE_GNU_REGEX */
+    nptr->cache = NULL;
+    /* the cache belongs to the list head: the old head is no longer one */
+    if (*list_head) FreeListCache (*list_head);
     *list_head = nptr;
 }    
 
@@ -153,23 +191,8 @@ char *LookInList(name_list *list_head, char *name, XClassHint *class)
 {
     name_list *nptr;
 
-    /* look for the name first */
-    for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	if (match (nptr->name, name))
-	    return (nptr->ptr);
-
-    if (class)
-    {
-	/* look for the res_name next */
-	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_name))
-		return (nptr->ptr);
-
-	/* finally look for the res_class */
-	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_class))
-		return (nptr->ptr);
-    }
+    if ((nptr = FindInList (list_head, name, class)) != NULL)
+	return (nptr->ptr);
     return (NULL);
 }
 
@@ -182,20 +205,8 @@ char *LookPatternInList(name_list *list_head, char *name, XClassHint *class)
 {
     name_list *nptr;
 
-    for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	if (match (nptr->name, name))
-	    return (nptr->name);
-
-    if (class)
-    {
-	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_name))
-		return (nptr->name);
-
-	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_class))
-		return (nptr->name);
-    }
+    if ((nptr = FindInList (list_head, name, class)) != NULL)
+	return (nptr->name);
     return (NULL);
 }
 
@@ -230,39 +241,115 @@ int GetColorFromList(name_list *list_head, char *name,
     int save;
     name_list *nptr;
 
+    if ((nptr = FindInList (list_head, name, class)) == NULL)
+	return (FALSE);
+
+    save = Scr->FirstTime;
+    Scr->FirstTime = TRUE;
+    GetColor(Scr->Monochrome, ptr, nptr->ptr);
+    Scr->FirstTime = save;
+    return (TRUE);
+}
+
+static unsigned int cache_hash (char *name, XClassHint *class)
+{
+    unsigned int h = 5381;
+    char *p;
+
+    if (name) for (p = name; *p; p++) h = (h * 33) ^ (unsigned char) *p;
+    if (class) {
+	h = (h * 33) ^ 0xff;
+	if (class->res_name)
+	    for (p = class->res_name; *p; p++) h = (h * 33) ^ (unsigned char) *p;
+	h = (h * 33) ^ 0xff;
+	if (class->res_class)
+	    for (p = class->res_class; *p; p++) h = (h * 33) ^ (unsigned char) *p;
+    }
+    return (h % LIST_CACHE_SIZE);
+}
+
+static int cache_key_equal (char *a, char *b)
+{
+    if ((a == NULL) || (b == NULL)) return (a == b);
+    return (strcmp (a, b) == 0);
+}
+
+static char *cache_key_dup (char *s)
+{
+    return ((s == NULL) ? NULL : (char*) strdup (s));
+}
+
+static void cache_entry_clear (name_list_cache_entry *ce)
+{
+    if (ce->name) free (ce->name);
+    if (ce->res_name) free (ce->res_name);
+    if (ce->res_class) free (ce->res_class);
+    ce->name = ce->res_name = ce->res_class = NULL;
+    ce->valid = FALSE;
+}
+
+static void FreeListCache (name_list *nptr)
+{
+    int i;
+
+    if (nptr->cache == NULL) return;
+    for (i = 0; i < LIST_CACHE_SIZE; i++)
+	cache_entry_clear (&nptr->cache->entries [i]);
+    free ((char *) nptr->cache);
+    nptr->cache = NULL;
+}
+
+/*
+ * Find the first entry matching name, then res_name, then res_class,
+ * going through the cache of the list head.
+ */
+static name_list *FindInList (name_list *list_head, char *name,
+			      XClassHint *class)
+{
+    name_list *nptr;
+    name_list_cache_entry *ce;
+
+    if (list_head == NULL) return (NULL);
+
+    if (list_head->cache == NULL) {
+	list_head->cache = (name_list_cache*) calloc (1, sizeof (name_list_cache));
+    }
+    ce = NULL;
+    if (list_head->cache != NULL) {
+	ce = &list_head->cache->entries [cache_hash (name, class)];
+	if (ce->valid && cache_key_equal (ce->name, name) &&
+	    (ce->has_class == (class != NULL)) &&
+	    (!class || (cache_key_equal (ce->res_name,  class->res_name) &&
+			cache_key_equal (ce->res_class, class->res_class))))
+	    return (ce->hit);
+    }
+
+    /* look for the name first */
     for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	if (match (nptr->name, name))
-	{
-	    save = Scr->FirstTime;
-	    Scr->FirstTime = TRUE;
-	    GetColor(Scr->Monochrome, ptr, nptr->ptr);
-	    Scr->FirstTime = save;
-	    return (TRUE);
-	}
+	if (match_entry (nptr, name)) break;
 
-    if (class)
+    if ((nptr == NULL) && class)
     {
+	/* look for the res_name next */
 	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_name))
-	    {
-		save = Scr->FirstTime;
-		Scr->FirstTime = TRUE;
-		GetColor(Scr->Monochrome, ptr, nptr->ptr);
-		Scr->FirstTime = save;
-		return (TRUE);
-	    }
+	    if (match_entry (nptr, class->res_name)) break;
 
-	for (nptr = list_head; nptr != NULL; nptr = nptr->next)
-	    if (match (nptr->name, class->res_class))
-	    {
-		save = Scr->FirstTime;
-		Scr->FirstTime = TRUE;
-		GetColor(Scr->Monochrome, ptr, nptr->ptr);
-		Scr->FirstTime = save;
-		return (TRUE);
-	    }
+	/* finally look for the res_class */
+	if (nptr == NULL)
+	    for (nptr = list_head; nptr != NULL; nptr = nptr->next)
+		if (match_entry (nptr, class->res_class)) break;
     }
-    return (FALSE);
+
+    if (ce != NULL) {
+	cache_entry_clear (ce);
+	ce->name      = cache_key_dup (name);
+	ce->has_class = (class != NULL);
+	ce->res_name  = class ? cache_key_dup (class->res_name)  : NULL;
+	ce->res_class = class ? cache_key_dup (class->res_class) : NULL;
+	ce->hit       = nptr;
+	ce->valid     = TRUE;
+    }
+    return (nptr);
 }
 
 /***********************************************************************
@@ -281,16 +368,324 @@ void FreeList(name_list **list)
     for (nptr = *list; nptr != NULL; )
     {
 	tmp = nptr->next;
+	FreeListCache (nptr);
+#ifdef USE_GNU_REGEX
+	if (nptr->re) {
+	    regfree (nptr->re);
+	    free ((char *) nptr->re);
+	}
+#endif /* USE_GNU_REGEX */
 	free((char *) nptr);
 	nptr = tmp;
     }
     *list = NULL;
 }
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	CreateNameListSet - compile several lists into one matcher
+ *
+ *  Returned Value:
+ *	the matcher, or NULL if it could not be allocated
+ *
+ *  Inputs:
+ *	lists	- the heads of the lists to combine
+ *	nlists	- the number of lists
+ *
+ *  Special Considerations
+ *	Only membership is recorded, not which entry matched, so this
+ *	is only useful for lists whose ptr value is not used.  The set
+ *	refers to the list entries and must be freed before the lists.
+ *
+ ***********************************************************************
+ */
+
+/*
+ * Every distinct name found in the lists is entered once, along with
+ * the lists it appears in.  Plain names (without any pattern character)
+ * are looked up in a hash table, so their cost does not depend on their
+ * number; only the real patterns are tried one by one, each of them
+ * once no matter how many lists it appears in.
+ */
+typedef struct name_set_entry {
+    struct name_set_entry *next;	/* next in hash bucket */
+    char	*name;			/* shared with the list entry */
+    int		literal;		/* contains no pattern character */
+#ifdef USE_GNU_REGEX
+    regex_t	*re;			/* shared with the list entry */
+#else
+    int		prefixlen;		/* length of the literal prefix */
+#endif /* USE_GNU_REGEX */
+    char	*lists;			/* lists this name appears in */
+} name_set_entry;
+
+struct name_list_set {
+    int		nlists;
+    int		nbuckets;
+    name_set_entry **buckets;		/* every distinct name */
+    int		npatterns;
+    name_set_entry **patterns;		/* the non literal ones */
+#ifdef USE_GNU_REGEX
+    regex_t	*any;			/* all patterns as one alternation */
+#endif /* USE_GNU_REGEX */
+};
+
+static unsigned int name_hash (char *s)
+{
+    unsigned int h = 5381;
+
+    while (*s) h = (h * 33) ^ (unsigned char) *s++;
+    return (h);
+}
+
+static int literal_prefix (char *s)
+{
+#ifdef USE_GNU_REGEX
+    /* regular expressions match anywhere in the string */
+    return (-1);
+#else
+    char *p;
+
+    for (p = s; *p; p++)
+	if ((*p == '?') || (*p == '*') || (*p == '[') || (*p == '\\'))
+	    break;
+    return (p - s);
+#endif /* USE_GNU_REGEX */
+}
+
+#ifdef USE_GNU_REGEX
+/*
+ * Whether a regular expression refers back to one of its groups.  Its
+ * groups would be renumbered in the alternation of all the patterns, so
+ * a set holding such a pattern is matched without that prefilter.
+ */
+static int has_backreference (char *s)
+{
+    for (; *s; s++) {
+	if (*s != '\\') continue;
+	if ((s [1] >= '1') && (s [1] <= '9')) return (TRUE);
+	if (s [1] == '\0') break;
+	s++;
+    }
+    return (FALSE);
+}
+#endif /* USE_GNU_REGEX */
+
+static void set_hit (name_list_set *set, name_set_entry *e, char *hits)
+{
+    int i;
+
+    for (i = 0; i < set->nlists; i++)
+	if (e->lists [i]) hits [i] = TRUE;
+}
+
+name_list_set *CreateNameListSet (name_list **lists, int nlists)
+{
+    name_list_set *set;
+    name_list *nptr;
+    name_set_entry *e;
+    int i, nentries, prefix;
+    unsigned int h;
+
+    nentries = 0;
+    for (i = 0; i < nlists; i++)
+	for (nptr = lists [i]; nptr != NULL; nptr = nptr->next) nentries++;
+
+    set = (name_list_set*) calloc (1, sizeof (name_list_set));
+    if (set == NULL) return (NULL);
+    set->nlists = nlists;
+    for (set->nbuckets = 16; set->nbuckets < 2 * nentries; set->nbuckets *= 2);
+    set->buckets  = (name_set_entry**) calloc (set->nbuckets, sizeof (name_set_entry*));
+    set->patterns = (name_set_entry**) calloc (nentries + 1, sizeof (name_set_entry*));
+    if ((set->buckets == NULL) || (set->patterns == NULL)) {
+	FreeNameListSet (&set);
+	return (NULL);
+    }
+
+    for (i = 0; i < nlists; i++) {
+	for (nptr = lists [i]; nptr != NULL; nptr = nptr->next) {
+	    if (nptr->name == NULL) continue;
+#ifdef USE_GNU_REGEX
+	    if (nptr->re == NULL) continue;	/* never matches */
+#endif /* USE_GNU_REGEX */
+	    h = name_hash (nptr->name) & (set->nbuckets - 1);
+	    for (e = set->buckets [h]; e != NULL; e = e->next)
+		if (strcmp (e->name, nptr->name) == 0) break;
+	    if (e == NULL) {
+		e = (name_set_entry*) calloc (1, sizeof (name_set_entry));
+		if (e != NULL) e->lists = (char*) calloc (nlists, sizeof (char));
+		if ((e == NULL) || (e->lists == NULL)) {
+		    if (e) free ((char*) e);
+		    FreeNameListSet (&set);
+		    return (NULL);
+		}
+		e->name = nptr->name;
+		prefix  = literal_prefix (nptr->name);
+		e->literal = (prefix >= 0) && (nptr->name [prefix] == '\0');
+#ifdef USE_GNU_REGEX
+		e->re = nptr->re;
+#else
+		e->prefixlen = prefix;
+#endif /* USE_GNU_REGEX */
+		e->next = set->buckets [h];
+		set->buckets [h] = e;
+		if (!e->literal) set->patterns [set->npatterns++] = e;
+	    }
+	    e->lists [i] = TRUE;
+	}
+    }
+
+#ifdef USE_GNU_REGEX
+    for (i = 0; i < set->npatterns; i++)
+	if (has_backreference (set->patterns [i]->name)) break;
+    if ((set->npatterns > 1) && (i == set->npatterns)) {
+	char *any;
+	int len;
+
+	len = 1;
+	for (i = 0; i < set->npatterns; i++) len += strlen (set->patterns [i]->name) + 3;
+	any = (char*) malloc (len);
+	if (any != NULL) {
+	    any [0] = '\0';
+	    for (i = 0; i < set->npatterns; i++) {
+		if (i) strcat (any, "|");
+		strcat (any, "(");
+		strcat (any, set->patterns [i]->name);
+		strcat (any, ")");
+	    }
+	    set->any = (regex_t*) malloc (sizeof (regex_t));
+	    if (set->any && regcomp (set->any, any, REG_EXTENDED | REG_NOSUB) != 0) {
+		free ((char*) set->any);
+		set->any = NULL;
+	    }
+	    free (any);
+	}
+    }
+#endif /* USE_GNU_REGEX */
+    return (set);
+}
+
+static void MatchNameListSetString (name_list_set *set, char *string, char *hits)
+{
+    name_set_entry *e;
+    int i;
+    unsigned int h;
+
+    if (string == NULL) return;
+
+    h = name_hash (string) & (set->nbuckets - 1);
+    for (e = set->buckets [h]; e != NULL; e = e->next)
+	if (e->literal && (strcmp (e->name, string) == 0)) {
+	    set_hit (set, e, hits);
+	    break;
+	}
+
+#ifdef USE_GNU_REGEX
+    if (set->any && (regexec (set->any, string, 0, NULL, 0) != 0)) return;
+#endif /* USE_GNU_REGEX */
+    for (i = 0; i < set->npatterns; i++) {
+	e = set->patterns [i];
+#ifdef USE_GNU_REGEX
+	if (regexec (e->re, string, 0, NULL, 0) == 0)
+	    set_hit (set, e, hits);
+#else
+	if (e->prefixlen && (strncmp (e->name, string, e->prefixlen) != 0))
+	    continue;
+	if (match (e->name, string))
+	    set_hit (set, e, hits);
+#endif /* USE_GNU_REGEX */
+    }
+}
+
+/***********************************************************************
+ *
+ *  Procedure:
+ *	MatchNameListSet - find all the lists of a set matching a window
+ *
+ *  Inputs:
+ *	set	- the set built by CreateNameListSet
+ *	name	- the name to look for
+ *	class	- the class to look for, may be NULL
+ *
+ *  Outputs:
+ *	hits	- for each list, TRUE if the name, res_name or res_class
+ *		  is found in it, as LookInList would
+ *
+ ***********************************************************************
+ */
+
+void MatchNameListSet (name_list_set *set, char *name,
+		       XClassHint *class, char *hits)
+{
+    memset (hits, 0, set->nlists);
+    MatchNameListSetString (set, name, hits);
+    if (class) {
+	MatchNameListSetString (set, class->res_name,  hits);
+	MatchNameListSetString (set, class->res_class, hits);
+    }
+}
+
+void FreeNameListSet (name_list_set **set)
+{
+    name_set_entry *e, *next;
+    int i;
+
+    if (*set == NULL) return;
+    if ((*set)->buckets) {
+	for (i = 0; i < (*set)->nbuckets; i++) {
+	    for (e = (*set)->buckets [i]; e != NULL; e = next) {
+		next = e->next;
+		free (e->lists);
+		free ((char*) e);
+	    }
+	}
+	free ((char*) (*set)->buckets);
+    }
+    if ((*set)->patterns) free ((char*) (*set)->patterns);
+#ifdef USE_GNU_REGEX
+    if ((*set)->any) {
+	regfree ((*set)->any);
+	free ((char*) (*set)->any);
+    }
+#endif /* USE_GNU_REGEX */
+    free ((char*) *set);
+    *set = NULL;
+}
+
 #ifdef USE_GNU_REGEX
 
 #define MAXPATLEN 256
 
+/*
+ * List entries are compiled once when they are added, instead of on
+ * every comparison.  An entry which does not compile never matches.
+ */
+static regex_t *CompileListEntry (char *pattern)
+{
+  regex_t *preg;
+  int error;
+
+  if (pattern == NULL) return NULL;
+  preg = (regex_t*) malloc (sizeof (regex_t));
+  if (preg == NULL) return NULL;
+  error = regcomp (preg, pattern, REG_EXTENDED | REG_NOSUB);
+  if (error != 0) {
+    char buf [256];
+    (void) regerror (error, preg, buf, sizeof buf);
+    fprintf (stderr, "%s : %s\n", buf, pattern);
+    free ((char*) preg);
+    return NULL;
+  }
+  return preg;
+}
+
+static int match_entry (name_list *nptr, char *string)
+{
+  if ((nptr->re == NULL) || (string == NULL)) return 0;
+  return (regexec (nptr->re, string, 0, NULL, 0) == 0);
+}
+
 int match (pattern, string)
      char *pattern, *string;
 {
@@ -438,6 +833,11 @@ int match (char *p, char *t)
     return ((regex_match (p,t) == TRUE) ? TRUE : FALSE);
 }
 
+static int match_entry (name_list *nptr, char *string)
+{
+    return (match (nptr->name, string));
+}
+
 #endif
 
 
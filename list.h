@@ -66,11 +66,21 @@
 
 #include "types.h"
 
+#ifdef USE_GNU_REGEX
+# include <regex.h>
+#endif /* USE_GNU_REGEX */
+
+typedef struct name_list_cache name_list_cache;
+
 struct name_list
 {
     name_list *next;		/* pointer to the next name */
     char *name;			/* the name of the window */
     char *ptr;			/* list dependent data */
+#ifdef USE_GNU_REGEX
+    regex_t *re;		/* compiled name, NULL if it did not compile */
+#endif /* USE_GNU_REGEX */
+    name_list_cache *cache;	/* lookup cache, only used on the list head */
 };
 
 extern void	AddToList(name_list **list_head, char *name, char *ptr);
@@ -86,5 +96,10 @@ extern void	FreeList(name_list **list);
 
 extern int	match (char *pattern, char *string);
 
+extern name_list_set *CreateNameListSet(name_list **lists, int nlists);
+extern void	MatchNameListSet(name_list_set *set, char *name,
+				 XClassHint *class, char *hits);
+extern void	FreeNameListSet(name_list_set **set);
+
 #endif /* _LIST_ */
 
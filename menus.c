@@ -83,6 +83,8 @@
 #include <decw$include/Xos.h>
 #include <decw$include/Xatom.h>
 #else
+#include <sys/time.h>
+#include <sys/select.h>
 #include <X11/Xos.h>
 #include <X11/Xatom.h>
 #endif
@@ -165,9 +167,9 @@ static void Paint3DEntry(MenuRoot *mr, MenuItem *mi, int exposure);
 static void PaintNormalEntry(MenuRoot *mr, MenuItem *mi, int exposure);
 static void MakeMenu (MenuRoot *mr);
 static void DestroyMenu (MenuRoot *menu);
-static void MosaicFade (TwmWindow *tmp_win, Window blanket);
 static void SendSaveYourselfMessage (TwmWindow *tmp, Time timestamp);
 static void SendDeleteWindowMessage (TwmWindow *tmp, Time timestamp);
+static void StartIconifyEffect (TwmWindow *tmp_win, Window blanket);
 static void HideIconManager (void);
 static void ShowIconManager (void);
 static void BumpWindowColormap (TwmWindow *tmp, int inc);
@@ -176,11 +178,6 @@ static int WarpToScreen (int n, int inc);
 static void Execute (char *s);
 static int NeedToDefer (MenuRoot *root);
 static int DeferExecution(int context, int func, Cursor cursor);
-static void ZoomInWindow (TwmWindow *tmp_win, Window blanket);
-static void ZoomOutWindow (TwmWindow *tmp_win, Window blanket);
-static void FadeWindow (TwmWindow *tmp_win, Window blanket);
-static void SweepWindow (TwmWindow *tmp_win, Window blanket);
-static void waitamoment (float timeout);
 
 
 #define SHADOWWIDTH 5			/* in pixels */
@@ -210,6 +207,8 @@ void InitMenus(void)
 
     Scr->FuncKeyRoot.next = NULL;
     Scr->FuncButtonRoot.next = NULL;
+    memset (Scr->FuncKeyHash, 0, sizeof (Scr->FuncKeyHash));
+    memset (Scr->FuncButtonHash, 0, sizeof (Scr->FuncButtonHash));
 }
 
 
@@ -233,7 +232,7 @@ void InitMenus(void)
 Bool AddFuncKey (char *name, int cont, int mods, int func,
 		 MenuRoot *menu, char *win_name, char *action)
 {
-    FuncKey *tmp;
+    FuncKey *tmp, **bucket;
     KeySym keysym;
     KeyCode keycode;
 
@@ -248,7 +247,8 @@ Bool AddFuncKey (char *name, int cont, int mods, int func,
     }
 
     /* see if there already is a key defined for this context */
-    for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next)
+    bucket = &Scr->FuncKeyHash [KEY_HASH (keycode, mods)];
+    for (tmp = *bucket; tmp != NULL; tmp = tmp->hnext)
     {
 	if (tmp->keysym == keysym &&
 	    tmp->cont == cont &&
@@ -262,6 +262,8 @@ Bool AddFuncKey (char *name, int cont, int mods, int func,
 	tmp = (FuncKey *) malloc(sizeof(FuncKey));
 	tmp->next = Scr->FuncKeyRoot.next;
 	Scr->FuncKeyRoot.next = tmp;
+	tmp->hnext = *bucket;
+	*bucket = tmp;
     }
 
     tmp->name = name;
@@ -273,10 +275,38 @@ Bool AddFuncKey (char *name, int cont, int mods, int func,
     tmp->menu = menu;
     tmp->win_name = win_name;
     tmp->action = action;
+    tmp->rootgrab = False;
 
     return True;
 }
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	HashFuncKeys - hash the function keys again, after their keycodes
+ *		changed with the keyboard mapping
+ *
+ ***********************************************************************
+ */
+
+void HashFuncKeys (void)
+{
+    FuncKey *tmp, **last [BINDING_HASH_SIZE];
+    int i;
+
+    for (i = 0; i < BINDING_HASH_SIZE; i++) {
+	Scr->FuncKeyHash [i] = NULL;
+	last [i] = &Scr->FuncKeyHash [i];
+    }
+    /* append, so that the buckets keep the order of the list */
+    for (tmp = Scr->FuncKeyRoot.next; tmp != NULL; tmp = tmp->next) {
+	i = KEY_HASH (tmp->keycode, tmp->mods);
+	tmp->hnext = NULL;
+	*last [i] = tmp;
+	last [i] = &tmp->hnext;
+    }
+}
+
 /***********************************************************************
  *
  *  Procedure:
@@ -296,10 +326,11 @@ Bool AddFuncKey (char *name, int cont, int mods, int func,
 Bool AddFuncButton (int num, int cont, int mods, int func,
 		    MenuRoot *menu, MenuItem *item)
 {
-    FuncButton *tmp;
+    FuncButton *tmp, **bucket;
 
     /* see if there already is a key defined for this context */
-    for (tmp = Scr->FuncButtonRoot.next; tmp != NULL; tmp = tmp->next) {
+    bucket = &Scr->FuncButtonHash [BUTTON_HASH (num, cont, mods)];
+    for (tmp = *bucket; tmp != NULL; tmp = tmp->hnext) {
 	if ((tmp->num == num) && (tmp->cont == cont) && (tmp->mods == mods))
 	    break;
     }
@@ -309,6 +340,8 @@ Bool AddFuncButton (int num, int cont, int mods, int func,
 	tmp = (FuncButton*) malloc (sizeof (FuncButton));
 	tmp->next = Scr->FuncButtonRoot.next;
 	Scr->FuncButtonRoot.next = tmp;
+	tmp->hnext = *bucket;
+	*bucket = tmp;
     }
 
     tmp->num  = num;
@@ -1466,7 +1499,7 @@ Bool PopUpMenu (MenuRoot *menu, int x, int y, Bool center)
              tmp_win != NULL;
              tmp_win = tmp_win->next)
         {
-	    if (LookInList (Scr->IconMenuDontShow, tmp_win->full_name, &tmp_win->class)) continue;
+	    if (tmp_win->policy.icon_menu_dont_show) continue;
 
 	    if (tmp_win == Scr->workSpaceMgr.occupyWindow->twm_win) continue;
 	    if (Scr->ShortAllWindowsMenus &&
@@ -1888,6 +1921,71 @@ void resizeFromCenter(Window w, TwmWindow *tmp_win)
 
 
 
+/*
+ * Opaque moves are paced to the refresh rate of the display: moving a
+ * window more often than it can be seen only makes work for the server
+ * and for the clients below it.  A position that has to wait is used when
+ * its frame is due, unless another event comes first.
+ */
+static struct timeval MoveFrameDue;
+
+static Bool MoveFrameReady (void)
+{
+    struct timeval now;
+
+    gettimeofday (&now, NULL);
+    if (timercmp (&now, &MoveFrameDue, <))
+	return FALSE;
+    MoveFrameDue.tv_sec  = now.tv_sec;
+    MoveFrameDue.tv_usec = now.tv_usec + Scr->FrameInterval;
+    while (MoveFrameDue.tv_usec >= 1000000) {
+	MoveFrameDue.tv_sec++;
+	MoveFrameDue.tv_usec -= 1000000;
+    }
+    return TRUE;
+}
+
+/*
+ * Wait for an event in mask until the next frame is due; FALSE if the
+ * frame comes first.
+ */
+static Bool WaitForMoveEvent (long mask)
+{
+    struct timeval now, timeout;
+    XEvent event;
+    fd_set fds;
+    int fd = ConnectionNumber (dpy);
+
+    while (! XCheckMaskEvent (dpy, mask, &event)) {
+	gettimeofday (&now, NULL);
+	if (! timercmp (&now, &MoveFrameDue, <))
+	    return FALSE;
+	timeout.tv_sec  = MoveFrameDue.tv_sec - now.tv_sec;
+	timeout.tv_usec = MoveFrameDue.tv_usec - now.tv_usec;
+	if (timeout.tv_usec < 0) {
+	    timeout.tv_sec--;
+	    timeout.tv_usec += 1000000;
+	}
+	FD_ZERO (&fds);
+	FD_SET (fd, &fds);
+	if (select (fd + 1, &fds, NULL, NULL, &timeout) == 0)
+	    return FALSE;
+    }
+    XPutBackEvent (dpy, &event);
+    return TRUE;
+}
+
+static void OpaqueMoveTo (TwmWindow *tmp_win, Window w, Bool moving_icon,
+			  int xl, int yt)
+{
+    XMoveWindow (dpy, w, xl, yt);
+    if (moving_icon) {
+	tmp_win->icon->w_x = xl;
+	tmp_win->icon->w_y = yt;
+    } else
+	WMapSetupWindow (tmp_win, xl, yt, -1, -1);
+}
+
 void RescueWindows (void);
 /***********************************************************************
  *
@@ -2393,6 +2491,8 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	    StartResize (eventp, tmp_win, fromtitlebar, from3dborder);
 	    
 	    do {
+		HandleSyncAlarms ();
+		WMapFlush ();
 		XMaskEvent(dpy,
 			   ButtonPressMask | ButtonReleaseMask |
 			   EnterWindowMask | LeaveWindowMask |
@@ -2545,6 +2645,8 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
     case F_MOVEPACK:
     case F_MOVEPUSH: {
         Window grabwin, dragroot;
+	Bool movePending = FALSE;	/* a paced opaque move waits */
+	int pendingX = 0, pendingY = 0;
 
 	if (DeferExecution(context, func, Scr->MoveCursor))
 	    return TRUE;
@@ -2713,7 +2815,16 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	    long movementMask = menuFromFrameOrWindowOrTitlebar ?
 	                          PointerMotionMask : ButtonMotionMask;
 
+	    /* catch up with the pointer if nothing happens before the frame */
+	    if (movePending && !WaitForMoveEvent (ButtonPressMask | ButtonReleaseMask |
+						   ExposureMask | movementMask)) {
+		(void) MoveFrameReady ();
+		OpaqueMoveTo (tmp_win, DragWindow, moving_icon, pendingX, pendingY);
+		movePending = FALSE;
+	    }
+
 	    /* block until there is an interesting event */
+	    WMapFlush ();
 	    XMaskEvent(dpy, ButtonPressMask | ButtonReleaseMask |
 				    EnterWindowMask | LeaveWindowMask |
 				    ExposureMask | movementMask |
@@ -2782,6 +2893,10 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	    }
 	    if (Event.type == releaseEvent)
 	    {
+		if (movePending) {
+		    OpaqueMoveTo (tmp_win, DragWindow, moving_icon, pendingX, pendingY);
+		    movePending = FALSE;
+		}
 		MoveOutline(dragroot, 0, 0, 0, 0, 0, 0);
 		if (moving_icon &&
 		    ((CurrentDragX != origDragX ||
@@ -2803,15 +2918,26 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	    if (Event.type != MotionNotify)
 		continue;
 
-	    XQueryPointer(dpy, rootw, &(eventp->xmotion.root), &JunkChild,
-		&(eventp->xmotion.x_root), &(eventp->xmotion.y_root),
-		&JunkX, &JunkY, &JunkMask);
-
-	    FixRootEvent (eventp);
-	    if (tmp_win->winbox) {
-		XTranslateCoordinates (dpy, dragroot, tmp_win->winbox->window,
-		    eventp->xmotion.x_root, eventp->xmotion.y_root,
-		    &(eventp->xmotion.x_root), &(eventp->xmotion.y_root), &JunkChild);
+	    if (Scr->CompressMotion) {
+		/* the last queued motion event, already fixed up */
+		eventp->xmotion.root   = Event.xmotion.root;
+		eventp->xmotion.x_root = Event.xmotion.x_root;
+		eventp->xmotion.y_root = Event.xmotion.y_root;
+		if (tmp_win->winbox)
+		    RootToWinBox (tmp_win->winbox,
+			eventp->xmotion.x_root, eventp->xmotion.y_root,
+			&(eventp->xmotion.x_root), &(eventp->xmotion.y_root));
+	    } else {
+		XQueryPointer(dpy, rootw, &(eventp->xmotion.root), &JunkChild,
+		    &(eventp->xmotion.x_root), &(eventp->xmotion.y_root),
+		    &JunkX, &JunkY, &JunkMask);
+
+		FixRootEvent (eventp);
+		if (tmp_win->winbox) {
+		    XTranslateCoordinates (dpy, dragroot, tmp_win->winbox->window,
+			eventp->xmotion.x_root, eventp->xmotion.y_root,
+			&(eventp->xmotion.x_root), &(eventp->xmotion.y_root), &JunkChild);
+		}
 	    }
 	    if (DragWindow == None &&
 		abs(eventp->xmotion.x_root - origX) < Scr->MoveDelta &&
@@ -2942,14 +3068,16 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 		  if (MoveFunction == F_MOVEPUSH && !moving_icon) {
 		        SetupWindow (tmp_win, xl, yt,
 				tmp_win->frame_width, tmp_win->frame_height, -1);
+			WMapSetupWindow (tmp_win, xl, yt, -1, -1);
+		  } else if (MoveFrameReady ()) {
+			OpaqueMoveTo (tmp_win, DragWindow, moving_icon, xl, yt);
+			movePending = FALSE;
 		  } else {
-			XMoveWindow(dpy, DragWindow, xl, yt);
-			if (moving_icon) {
-			    tmp_win->icon->w_x = xl;
-			    tmp_win->icon->w_y = yt;
-			}
+			/* too soon after the last one */
+			movePending = TRUE;
+			pendingX = xl;
+			pendingY = yt;
 		  }
-		  if (! moving_icon) WMapSetupWindow (tmp_win, xl, yt, -1, -1);
 		}
 		else {
 		    MoveOutline(dragroot, xl + Scr->currentvs->x,
@@ -3105,16 +3233,27 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	    if (Event.type != MotionNotify)
 		continue;
 
-	    /* get current pointer pos, useful when there is lag */
-	    XQueryPointer(dpy, rootw, &eventp->xmotion.root, &JunkChild,
-		&eventp->xmotion.x_root, &eventp->xmotion.y_root,
-		&JunkX, &JunkY, &JunkMask);
-
-	    FixRootEvent(eventp);
-	    if (tmp_win->winbox) {
-		XTranslateCoordinates(dpy, Scr->Root, tmp_win->winbox->window,
-		    eventp->xmotion.x_root, eventp->xmotion.y_root,
-		    &eventp->xmotion.x_root, &eventp->xmotion.y_root, &JunkChild);
+	    if (Scr->CompressMotion) {
+		/* the last queued motion event, already fixed up */
+		eventp->xmotion.root   = Event.xmotion.root;
+		eventp->xmotion.x_root = Event.xmotion.x_root;
+		eventp->xmotion.y_root = Event.xmotion.y_root;
+		if (tmp_win->winbox)
+		    RootToWinBox(tmp_win->winbox,
+			eventp->xmotion.x_root, eventp->xmotion.y_root,
+			&eventp->xmotion.x_root, &eventp->xmotion.y_root);
+	    } else {
+		/* get current pointer pos, useful when there is lag */
+		XQueryPointer(dpy, rootw, &eventp->xmotion.root, &JunkChild,
+		    &eventp->xmotion.x_root, &eventp->xmotion.y_root,
+		    &JunkX, &JunkY, &JunkMask);
+
+		FixRootEvent(eventp);
+		if (tmp_win->winbox) {
+		    XTranslateCoordinates(dpy, Scr->Root, tmp_win->winbox->window,
+			eventp->xmotion.x_root, eventp->xmotion.y_root,
+			&eventp->xmotion.x_root, &eventp->xmotion.y_root, &JunkChild);
+		}
 	    }
 
 	    if (!Scr->NoRaiseMove && Scr->OpaqueMove && !WindowMoved)
@@ -3379,10 +3518,12 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 
     case F_CIRCLEUP:
 	XCirculateSubwindowsUp(dpy, Scr->Root);
+	StackInvalidate(Scr);
 	break;
 
     case F_CIRCLEDOWN:
 	XCirculateSubwindowsDown(dpy, Scr->Root);
+	StackInvalidate(Scr);
 	break;
 
     case F_EXEC:
@@ -3717,6 +3858,10 @@ int ExecuteFunction(int func, char *action, Window w, TwmWindow *tmp_win,
 	DebugTrace (action);
 	break;
 
+    case F_DUMPSTATS:
+	DumpEventStats ();
+	break;
+
     case F_CHANGESIZE:
 	ChangeSize (action, tmp_win);
 	break;
@@ -3960,6 +4105,358 @@ Window Lowerontop = None;
 Window Upperonbot = None;
 #endif
 
+/***********************************************************************
+ *
+ *  The stacking model
+ *
+ *	etwm keeps the stacking order of the frames itself, from bottom to
+ *	top in Scr->StackBottom ... Scr->StackTop, so that restacking and
+ *	publishing the order need no XQueryTree.  Every change made to the
+ *	stacking of a frame must be reported here.  Changes whose outcome
+ *	only the server knows (TopIf, BottomIf, Opposite, circulation) mark
+ *	the model dirty and it is read back from the server when next used.
+ *
+ *	Each frame carries a rank that grows from bottom to top, so that
+ *	two frames can be compared without walking the list, and is also
+ *	linked in the list of its layer (ontoppriority), kept in stacking
+ *	order too.  The sibling to restack against is then found from the
+ *	ends of the layer lists.
+ *
+ ***********************************************************************
+ */
+
+#define STACK_RANK_GAP	(1L << 12)
+
+static int StackLayer (TwmWindow *tmp_win)
+{
+    int layer = tmp_win->ontoppriority;
+
+    if (layer < 0) return 0;
+    if (layer >= MAXSTACKLAYERS) return MAXSTACKLAYERS - 1;
+    return layer;
+}
+
+static void StackRenumber (void)
+{
+    TwmWindow *t;
+    unsigned long rank = STACK_RANK_GAP;
+
+    for (t = Scr->StackBottom; t != NULL; t = t->stack_above) {
+	t->stack_rank = rank;
+	rank += STACK_RANK_GAP;
+    }
+}
+
+static void StackUnlink (TwmWindow *tmp_win)
+{
+    int layer = tmp_win->stack_layer;
+
+    if (tmp_win->stack_below)
+	tmp_win->stack_below->stack_above = tmp_win->stack_above;
+    else if (Scr->StackBottom == tmp_win)
+	Scr->StackBottom = tmp_win->stack_above;
+    else
+	return;				/* not in the model */
+    if (tmp_win->stack_above)
+	tmp_win->stack_above->stack_below = tmp_win->stack_below;
+    else
+	Scr->StackTop = tmp_win->stack_below;
+    tmp_win->stack_above = tmp_win->stack_below = NULL;
+
+    if (tmp_win->layer_below)
+	tmp_win->layer_below->layer_above = tmp_win->layer_above;
+    else
+	Scr->StackLayerBottom [layer] = tmp_win->layer_above;
+    if (tmp_win->layer_above)
+	tmp_win->layer_above->layer_below = tmp_win->layer_below;
+    else
+	Scr->StackLayerTop [layer] = tmp_win->layer_below;
+    tmp_win->layer_above = tmp_win->layer_below = NULL;
+}
+
+/*
+ * Put tmp_win just above (where == Above) or below sibling, or at the
+ * top or bottom if sibling is NULL.
+ */
+static void StackLink (TwmWindow *tmp_win, int where, TwmWindow *sibling)
+{
+    TwmWindow *below, *above, *t;
+    int layer;
+
+    if (where == Above) {
+	below = sibling ? sibling : Scr->StackTop;
+	above = below ? below->stack_above : NULL;
+    } else {
+	above = sibling ? sibling : Scr->StackBottom;
+	below = above ? above->stack_below : NULL;
+    }
+    tmp_win->stack_below = below;
+    tmp_win->stack_above = above;
+    if (below) below->stack_above = tmp_win; else Scr->StackBottom = tmp_win;
+    if (above) above->stack_below = tmp_win; else Scr->StackTop = tmp_win;
+
+    if (below == NULL && above == NULL)
+	tmp_win->stack_rank = STACK_RANK_GAP;
+    else if (above == NULL)
+	tmp_win->stack_rank = below->stack_rank + STACK_RANK_GAP;
+    else if (below == NULL && above->stack_rank > STACK_RANK_GAP)
+	tmp_win->stack_rank = above->stack_rank - STACK_RANK_GAP;
+    else if (below && above->stack_rank - below->stack_rank > 1)
+	tmp_win->stack_rank = below->stack_rank +
+			      (above->stack_rank - below->stack_rank) / 2;
+    else
+	StackRenumber ();
+    if (above == NULL && below && tmp_win->stack_rank < below->stack_rank)
+	StackRenumber ();		/* wrapped around */
+
+    /* file it in its layer, usually at one end */
+    layer = tmp_win->stack_layer = StackLayer (tmp_win);
+    for (t = Scr->StackLayerTop [layer];
+	 t != NULL && t->stack_rank > tmp_win->stack_rank; t = t->layer_below);
+    tmp_win->layer_below = t;
+    tmp_win->layer_above = t ? t->layer_above : Scr->StackLayerBottom [layer];
+    if (tmp_win->layer_below)
+	tmp_win->layer_below->layer_above = tmp_win;
+    else
+	Scr->StackLayerBottom [layer] = tmp_win;
+    if (tmp_win->layer_above)
+	tmp_win->layer_above->layer_below = tmp_win;
+    else
+	Scr->StackLayerTop [layer] = tmp_win;
+}
+
+static void StackMove (TwmWindow *tmp_win, int where, TwmWindow *sibling)
+{
+    if (sibling == tmp_win) return;
+    StackUnlink (tmp_win);
+    StackLink (tmp_win, where, sibling);
+}
+
+/*
+ * A new frame is created on top of its siblings.
+ */
+void StackAddWindow (TwmWindow *tmp_win, Window parent)
+{
+    tmp_win->stack_parent = parent;
+    StackLink (tmp_win, Above, NULL);
+}
+
+void StackRemoveWindow (TwmWindow *tmp_win)
+{
+    StackUnlink (tmp_win);
+}
+
+/*
+ * The frame has been raised to the top: XRaiseWindow or XMapRaised.
+ */
+void StackRaised (TwmWindow *tmp_win)
+{
+    StackMove (tmp_win, Above, NULL);
+}
+
+/*
+ * The frame has been reparented, which puts it on top of its new
+ * siblings.
+ */
+void StackReparented (TwmWindow *tmp_win, Window parent)
+{
+    tmp_win->stack_parent = parent;
+    StackMove (tmp_win, Above, NULL);
+}
+
+/*
+ * The frame has been given to XConfigureWindow with these changes.
+ */
+void StackConfigured (TwmWindow *tmp_win, unsigned int mask,
+		      XWindowChanges *xwc)
+{
+    TwmWindow *sibling = NULL;
+
+    if (! (mask & CWStackMode)) return;
+    if (mask & CWSibling) {
+	sibling = GetTwmWindow (xwc->sibling);
+	if (sibling == NULL || sibling->frame != xwc->sibling) {
+	    StackInvalidate (Scr);
+	    return;
+	}
+    }
+    switch (xwc->stack_mode) {
+	case Above:
+	case Below:
+	    StackMove (tmp_win, xwc->stack_mode, sibling);
+	    break;
+	default:
+	    StackInvalidate (Scr);
+	    break;
+    }
+}
+
+void StackInvalidate (ScreenInfo *scr)
+{
+    scr->StackDirty = True;
+}
+
+static void StackSyncParent (ScreenInfo *scr, Window parent)
+{
+    Window root, junk, *children = NULL;
+    unsigned int nchildren = 0, n;
+    TwmWindow *twin;
+
+    if (! XQueryTree (dpy, parent, &root, &junk, &children, &nchildren))
+	return;
+    for (n = 0; n < nchildren; n++) {
+	if (XFindContext (dpy, children [n], TwmContext, (XPointer *) &twin) != XCSUCCESS
+	    || twin == NULL || twin->frame != children [n] || twin->stack_below
+	    || scr->StackBottom == twin)
+	    continue;
+	twin->stack_parent = parent;
+	StackLink (twin, Above, NULL);
+    }
+    if (children) XFree (children);
+}
+
+/*
+ * Read the stacking order back from the server.
+ */
+static void StackSync (ScreenInfo *scr)
+{
+    ScreenInfo *savedScr = Scr;
+    VirtualScreen *vs;
+    TwmWindow *twin;
+    int layer;
+
+    Scr = scr;
+    for (twin = scr->FirstWindow; twin != NULL; twin = twin->next) {
+	twin->stack_above = twin->stack_below = NULL;
+	twin->layer_above = twin->layer_below = NULL;
+    }
+    scr->StackBottom = scr->StackTop = NULL;
+    for (layer = 0; layer < MAXSTACKLAYERS; layer++)
+	scr->StackLayerBottom [layer] = scr->StackLayerTop [layer] = NULL;
+
+    StackSyncParent (scr, scr->Root);
+    for (vs = scr->vScreenList; vs != NULL; vs = vs->next)
+	if (vs->window != scr->Root) StackSyncParent (scr, vs->window);
+    for (twin = scr->FirstWindow; twin != NULL; twin = twin->next)
+	if (twin->stack_below == NULL && scr->StackBottom != twin &&
+	    twin->stack_parent != None)
+	    StackSyncParent (scr, twin->stack_parent);
+    for (twin = scr->FirstWindow; twin != NULL; twin = twin->next)
+	if (twin->stack_below == NULL && scr->StackBottom != twin)
+	    StackLink (twin, Above, NULL);
+    scr->StackDirty = False;
+    Scr = savedScr;
+}
+
+TwmWindow *StackBottomWindow (ScreenInfo *scr)
+{
+    if (scr->StackDirty) StackSync (scr);
+    return scr->StackBottom;
+}
+
+/*
+ * Make sure the model is usable and tmp_win is filed in its current
+ * layer, which the EWMH and WMH code change before restacking.
+ */
+static void StackPrepare (TwmWindow *tmp_win)
+{
+    TwmWindow *below;
+
+    if (Scr->StackDirty) StackSync (Scr);
+    if (tmp_win && tmp_win->stack_layer != StackLayer (tmp_win)) {
+	below = tmp_win->stack_below;
+	StackUnlink (tmp_win);
+	StackLink (tmp_win, below ? Above : Below, below);
+    }
+}
+
+/*
+ * The bottom-most frame under parent in a layer above ontop: the
+ * sibling to stack a raised window below.
+ */
+static TwmWindow *StackFirstAbove (Window parent, int ontop)
+{
+    TwmWindow *t, *first = NULL;
+    int layer;
+
+    for (layer = (ontop < 0) ? 0 : ontop + 1; layer < MAXSTACKLAYERS; layer++) {
+	for (t = Scr->StackLayerBottom [layer]; t != NULL; t = t->layer_above) {
+	    if (t->stack_parent != parent) continue;
+	    if (first == NULL || t->stack_rank < first->stack_rank) first = t;
+	    break;
+	}
+    }
+    return first;
+}
+
+/*
+ * The top-most frame under parent in a layer below ontop: the sibling
+ * to stack a lowered window above.
+ */
+static TwmWindow *StackLastBelow (Window parent, int ontop)
+{
+    TwmWindow *t, *last = NULL;
+    int layer;
+
+    if (ontop > MAXSTACKLAYERS) ontop = MAXSTACKLAYERS;
+    for (layer = 0; layer < ontop; layer++) {
+	for (t = Scr->StackLayerTop [layer]; t != NULL; t = t->layer_below) {
+	    if (t->stack_parent != parent) continue;
+	    if (last == NULL || t->stack_rank > last->stack_rank) last = t;
+	    break;
+	}
+    }
+    return last;
+}
+
+/*
+ * The bottom-most and top-most frames under parent in layer ontop.
+ */
+static void StackLayerEnds (Window parent, int ontop,
+			    TwmWindow **botp, TwmWindow **topp)
+{
+    TwmWindow *t;
+
+    *botp = *topp = NULL;
+    if (ontop < 0 || ontop >= MAXSTACKLAYERS) return;
+    for (t = Scr->StackLayerBottom [ontop]; t != NULL; t = t->layer_above)
+	if (t->stack_parent == parent) break;
+    *botp = t;
+    for (t = Scr->StackLayerTop [ontop]; t != NULL; t = t->layer_below)
+	if (t->stack_parent == parent) break;
+    *topp = t;
+}
+
+#ifdef DEBUG_STACKING
+/*
+ * Compare the model with what the server says about parent.
+ */
+static void StackCheck (Window parent, char *where)
+{
+    Window root, junk, *children = NULL;
+    unsigned int nchildren = 0, n;
+    TwmWindow *twin, *t;
+
+    if (! XQueryTree (dpy, parent, &root, &junk, &children, &nchildren))
+	return;
+    t = Scr->StackBottom;
+    for (n = 0; n < nchildren; n++) {
+	if (XFindContext (dpy, children [n], TwmContext, (XPointer *) &twin) != XCSUCCESS
+	    || twin == NULL || twin->frame != children [n])
+	    continue;
+	while (t != NULL && t->stack_parent != parent) t = t->stack_above;
+	if (t != twin) {
+	    fprintf (stderr, "%s: %s: stacking model out of sync at 0x%lx (0x%lx expected)\n",
+		     ProgramName, where, children [n], t ? t->frame : None);
+	    StackInvalidate (Scr);
+	    break;
+	}
+	t = t->stack_above;
+    }
+    if (children) XFree (children);
+}
+#endif
+
 static void PlaceTransients (TwmWindow *tmp_win, int where)
 {
     int	sp, sc;
@@ -3977,6 +4474,7 @@ static void PlaceTransients (TwmWindow *tmp_win, int where)
 		if (sc < ((sp * Scr->TransientOnTop) / 100)) {
 		    xwc.sibling = tmp_win->frame;
 		    XConfigureWindow(dpy, t->frame, CWSibling | CWStackMode, &xwc);
+		    StackConfigured(t, CWSibling | CWStackMode, &xwc);
 #if 0
 		    if (Lowerontop == t->frame) {
 			Lowerontop = None;
@@ -4041,78 +4539,68 @@ void MapRaised (TwmWindow *tmp_win)
 
 #if 1
 
+/*
+ * The parent of an icon window, for the sibling lookups below.
+ */
+static Window IconParent(Window icon)
+{
+    TwmWindow *twin = NULL;
+
+    if (XFindContext(dpy, icon, TwmContext, (XPointer *) &twin) == XCSUCCESS
+	&& twin != NULL && twin->icon != NULL && twin->icon->w == icon)
+	return twin->icon->parent;
+    return Scr->Root;
+}
+
 void
 RaiseWindow(TwmWindow *tmp_win)
 {
-    Window root, parent, *children, above = None;
-    unsigned int nchildren;
-    short ontop = tmp_win->ontoppriority;
+    TwmWindow *above;
     XWindowChanges xwc;
-    int xwcm, n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
+    int xwcm;
 
-    /* find the bottom-most window that has a higher layer than the window
-       being raised */
-    for (n = 0; n < (int) nchildren; n++) {
-	TwmWindow *twin = NULL;
+    StackPrepare(tmp_win);
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority > ontop) {
-	    above = twin->frame;
-	    break;
-	}
-    }
+    /* stack it below the bottom-most window that has a higher layer than the
+       window being raised */
+    above = StackFirstAbove(tmp_win->stack_parent, tmp_win->ontoppriority);
     xwcm = CWStackMode;
-    if (above == None) {
+    if (above == NULL) {
 	xwc.stack_mode = Above;
     } else {
 	xwc.stack_mode = Below;
-	xwc.sibling = above;
+	xwc.sibling = above->frame;
 	xwcm |= CWSibling;
     }
     XConfigureWindow(dpy, tmp_win->frame, xwcm, &xwc);
+    StackConfigured(tmp_win, xwcm, &xwc);
     PlaceTransients(tmp_win, Above);
-    XFree(children);
+#ifdef DEBUG_STACKING
+    StackCheck(tmp_win->stack_parent, "RaiseWindow");
+#endif
 }
 
 void
 RaiseIcon(Window icon, short ontop)
 {
-    Window root, parent, *children, above = None;
-    unsigned int nchildren;
+    TwmWindow *above;
     XWindowChanges xwc;
-    int xwcm, n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
+    int xwcm;
 
-    /* find the bottom-most window that has a higher layer than the window
-       being raised */
-    for (n = 0; n < (int) nchildren; n++) {
-	TwmWindow *twin = NULL;
+    StackPrepare(NULL);
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority > ontop) {
-	    above = twin->frame;
-	    break;
-	}
-    }
+    /* stack it below the bottom-most window that has a higher layer than the
+       icon being raised */
+    above = StackFirstAbove(IconParent(icon), ontop);
     xwcm = CWStackMode;
-    if (above == None) {
+    if (above == NULL) {
 	xwc.stack_mode = Above;
     } else {
 	xwc.stack_mode = Below;
-	xwc.sibling = above;
+	xwc.sibling = above->frame;
 	xwcm |= CWSibling;
     }
     XConfigureWindow(dpy, icon, xwcm, &xwc);
-    XFree(children);
 }
 
 #else
@@ -4153,55 +4641,31 @@ void RaiseWindow (TwmWindow *tmp_win)
 void
 RaiseLower(TwmWindow *tmp_win)
 {
-    Window root, parent, *children;
-    unsigned int nchildren, top = -1, bot = -1;
-    short ontop = tmp_win->ontoppriority;
-    int n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
-
-    /* find the bottom-most window with same priority. */
-    for (n = 0; n < (int) nchildren; n++) {
-	TwmWindow *twin = NULL;
-
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority == ontop) {
-	    bot = n;
-	    break;
-	}
-    }
-    /* find the top-most window with the same priority */
-    for (n = (int) nchildren - 1; n >= 0; n--) {
-	TwmWindow *twin = NULL;
+    TwmWindow *top, *bot;
+    XWindowChanges xwc;
+    int xwcm = CWStackMode | CWSibling;
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority == ontop) {
-	    top = n;
-	    break;
-	}
-    }
-    if (top != bot) {
-	XWindowChanges xwc;
-	int xwcm = CWStackMode|CWSibling;
+    StackPrepare(tmp_win);
 
-	if (children[top] != tmp_win->frame) {
-	    /* raise it above children[top] */
-	    xwc.stack_mode = Above;
-	    xwc.sibling = children[top];
-	} else if (children[bot] != tmp_win->frame) {
-	    /* lower it below children[bot] */
-	    xwc.stack_mode = Below;
-	    xwc.sibling = children[bot];
-	}
-	XConfigureWindow(dpy, tmp_win->frame, xwcm, &xwc);
-	PlaceTransients(tmp_win, Above);
+    /* the bottom-most and top-most windows with the same priority */
+    StackLayerEnds(tmp_win->stack_parent, tmp_win->ontoppriority, &bot, &top);
+    if (top == bot)
+	return;
+    if (top != tmp_win) {
+	/* raise it above top */
+	xwc.stack_mode = Above;
+	xwc.sibling = top->frame;
+    } else {
+	/* lower it below bot */
+	xwc.stack_mode = Below;
+	xwc.sibling = bot->frame;
     }
-    XFree(children);
+    XConfigureWindow(dpy, tmp_win->frame, xwcm, &xwc);
+    StackConfigured(tmp_win, xwcm, &xwc);
+    PlaceTransients(tmp_win, Above);
+#ifdef DEBUG_STACKING
+    StackCheck(tmp_win->stack_parent, "RaiseLower");
+#endif
 }
 
 #else
@@ -4226,53 +4690,19 @@ void RaiseLower (TwmWindow *tmp_win)
 void
 RaiseLowerIcon(Window icon, short ontop)
 {
-    Window root, parent, *children;
-    unsigned int nchildren, top = -1, bot = -1;
-    int n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
-
-    /* find the bottom-most window with same priority. */
-    for (n = 0; n < (int) nchildren; n++) {
-	TwmWindow *twin = NULL;
-
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority == ontop) {
-	    bot = n;
-	    break;
-	}
-    }
-    /* find the top-most window with the same priority */
-    for (n = (int) nchildren - 1; n >= 0; n--) {
-	TwmWindow *twin = NULL;
+    TwmWindow *top, *bot;
+    XWindowChanges xwc;
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority == ontop) {
-	    top = n;
-	    break;
-	}
-    }
-    if (top != bot) {
-	XWindowChanges xwc;
-	int xwcm = CWStackMode | CWSibling;
+    StackPrepare(NULL);
 
-	if (children[top] != icon) {
-	    /* raise it above children[top] */
-	    xwc.stack_mode = Above;
-	    xwc.sibling = children[top];
-	} else if (children[bot] != icon) {
-	    /* lower it below children[bot] */
-	    xwc.stack_mode = Below;
-	    xwc.sibling = children[bot];
-	}
-	XConfigureWindow(dpy, icon, xwcm, &xwc);
-    }
-    XFree(children);
+    /* the bottom-most and top-most windows with the same priority */
+    StackLayerEnds(IconParent(icon), ontop, &bot, &top);
+    if (top == bot)
+	return;
+    /* an icon is never one of them: raise it above top */
+    xwc.stack_mode = Above;
+    xwc.sibling = top->frame;
+    XConfigureWindow(dpy, icon, CWStackMode | CWSibling, &xwc);
 }
 
 #else
@@ -4295,40 +4725,29 @@ void RaiseLowerIcon (Window icon, int ontop)
 void
 LowerWindow(TwmWindow *tmp_win)
 {
-    Window root = None, parent = None, *children = NULL, below = None;
-    unsigned int nchildren = 0;
-    short ontop = tmp_win->ontoppriority;
+    TwmWindow *below;
     XWindowChanges xwc;
-    int xwcm, n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
+    int xwcm;
 
-    /* find the top-most window that has a lower layer than the window being
-       lowered */
-    for (n = (int) nchildren - 1; n >= 0; n--) {
-	TwmWindow *twin = NULL;
+    StackPrepare(tmp_win);
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority < ontop) {
-	    below = twin->frame;
-	    break;
-	}
-    }
+    /* stack it above the top-most window that has a lower layer than the
+       window being lowered */
+    below = StackLastBelow(tmp_win->stack_parent, tmp_win->ontoppriority);
     xwcm = CWStackMode;
-    if (below == None) {
+    if (below == NULL) {
 	xwc.stack_mode = Below;
     } else {
 	xwc.stack_mode = Above;
-	xwc.sibling = below;
+	xwc.sibling = below->frame;
 	xwcm |= CWSibling;
     }
     XConfigureWindow(dpy, tmp_win->frame, xwcm, &xwc);
+    StackConfigured(tmp_win, xwcm, &xwc);
     PlaceTransients(tmp_win, Above);
-    if (children != NULL)
-	XFree(children);
+#ifdef DEBUG_STACKING
+    StackCheck(tmp_win->stack_parent, "LowerWindow");
+#endif
 }
 
 #else
@@ -4367,37 +4786,24 @@ void LowerWindow (TwmWindow *tmp_win)
 void
 LowerIcon(Window icon, short ontop)
 {
-    Window root, parent, *children, below = None;
-    unsigned int nchildren;
+    TwmWindow *below;
     XWindowChanges xwc;
-    int xwcm, n;
-
-    if (!XQueryTree(dpy, Scr->Root, &root, &parent, &children, &nchildren))
-	return;
+    int xwcm;
 
-    /* find the top-most window that has a lower layer than the window being
-       lowered */
-    for (n = (int) nchildren - 1; n >= 0; n--) {
-	TwmWindow *twin = NULL;
+    StackPrepare(NULL);
 
-	if (XFindContext(dpy, children[n], TwmContext, (XPointer *) &twin) != XCSUCCESS
-	    || twin == NULL || twin->frame != children[n])
-	    continue;
-	if (twin->ontoppriority < ontop) {
-	    below = twin->frame;
-	    break;
-	}
-    }
+    /* stack it above the top-most window that has a lower layer than the
+       icon being lowered */
+    below = StackLastBelow(IconParent(icon), ontop);
     xwcm = CWStackMode;
-    if (below == None) {
+    if (below == NULL) {
 	xwc.stack_mode = Below;
     } else {
 	xwc.stack_mode = Above;
-	xwc.sibling = below;
+	xwc.sibling = below->frame;
 	xwcm |= CWSibling;
     }
     XConfigureWindow(dpy, icon, xwcm, &xwc);
-    XFree(children);
 }
 
 void RaiseFrame (Window frame)
@@ -4509,7 +4915,7 @@ void DeIconify(TwmWindow *tmp_win)
 
     if (isicon &&
 	(Scr->WarpCursor ||
-	 LookInList(Scr->WarpCursorL, tmp_win->full_name, &tmp_win->class)))
+	 tmp_win->policy.warp_cursor))
       WarpToWindow (tmp_win, 0);
 
     /* now de-iconify any window group transients */
@@ -4647,14 +5053,7 @@ void Iconify(TwmWindow *tmp_win, int def_x, int def_y)
     SetMapStateProp(tmp_win, IconicState);
 
     if ((Scr->IconifyStyle != ICONIFY_NORMAL) && !Scr->WindowMask) {
-      switch (Scr->IconifyStyle) {
-        case ICONIFY_MOSAIC:  MosaicFade    (tmp_win, blanket); break;
-        case ICONIFY_ZOOMIN:  ZoomInWindow  (tmp_win, blanket); break;
-        case ICONIFY_ZOOMOUT: ZoomOutWindow (tmp_win, blanket); break;
-	case ICONIFY_FADE:    FadeWindow    (tmp_win, blanket); break;
-	case ICONIFY_SWEEP:   SweepWindow   (tmp_win, blanket); break;
-      }
-      XDestroyWindow (dpy, blanket);
+      StartIconifyEffect (tmp_win, blanket);
     }
     if (tmp_win == Scr->Focus) {
 	SetFocus ((TwmWindow *) NULL, LastTimestamp());
@@ -4683,7 +5082,10 @@ void Iconify(TwmWindow *tmp_win, int def_x, int def_y)
 void AutoSqueeze (TwmWindow *tmp_win)
 {
     if (tmp_win->iconmgr) return;
-    if (Scr->RaiseWhenAutoUnSqueeze && tmp_win->squeezed) XRaiseWindow (dpy, tmp_win->frame);
+    if (Scr->RaiseWhenAutoUnSqueeze && tmp_win->squeezed) {
+	XRaiseWindow (dpy, tmp_win->frame);
+	StackRaised (tmp_win);
+    }
     Squeeze (tmp_win);
 }
 
@@ -5336,6 +5738,9 @@ static void send_clientmessage (Window w, Atom a, Time timestamp)
 static void SendDeleteWindowMessage (TwmWindow *tmp, Time timestamp)
 {
     send_clientmessage (tmp->w, _XA_WM_DELETE_WINDOW, timestamp);
+#ifdef EWMH
+    TwmSendWMPing (tmp, timestamp);
+#endif
 }
 
 void SendEndAnimationMessage (Window w, Time timestamp)
@@ -5470,187 +5875,208 @@ void DisplayPosition (TwmWindow *tmp_win, int x, int y)
 			Scr->SizeFont.ascent + SIZE_VINDENT , str, 13);
 }
 
-static void MosaicFade (TwmWindow *tmp_win, Window blanket)
-{
-    int		srect;
-    int		i, j, nrects;
+/*
+ * Iconify effects.  The frame is unmapped at once and a blanket window
+ * left in its place; the effect then animates the blanket one frame per
+ * timer tick and destroys it at the end.  Nothing waits for it, so every
+ * other client keeps being served while it runs.  The frame geometry is
+ * copied at the start: the window may be gone long before the effect.
+ */
+#define EFFECT_INTERVAL		20	/* milliseconds between frames */
+#define FADE_INTERVAL		100	/* milliseconds the fade is shown */
+
+typedef struct IconifyEffect {
+    int		style;			/* ICONIFY_* */
+    Window	blanket;
+    int		step, nsteps;
+    int		x, y, width, height;	/* of the frame */
     Pixmap	mask;
-    GC		gc;
-    XGCValues	gcv;
-    XRectangle *rectangles;
-    int  width = tmp_win->frame_width;
-    int height = tmp_win->frame_height;
-
-    srect = (width < height) ? (width / 20) : (height / 20);
-    mask  = XCreatePixmap (dpy, blanket, width, height, 1);
-
-    gcv.foreground = 1;
-    gc = XCreateGC (dpy, mask, GCForeground, &gcv);
-    XFillRectangle (dpy, mask, gc, 0, 0, width, height);
-    gcv.function = GXclear;
-    XChangeGC (dpy, gc, GCFunction, &gcv);
-
-    nrects = ((width * height) / (srect * srect)) / 10;
-    rectangles = (XRectangle*) malloc (nrects * sizeof (XRectangle));
-    for (j = 0; j < nrects; j++) {
-	rectangles [j].width  = srect;
-	rectangles [j].height = srect;
-    }
-    for (i = 0; i < 10; i++) {
-	for (j = 0; j < nrects; j++) {
-	    rectangles [j].x = ((lrand48 () %  width) / srect) * srect;
-	    rectangles [j].y = ((lrand48 () % height) / srect) * srect;
-	}
-	XFillRectangles (dpy, mask, gc, rectangles, nrects);
-	XShapeCombineMask (dpy, blanket, ShapeBounding, 0, 0, mask, ShapeSet);
-	XFlush (dpy);
-	waitamoment (0.020);
-    }
-    XFreePixmap (dpy, mask);
-    XFreeGC (dpy, gc);
-    free (rectangles);
-}
+    GC		gc, gcn;
+    XRectangle	*rectangles;		/* ICONIFY_MOSAIC */
+    int		nrects, srect;		/* ICONIFY_MOSAIC */
+    int		zstep;			/* ICONIFY_ZOOMIN, ICONIFY_ZOOMOUT */
+    int		dir;			/* ICONIFY_SWEEP */
+    float	sstep;			/* ICONIFY_SWEEP */
+} IconifyEffect;
 
-static void ZoomInWindow (TwmWindow *tmp_win, Window blanket)
-{
-  Pixmap	mask;
-  GC		gc, gcn;
-  XGCValues	gcv;
-
-  int i, nsteps = 20;
-  int w = tmp_win->frame_width;
-  int h = tmp_win->frame_height;
-  int step = (MAX (w, h)) / (2.0 * nsteps);
-
-  mask = XCreatePixmap (dpy, blanket, w, h, 1);
-  gcv.foreground = 1;
-  gc  = XCreateGC (dpy, mask, GCForeground, &gcv);
-  gcv.function = GXclear;
-  gcn = XCreateGC (dpy, mask, GCForeground | GCFunction, &gcv);
-
-  for (i = 0; i < nsteps; i++) {
-    XFillRectangle (dpy, mask, gcn, 0, 0, w, h);
-    XFillArc (dpy, mask, gc, (w / 2) - ((nsteps - i) * step),
-	                     (h / 2) - ((nsteps - i) * step),
-	                     2 * (nsteps - i) * step,
-	                     2 * (nsteps - i) * step,
-	                     0, 360*64);
-    XShapeCombineMask (dpy, blanket, ShapeBounding, 0, 0, mask, ShapeSet);
-    XFlush (dpy);
-    waitamoment (0.020);
-  }
-}
+static void IconifyEffectStep (void *closure);
 
-static void ZoomOutWindow (TwmWindow *tmp_win, Window blanket)
+static void StartIconifyEffect (TwmWindow *tmp_win, Window blanket)
 {
-  Pixmap	mask;
-  GC		gc;
-  XGCValues	gcv;
-
-  int i, nsteps = 20;
-  int w = tmp_win->frame_width;
-  int h = tmp_win->frame_height;
-  int step = (MAX (w, h)) / (2.0 * nsteps);
-
-  mask  = XCreatePixmap (dpy, blanket, w, h, 1);
-  gcv.foreground = 1;
-  gc = XCreateGC (dpy, mask, GCForeground, &gcv);
-  XFillRectangle (dpy, mask, gc, 0, 0, w, h);
-  gcv.function = GXclear;
-  XChangeGC (dpy, gc, GCFunction, &gcv);
-
-  for (i = 0; i < nsteps; i++) {
-    XFillArc (dpy, mask, gc, (w / 2) - (i * step),
-	                     (h / 2) - (i * step),
-	                     2 * i * step,
-	                     2 * i * step,
-	                     0, 360*64);
-    XShapeCombineMask (dpy, blanket, ShapeBounding, 0, 0, mask, ShapeSet);
-    XFlush (dpy);
-    waitamoment (0.020);
-  }
-}
+    IconifyEffect *e;
+    XGCValues gcv;
+    int j, dist, dist1;
+    static unsigned char stipple_bits[] = { 0x0F, 0x0F,
+					    0xF0, 0xF0,
+					    0x0F, 0x0F,
+					    0xF0, 0xF0,
+					    0x0F, 0x0F,
+					    0xF0, 0xF0,
+					    0x0F, 0x0F,
+					    0xF0, 0xF0,
+    };
+
+    e = (IconifyEffect *) calloc (1, sizeof (IconifyEffect));
+    if (e == NULL) {
+	XDestroyWindow (dpy, blanket);
+	return;
+    }
+    e->style   = Scr->IconifyStyle;
+    e->blanket = blanket;
+    e->x       = tmp_win->frame_x;
+    e->y       = tmp_win->frame_y;
+    e->width   = tmp_win->frame_width;
+    e->height  = tmp_win->frame_height;
+
+    switch (e->style) {
+      case ICONIFY_MOSAIC:
+	e->nsteps = 10;
+	e->srect = (e->width < e->height) ? (e->width / 20) : (e->height / 20);
+	if (e->srect < 1) e->srect = 1;
+	e->mask = XCreatePixmap (dpy, blanket, e->width, e->height, 1);
+	gcv.foreground = 1;
+	e->gc = XCreateGC (dpy, e->mask, GCForeground, &gcv);
+	XFillRectangle (dpy, e->mask, e->gc, 0, 0, e->width, e->height);
+	gcv.function = GXclear;
+	XChangeGC (dpy, e->gc, GCFunction, &gcv);
+	e->nrects = ((e->width * e->height) / (e->srect * e->srect)) / 10;
+	e->rectangles = (XRectangle*) malloc (e->nrects * sizeof (XRectangle));
+	if (e->rectangles == NULL) e->nrects = 0;
+	for (j = 0; j < e->nrects; j++) {
+	    e->rectangles [j].width  = e->srect;
+	    e->rectangles [j].height = e->srect;
+	}
+	break;
 
-void FadeWindow (TwmWindow *tmp_win, Window blanket)
-{
-  Pixmap	mask, stipple;
-  GC		gc;
-  XGCValues	gcv;
-  static unsigned char stipple_bits[] = { 0x0F, 0x0F,
-					  0xF0, 0xF0,
-					  0x0F, 0x0F,
-					  0xF0, 0xF0,
-					  0x0F, 0x0F,
-					  0xF0, 0xF0,
-					  0x0F, 0x0F,
-					  0xF0, 0xF0,
-  };
-  int w = tmp_win->frame_width;
-  int h = tmp_win->frame_height;
-
-  stipple = XCreateBitmapFromData (dpy, blanket, (char *)stipple_bits, 8, 8);
-  mask    = XCreatePixmap (dpy, blanket, w, h, 1);
-  gcv.background = 0;
-  gcv.foreground = 1;
-  gcv.stipple    = stipple;
-  gcv.fill_style = FillOpaqueStippled;
-  gc = XCreateGC (dpy, mask, GCBackground | GCForeground | GCFillStyle | GCStipple, &gcv);
-  XFillRectangle (dpy, mask, gc, 0, 0, w, h);
-
-  XShapeCombineMask (dpy, blanket, ShapeBounding, 0, 0, mask, ShapeSet);
-  XFlush (dpy);
-  waitamoment (0.10);
-  XFreePixmap (dpy, stipple);
-  XFlush (dpy);
+      case ICONIFY_ZOOMIN:
+	e->nsteps = 20;
+	e->zstep = (MAX (e->width, e->height)) / (2.0 * e->nsteps);
+	e->mask = XCreatePixmap (dpy, blanket, e->width, e->height, 1);
+	gcv.foreground = 1;
+	e->gc  = XCreateGC (dpy, e->mask, GCForeground, &gcv);
+	gcv.function = GXclear;
+	e->gcn = XCreateGC (dpy, e->mask, GCForeground | GCFunction, &gcv);
+	break;
+
+      case ICONIFY_ZOOMOUT:
+	e->nsteps = 20;
+	e->zstep = (MAX (e->width, e->height)) / (2.0 * e->nsteps);
+	e->mask = XCreatePixmap (dpy, blanket, e->width, e->height, 1);
+	gcv.foreground = 1;
+	e->gc = XCreateGC (dpy, e->mask, GCForeground, &gcv);
+	XFillRectangle (dpy, e->mask, e->gc, 0, 0, e->width, e->height);
+	gcv.function = GXclear;
+	XChangeGC (dpy, e->gc, GCFunction, &gcv);
+	break;
+
+      case ICONIFY_FADE:
+	e->nsteps = 1;
+	e->mask = XCreatePixmap (dpy, blanket, e->width, e->height, 1);
+	gcv.background = 0;
+	gcv.foreground = 1;
+	gcv.stipple    = XCreateBitmapFromData (dpy, blanket,
+						(char *)stipple_bits, 8, 8);
+	gcv.fill_style = FillOpaqueStippled;
+	e->gc = XCreateGC (dpy, e->mask,
+			   GCBackground | GCForeground | GCFillStyle | GCStipple,
+			   &gcv);
+	XFreePixmap (dpy, gcv.stipple);
+	break;
+
+      case ICONIFY_SWEEP:
+	e->nsteps = 20;
+	dist = e->x;
+	dist1 = e->y;
+	if (dist1 < dist) { e->dir = 1; dist = dist1; }
+	dist1 = tmp_win->vs->w - (e->x + e->width);
+	if (dist1 < dist) { e->dir = 2; dist = dist1; }
+	dist1 = tmp_win->vs->h - (e->y + e->height);
+	if (dist1 < dist) { e->dir = 3; dist = dist1; }
+
+	switch (e->dir) {
+	  case 0: e->sstep = e->x + e->width;              break;
+	  case 1: e->sstep = e->y + e->height;             break;
+	  case 2: e->sstep = tmp_win->vs->w - e->x;        break;
+	  case 3: e->sstep = tmp_win->vs->h - e->y;        break;
+	}
+	e->sstep /= (float) e->nsteps;
+	e->sstep /= (float) e->nsteps;
+	break;
+    }
+    IconifyEffectStep ((void *) e);
 }
 
-static void SweepWindow (TwmWindow *tmp_win, Window	blanket)
+static void EndIconifyEffect (IconifyEffect *e)
 {
-  float step = 0.0;
-  int i, nsteps = 20;
-  int dir = 0, dist = tmp_win->frame_x, dist1;
-
-  dist1 = tmp_win->frame_y;
-  if (dist1 < dist) { dir = 1; dist = dist1; }
-  dist1 = tmp_win->vs->w - (tmp_win->frame_x + tmp_win->frame_width);
-  if (dist1 < dist) { dir = 2; dist = dist1; }
-  dist1 = tmp_win->vs->h - (tmp_win->frame_y + tmp_win->frame_height);
-  if (dist1 < dist) { dir = 3; dist = dist1; }
-
-  switch (dir) {
-    case 0: step = tmp_win->frame_x + tmp_win->frame_width;  break;
-    case 1: step = tmp_win->frame_y + tmp_win->frame_height; break;
-    case 2: step = tmp_win->vs->w - tmp_win->frame_x;        break;
-    case 3: step = tmp_win->vs->h - tmp_win->frame_y;        break;
-  }
-  step /= (float) nsteps;
-  step /= (float) nsteps;
-  for (i = 0; i < 20; i++) {
-    int x = tmp_win->frame_x;
-    int y = tmp_win->frame_y;
-    switch (dir) {
-      case 0: x -= i * i * step; break;
-      case 1: y -= i * i * step; break;
-      case 2: x += i * i * step; break;
-      case 3: y += i * i * step; break;
-    }
-    XMoveWindow (dpy, blanket, x, y);
+    XDestroyWindow (dpy, e->blanket);
+    if (e->mask != None) XFreePixmap (dpy, e->mask);
+    if (e->gc   != None) XFreeGC (dpy, e->gc);
+    if (e->gcn  != None) XFreeGC (dpy, e->gcn);
+    free (e->rectangles);
+    free (e);
     XFlush (dpy);
-    waitamoment (0.020);
-  }
 }
 
-static void waitamoment (float timeout)
+static void IconifyEffectStep (void *closure)
 {
-#ifdef VMS
-  lib$wait (&timeout);
-#else
-  struct timeval timeoutstruct;
-  int usec = timeout * 1000000;
-  timeoutstruct.tv_usec = usec % (unsigned long) 1000000;
-  timeoutstruct.tv_sec  = usec / (unsigned long) 1000000;
-  select (0, (void *) 0, (void *) 0, (void *) 0, &timeoutstruct);
-#endif
+    IconifyEffect *e = (IconifyEffect *) closure;
+    int i = e->step, j, w = e->width, h = e->height, n = e->nsteps;
+    int x, y;
+
+    if (i >= n) {
+	EndIconifyEffect (e);
+	return;
+    }
+    switch (e->style) {
+      case ICONIFY_MOSAIC:
+	for (j = 0; j < e->nrects; j++) {
+	    e->rectangles [j].x = ((lrand48 () % w) / e->srect) * e->srect;
+	    e->rectangles [j].y = ((lrand48 () % h) / e->srect) * e->srect;
+	}
+	XFillRectangles (dpy, e->mask, e->gc, e->rectangles, e->nrects);
+	XShapeCombineMask (dpy, e->blanket, ShapeBounding, 0, 0, e->mask, ShapeSet);
+	break;
+
+      case ICONIFY_ZOOMIN:
+	XFillRectangle (dpy, e->mask, e->gcn, 0, 0, w, h);
+	XFillArc (dpy, e->mask, e->gc, (w / 2) - ((n - i) * e->zstep),
+				       (h / 2) - ((n - i) * e->zstep),
+				       2 * (n - i) * e->zstep,
+				       2 * (n - i) * e->zstep,
+				       0, 360*64);
+	XShapeCombineMask (dpy, e->blanket, ShapeBounding, 0, 0, e->mask, ShapeSet);
+	break;
+
+      case ICONIFY_ZOOMOUT:
+	XFillArc (dpy, e->mask, e->gc, (w / 2) - (i * e->zstep),
+				       (h / 2) - (i * e->zstep),
+				       2 * i * e->zstep,
+				       2 * i * e->zstep,
+				       0, 360*64);
+	XShapeCombineMask (dpy, e->blanket, ShapeBounding, 0, 0, e->mask, ShapeSet);
+	break;
+
+      case ICONIFY_FADE:
+	XFillRectangle (dpy, e->mask, e->gc, 0, 0, w, h);
+	XShapeCombineMask (dpy, e->blanket, ShapeBounding, 0, 0, e->mask, ShapeSet);
+	break;
+
+      case ICONIFY_SWEEP:
+	x = e->x;
+	y = e->y;
+	switch (e->dir) {
+	  case 0: x -= i * i * e->sstep; break;
+	  case 1: y -= i * i * e->sstep; break;
+	  case 2: x += i * i * e->sstep; break;
+	  case 3: y += i * i * e->sstep; break;
+	}
+	XMoveWindow (dpy, e->blanket, x, y);
+	break;
+    }
+    XFlush (dpy);
+    e->step++;
+    TimerSet (IconifyEffectStep, closure,
+	      (e->style == ICONIFY_FADE) ? FADE_INTERVAL : EFFECT_INTERVAL);
 }
 
 static void packwindow (TwmWindow *tmp_win, char *direction)
@@ -5692,6 +6118,7 @@ static void packwindow (TwmWindow *tmp_win, char *direction)
     py = y - tmp_win->frame_y + newy;
     XWarpPointer (dpy, Scr->Root, Scr->Root, 0, 0, 0, 0, px, py);
     XRaiseWindow(dpy, tmp_win->frame);
+    StackRaised(tmp_win);
     XMoveWindow (dpy, tmp_win->frame, newx, newy);
     SetupWindow (tmp_win, newx, newy, tmp_win->frame_width, tmp_win->frame_height, -1);
 }
@@ -5853,33 +6280,50 @@ static void jump (TwmWindow *tmp_win, int  direction, char *action)
     }
     /* Pebl Fixme: don't warp if jump happens through iconmgr */
     XWarpPointer (dpy, Scr->Root, Scr->Root, 0, 0, 0, 0, fx + px, fy + py);
-    if (!Scr->NoRaiseMove)
+    if (!Scr->NoRaiseMove) {
         XRaiseWindow (dpy, tmp_win->frame);
+        StackRaised (tmp_win);
+    }
     SetupWindow (tmp_win, fx, fy, tmp_win->frame_width, tmp_win->frame_height, -1);
 }
 
 int FindConstraint (TwmWindow *tmp_win, int direction)
 {
-    TwmWindow	*t;
-    int		w, h;
+    TwmWindow	*t, **wins;
+    int		w, h, i, n;
     int		winx = tmp_win->frame_x;
     int		winy = tmp_win->frame_y;
     int		winw = tmp_win->frame_width  + 2 * tmp_win->frame_bw;
     int		winh = tmp_win->frame_height + 2 * tmp_win->frame_bw;
     int 	ret;
 
+    /*
+     * Only the windows between the frame and the border in the given
+     * direction can stop it.
+     */
     switch (direction) {
 	case J_LEFT   : if (winx < Scr->BorderLeft) return -1;
-			ret = Scr->BorderLeft; break;
+			ret = Scr->BorderLeft;
+			wins = SpatialQuery (ret, winy, winx - ret, winh, &n);
+			break;
 	case J_RIGHT  : if (winx + winw > Scr->rootw - Scr->BorderRight) return -1;
-			ret = Scr->rootw - Scr->BorderRight; break;
+			ret = Scr->rootw - Scr->BorderRight;
+			wins = SpatialQuery (winx + winw, winy,
+					     ret - winx - winw, winh, &n);
+			break;
 	case J_TOP    : if (winy < Scr->BorderTop) return -1;
-			ret = Scr->BorderTop; break;
+			ret = Scr->BorderTop;
+			wins = SpatialQuery (winx, ret, winw, winy - ret, &n);
+			break;
 	case J_BOTTOM : if (winy + winh > Scr->rooth - Scr->BorderBottom) return -1;
-			ret = Scr->rooth - Scr->BorderBottom; break;
+			ret = Scr->rooth - Scr->BorderBottom;
+			wins = SpatialQuery (winx, winy + winh,
+					     winw, ret - winy - winh, &n);
+			break;
 	default       : return -1;
     }
-    for (t = Scr->FirstWindow; t != NULL; t = t->next) {
+    for (i = 0; i < n; i++) {
+	t = wins [i];
 	if (t == tmp_win) continue;
 	if (!visible (t)) continue;
 	if (!t->mapped) continue;
@@ -5913,20 +6357,42 @@ int FindConstraint (TwmWindow *tmp_win, int direction)
 		break;
 	}
     }
+    free (wins);
     return ret;
 }
 
 void TryToPack (TwmWindow *tmp_win, int *x, int *y)
 {
-    TwmWindow	*t;
-    int		newx, newy;
-    int		w, h;
+    TwmWindow	*t, **wins, **seen, **more;
+    int		newx, newy, lastx, lasty;
+    int		w, h, i, j, n, nseen;
     int		winw = tmp_win->frame_width  + 2 * tmp_win->frame_bw;
     int		winh = tmp_win->frame_height + 2 * tmp_win->frame_bw;
 
-    newx = *x;
-    newy = *y;
-    for (t = Scr->FirstWindow; t != NULL; t = t->next) {
+    newx  = *x;
+    newy  = *y;
+    seen  = NULL;
+    nseen = 0;
+    /*
+     * Packing against a window can move us over windows we were not
+     * overlapping yet, so look around the new position again until it
+     * settles, packing against each window at most once.
+     */
+    do {
+      lastx = newx;
+      lasty = newy;
+      wins  = SpatialQuery (newx, newy, winw, winh, &n);
+      if (n == 0) break;
+      more = (TwmWindow**) realloc (seen, (nseen + n) * sizeof (TwmWindow*));
+      if (more == NULL) {
+	free (wins);
+	break;
+      }
+      seen = more;
+      for (i = 0; i < n; i++) {
+	t = wins [i];
+	for (j = 0; j < nseen; j++) if (seen [j] == t) break;
+	if (j < nseen) continue;
 	if (t == tmp_win) continue;
 	if (t->winbox != tmp_win->winbox) continue;
 	if (t->vs != tmp_win->vs) continue;
@@ -5939,6 +6405,7 @@ void TryToPack (TwmWindow *tmp_win, int *x, int *y)
 	if (newx + winw <= t->frame_x) continue;
 	if (newy + winh <= t->frame_y) continue;
 
+	seen [nseen++] = t;
 	if (newx + Scr->MovePackResistance > t->frame_x + w) { /* left */
 	    newx = MAX (newx, t->frame_x + w);
 	    continue;
@@ -5955,21 +6422,26 @@ void TryToPack (TwmWindow *tmp_win, int *x, int *y)
 	    newy = MIN (newy, t->frame_y - winh);
 	    continue;
 	}
-    }
+      }
+      free (wins);
+    } while (newx != lastx || newy != lasty);
+    free (seen);
     *x = newx;
     *y = newy;
 }
 
 void TryToPush (TwmWindow *tmp_win, int x, int y, int dir)
 {
-    TwmWindow	*t;
+    TwmWindow	*t, **wins;
     int		newx, newy, ndir;
     Boolean	move;
-    int		w, h;
+    int		w, h, i, n;
     int		winw = tmp_win->frame_width  + 2 * tmp_win->frame_bw;
     int		winh = tmp_win->frame_height + 2 * tmp_win->frame_bw;
 
-    for (t = Scr->FirstWindow; t != NULL; t = t->next) {
+    wins = SpatialQuery (x, y, winw, winh, &n);
+    for (i = 0; i < n; i++) {
+	t = wins [i];
 	if (t == tmp_win) continue;
 	if (t->winbox != tmp_win->winbox) continue;
 	if (t->vs != tmp_win->vs) continue;
@@ -6023,6 +6495,7 @@ void TryToPush (TwmWindow *tmp_win, int x, int y, int dir)
 	    SetupWindow (t, newx, newy, t->frame_width, t->frame_height, -1);
 	}
     }
+    free (wins);
 }
 
 void TryToGrid (TwmWindow *tmp_win, int *x, int *y)
@@ -142,6 +142,7 @@ struct MouseButton
 struct FuncButton
 {
     struct FuncButton *next;	/* next in the list of function buttons */
+    struct FuncButton *hnext;	/* next in the same FuncButtonHash bucket */
     int num;			/* button number */
     int cont;			/* context */
     int mods;			/* modifiers */
@@ -153,6 +154,7 @@ struct FuncButton
 struct FuncKey
 {
     struct FuncKey *next;	/* next in the list of function keys */
+    struct FuncKey *hnext;	/* next in the same FuncKeyHash bucket */
     char *name;			/* key name */
     KeySym keysym;		/* X keysym */
     KeyCode keycode;		/* X keycode */
@@ -162,8 +164,20 @@ struct FuncKey
     char *win_name;		/* window name (if any) */
     char *action;		/* action string (if any) */
     MenuRoot *menu;		/* menu if func is F_MENU */
+    Bool rootgrab;		/* grabbed on the root window only */
 };
 
+/*
+ * The bindings are also hashed, keys on their keycode and modifiers and
+ * buttons on their number, context and modifiers.  Each bucket keeps the
+ * order of the binding list.
+ */
+#define BINDING_HASH_SIZE	256
+#define KEY_HASH(keycode, mods) \
+	(((keycode) ^ ((mods) * 37)) & (BINDING_HASH_SIZE - 1))
+#define BUTTON_HASH(num, cont, mods) \
+	(((num) ^ ((cont) << 3) ^ ((mods) * 37)) & (BINDING_HASH_SIZE - 1))
+
 extern int RootFunction;
 extern MenuRoot *ActiveMenu;
 extern MenuItem *ActiveItem;
@@ -209,6 +223,7 @@ extern void MakeWorkspacesMenu (void);
 extern MenuRoot *FindMenuRoot(char *name);
 extern Bool AddFuncKey(char *name, int cont, int mods, int func,
 		       MenuRoot *menu, char *win_name, char *action);
+extern void HashFuncKeys(void);
 extern Bool AddFuncButton(int num, int cont, int mods, int func,
 			  MenuRoot *menu, MenuItem *item);
 extern void PopDownMenu(void);
@@ -233,6 +248,14 @@ extern void SendEndAnimationMessage (Window w, Time timestamp);
 extern void SendTakeFocusMessage (TwmWindow *tmp, Time timestamp);
 extern void ModifyCurrentTB(int button, int mods, int func, char *action,
 			    MenuRoot *menuroot);
+extern void StackAddWindow(TwmWindow *tmp_win, Window parent);
+extern void StackRemoveWindow(TwmWindow *tmp_win);
+extern void StackRaised(TwmWindow *tmp_win);
+extern void StackReparented(TwmWindow *tmp_win, Window parent);
+extern void StackConfigured(TwmWindow *tmp_win, unsigned int mask,
+			    XWindowChanges *xwc);
+extern void StackInvalidate(ScreenInfo *scr);
+extern TwmWindow *StackBottomWindow(ScreenInfo *scr);
 extern void RaiseWindow(TwmWindow *tmp_win);
 extern void RaiseIcon(Window icon, short ontop);
 extern void LowerWindow(TwmWindow *tmp_win);
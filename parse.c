@@ -87,6 +87,7 @@
 #include "etwm.h"
 #include "screen.h"
 #include "menus.h"
+#include "events.h"
 #include "util.h"
 #include "gram.h"
 #include "parse.h"
@@ -339,7 +340,11 @@ int ParseTwmrc (char *filename)
 		     ProgramName, filename, cp);
 	}
 #ifdef USEM4
-	if (GoThroughM4) twmrc = start_m4(raw);
+	if (GoThroughM4) {
+	    ProfileBegin ("start_m4");
+	    twmrc = start_m4(raw);
+	    ProfileEnd ();
+	}
 	status = doparse (m4twmFileInput, "file", cp);
 	wait (0);
 	fclose (twmrc);
@@ -625,6 +630,11 @@ typedef struct _TwmKeyword {
 #define kw0_NoWarpToMenuTitle           65
 #define kw0_SaveWorkspaceFocus          66 /* blais */
 #define kw0_RaiseOnWarp			67
+#define kw0_CompressMotion		68
+#define kw0_EventStatistics		69
+#define kw0_SmartPlacement		70
+#define kw0_FlatWorkSpaceMap		71
+#define kw0_KillUnresponsiveClients	72
 
 #define kws_UsePPosition		1
 #define kws_IconFont			2
@@ -647,6 +657,7 @@ typedef struct _TwmKeyword {
 #define kws_WMgrButtonStyle		17
 #define kws_WorkSpaceFont               18
 #define kws_IconifyStyle                19
+#define kws_ImageCacheDirectory		20
 
 #define kwss_RandomPlacement		1
 
@@ -688,6 +699,7 @@ typedef struct _TwmKeyword {
 #define kwn_BorderLeft			35
 #define kwn_BorderRight			36
 #define kwn_SwitchWorkspacesOrdered	37
+#define kwn_ImageCacheSize		38
 
 #define kwcl_BorderColor		1
 #define kwcl_IconManagerHighlight	2
@@ -752,6 +764,7 @@ static TwmKeyword keytable[] = {
     { "clicktofocus",		KEYWORD, kw0_ClickToFocus },
     { "clientborderwidth",	KEYWORD, kw0_ClientBorderWidth },
     { "color",			COLOR, 0 },
+    { "compressmotion",		KEYWORD, kw0_CompressMotion },
     { "constrainedmovetime",	NKEYWORD, kwn_ConstrainedMoveTime },
     { "control",		CONTROL, 0 },
     { "cursors",		CURSORS, 0 },
@@ -771,6 +784,7 @@ static TwmKeyword keytable[] = {
     { "donttoggleworkspacemanagerstate", DONTTOGGLEWORKSPACEMANAGERSTATE, 0 },
     { "dontwarpcursorinwmap",	KEYWORD, kw0_DontWarpCursorInWMap },
     { "east",			DKEYWORD, D_EAST },
+    { "eventstatistics",	KEYWORD, kw0_EventStatistics },
     { "f",			FRAME, 0 },
     { "f.addtoworkspace",	FSKEYWORD, F_ADDTOWORKSPACE },
     { "f.adoptwindow",		FKEYWORD, F_ADOPTWINDOW },
@@ -795,6 +809,7 @@ static TwmKeyword keytable[] = {
     { "f.destroy",		FKEYWORD, F_DESTROY },
     { "f.downiconmgr",		FKEYWORD, F_DOWNICONMGR },
     { "f.downworkspace",	FKEYWORD, F_DOWNWORKSPACE },
+    { "f.dumpstats",		FKEYWORD, F_DUMPSTATS },
     { "f.exec",			FSKEYWORD, F_EXEC },
     { "f.file",			FSKEYWORD, F_FILE },
     { "f.fill",			FSKEYWORD, F_FILL },
@@ -902,6 +917,7 @@ static TwmKeyword keytable[] = {
     { "f.warptoscreen",		FSKEYWORD, F_WARPTOSCREEN },
     { "f.winrefresh",		FKEYWORD, F_WINREFRESH },
     { "f.zoom",			FKEYWORD, F_ZOOM },
+    { "flatworkspacemap",	KEYWORD, kw0_FlatWorkSpaceMap },
     { "forceicons",		KEYWORD, kw0_ForceIcons },
     { "frame",			FRAME, 0 },
     { "framepadding",		NKEYWORD, kwn_FramePadding },
@@ -937,7 +953,10 @@ static TwmKeyword keytable[] = {
     { "ignorelockmodifier",	KEYWORD, kw0_IgnoreLockModifier },
     { "ignoremodifier",		IGNOREMODIFIER, 0 },
     { "ignoretransient",	IGNORE_TRANSIENT, 0 },
+    { "imagecachedirectory",	SKEYWORD, kws_ImageCacheDirectory },
+    { "imagecachesize",		NKEYWORD, kwn_ImageCacheSize },
     { "interpolatemenucolors",	KEYWORD, kw0_InterpolateMenuColors },
+    { "killunresponsiveclients",	KEYWORD, kw0_KillUnresponsiveClients },
     { "l",			LOCK, 0 },
     { "left",			JKEYWORD, J_LEFT },
     { "lefttitlebutton",	LEFT_TITLEBUTTON, 0 },
@@ -1027,6 +1046,7 @@ static TwmKeyword keytable[] = {
     { "showworkspacemanager",	KEYWORD, kw0_ShowWorkspaceManager },
     { "shrinkicontitles",	KEYWORD, kw0_ShrinkIconTitles },
     { "sloppyfocus",            KEYWORD, kw0_SloppyFocus },
+    { "smartplacement",		KEYWORD, kw0_SmartPlacement },
     { "sorticonmanager",	KEYWORD, kw0_SortIconManager },
 #ifdef SOUNDS
     { "soundhost",		SKEYWORD, kws_SoundHost },
@@ -1380,6 +1400,26 @@ int do_single_keyword (int keyword)
 	Scr->NoWarpToMenuTitle = TRUE;
 	return 1;
 
+      case kw0_CompressMotion:
+	Scr->CompressMotion = TRUE;
+	return 1;
+
+      case kw0_EventStatistics:
+	EventStatistics = True;
+	return 1;
+
+      case kw0_SmartPlacement:
+	Scr->SmartPlacement = TRUE;
+	return 1;
+
+      case kw0_FlatWorkSpaceMap:
+	Scr->FlatWorkSpaceMap = TRUE;
+	return 1;
+
+      case kw0_KillUnresponsiveClients:
+	Scr->KillUnresponsiveClients = TRUE;
+	return 1;
+
     }
     return 0;
 }
@@ -1474,6 +1514,16 @@ int do_string_keyword (int keyword, char *s)
 	if (Scr->FirstTime) Scr->PixmapDirectory = ExpandFilePath (s);
 	return 1;
 
+      case kws_ImageCacheDirectory:
+	if (Scr->workSpaceMgr.workSpaceList != NULL) {
+	    /* their images were loaded while the WorkSpaces were parsed */
+	    twmrc_error_prefix();
+	    fprintf (stderr,
+		     "ImageCacheDirectory after WorkSpaces is not used for workspace images\n");
+	}
+	if (Scr->FirstTime) Scr->ImageCacheDirectory = ImageCacheDirectory (s);
+	return 1;
+
       case kws_MaxWindowSize:
 	JunkMask = XParseGeometry (s, &JunkX, &JunkY, &JunkWidth, &JunkHeight);
 	if ((JunkMask & (WidthValue | HeightValue)) != 
@@ -1767,6 +1817,11 @@ int do_number_keyword (int keyword, int num)
 	Scr->workSpaceMgr.switchWorkspacesOrdered  = num;
 	return 1;
 
+      case kwn_ImageCacheSize:
+	if (num < 0) num = 0;
+	Scr->ImageCacheSize = num * 1024;
+	return 1;
+
 
     }
 
@@ -101,6 +101,7 @@ static int last_width;
 static int last_height;
 
 static unsigned int resizeGrabMask;
+static Bool resizePending;		/* a size waits for the client */
 
 static void DisplaySize (TwmWindow *tmp_win, int width, int height);
 
@@ -176,8 +177,9 @@ void StartResize(XEvent *evp, TwmWindow *tmp_win,
     cursor = (Scr->BorderCursors && tmp_win->curcurs) ? tmp_win->curcurs : Scr->ResizeCursor;
     ResizeWindow = tmp_win->frame;
     if (! Scr->OpaqueResize || resizeWhenAdd) XGrabServer(dpy);
-    resizeGrabMask = ButtonPressMask | ButtonReleaseMask |
-			ButtonMotionMask | PointerMotionHintMask;
+    resizeGrabMask = ButtonPressMask | ButtonReleaseMask | ButtonMotionMask;
+    /* hints need an XQueryPointer to get the next motion event */
+    if (! Scr->CompressMotion) resizeGrabMask |= PointerMotionHintMask;
 
     grabwin = Scr->Root;
     if (tmp_win->winbox) grabwin = tmp_win->winbox->window;
@@ -284,6 +286,32 @@ void AddStartResize(TwmWindow *tmp_win, int x, int y, int w, int h)
 }
 
 
+/*
+ * Give the window being resized its new size, unless it has not yet
+ * caught up with the last one: then it gets the latest size when it does
+ * (ResizeSyncDone), with the next motion, or at the end of the resize.
+ */
+static void OpaqueResizeFrame (TwmWindow *tmp_win)
+{
+#ifdef EWMH
+    if (TwmSyncRequestPending (tmp_win)) {
+	resizePending = True;
+	return;
+    }
+    /* the client only answers when its size changes */
+    if (dragWidth != tmp_win->frame_width || dragHeight != tmp_win->frame_height)
+	TwmSendSyncRequest (tmp_win);
+#endif
+    resizePending = False;
+    SetupWindow (tmp_win, dragx - tmp_win->frame_bw, dragy - tmp_win->frame_bw,
+		 dragWidth, dragHeight, -1);
+}
+
+void ResizeSyncDone (TwmWindow *tmp_win)
+{
+    if (resizePending && ResizeWindow == tmp_win->frame)
+	OpaqueResizeFrame (tmp_win);
+}
 
 void MenuDoResize(int x_root, int y_root, TwmWindow *tmp_win)
 {
@@ -525,8 +553,7 @@ void DoResize(int x_root, int y_root, TwmWindow *tmp_win)
         if (clampTop)
             dragy = origy + origHeight - dragHeight;
 	if (Scr->OpaqueResize && ! resizeWhenAdd)
-	    SetupWindow (tmp_win, dragx - tmp_win->frame_bw, dragy - tmp_win->frame_bw,
-		 dragWidth, dragHeight, -1);
+	    OpaqueResizeFrame (tmp_win);
 	else
           MoveOutline(Scr->Root,
             dragx - tmp_win->frame_bw,
@@ -625,6 +652,7 @@ void EndResize(void)
     MoveOutline(Scr->Root, 0, 0, 0, 0, 0, 0);
     XUnmapWindow(dpy, Scr->SizeWindow);
 
+    resizePending = False;
     tmp_win = GetTwmWindow(ResizeWindow);
     if (!tmp_win) return;
 
@@ -995,6 +1023,7 @@ void SetupFrame (TwmWindow *tmp_win, int x, int y, int w, int h, int bw,
     frame_wc.height = tmp_win->frame_height = h;
     frame_mask |= (CWX | CWY | CWWidth | CWHeight);
     XConfigureWindow (dpy, tmp_win->frame, frame_mask, &frame_wc);
+    SpatialUpdate (tmp_win);
 
     XMoveResizeWindow (dpy, tmp_win->w, tmp_win->frame_bw3D,
 			tmp_win->title_height + tmp_win->frame_bw3D,
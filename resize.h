@@ -71,6 +71,7 @@ extern void AddStartResize(TwmWindow *tmp_win, int x, int y, int w, int h);
 extern void MenuDoResize(int x_root, int y_root, TwmWindow *tmp_win);
 extern void DoResize(int x_root, int y_root, TwmWindow *tmp_win);
 extern void EndResize(void);
+extern void ResizeSyncDone(TwmWindow *tmp_win);
 extern void MenuEndResize(TwmWindow *tmp_win);
 extern void AddEndResize(TwmWindow *tmp_win);
 extern void SetupWindow(TwmWindow *tmp_win,
@@ -108,6 +108,8 @@ struct StdCmap {
 #define SIZE_HINDENT 10
 #define SIZE_VINDENT 2
 
+#define MAXSTACKLAYERS 32	/* ontoppriority values kept apart */
+
 struct TitlebarPixmaps {
     Pixmap xlogo;
     Pixmap resize;
@@ -136,6 +138,12 @@ struct ScreenInfo
     int MaxWindowHeight;	/* ditto */
 
     TwmWindow *FirstWindow;	/* the head of the twm window list */
+    struct SpatialIndex *Spatial;	/* frames by position, see util.c */
+    TwmWindow *StackBottom;	/* the frames from bottom ... */
+    TwmWindow *StackTop;	/* ... to top of the stacking order */
+    TwmWindow *StackLayerBottom [MAXSTACKLAYERS];	/* the same, per */
+    TwmWindow *StackLayerTop [MAXSTACKLAYERS];		/* ontoppriority */
+    Bool StackDirty;		/* stacking order must be asked to the server */
     Colormaps RootColormaps;	/* the colormaps of the root window */
 
     Window Root;		/* the root window: the current virtual screen */
@@ -174,8 +182,10 @@ struct ScreenInfo
     XRRCrtcInfo **crtc;		/* XRANDR crtc array */
     int crtcs;			/* number of ctrcs */
 #endif				/* USE_XRANDR */
+    long FrameInterval;		/* microseconds between refreshes */
 
     Window ManagerWindow;	/* the WM_S%d selection owner window */
+    long RootEventMask;		/* the events selected on Root */
     Window SizeWindow;		/* the resize dimensions window */
     Window InfoWindow;		/* the information window */
     Window WindowMask;		/* the window masking the screen at startup */
@@ -186,7 +196,8 @@ struct ScreenInfo
     Colormap WelcomeCmap;
     Visual  *WelcomeVisual;
 
-    name_list *ImageCache;	/* list of pixmaps */
+    ImageCache *ImageCache;	/* pixmaps loaded by GetImage */
+    int ImageCacheSize;		/* bytes of unused pixmaps to keep around */
     TitlebarPixmaps tbpm;	/* titlebar pixmaps */
     Image *UnknownImage;	/* the unknown icon pixmap */
     Pixmap siconifyPm;		/* the icon manager iconify pixmap */
@@ -314,6 +325,8 @@ struct ScreenInfo
 #define ICON_MGR_OBORDER \
     (Scr->use3Diconmanagers ? Scr->IconManagerShadowDepth : 2)
     short	ReallyMoveInWorkspaceManager;
+    short	FlatWorkSpaceMap;	/* draw the map, no window per client */
+    short	KillUnresponsiveClients; /* kill on unanswered _NET_WM_PING */
     short	ShowWinWhenMovingInWmgr;
     short	ReverseCurrentWorkspace;
     short	DontWarpCursorInWMap;
@@ -369,6 +382,7 @@ struct ScreenInfo
     name_list *OpaqueResizeList;
     name_list *NoOpaqueResizeList;
     name_list *IconMenuDontShow;
+    name_list_set *PolicyLists;	/* all boolean lists, see GetWindowPolicy */
 
     GC NormalGC;		/* normal GC for everything */
     GC MenuGC;			/* gc for menus */
@@ -392,6 +406,7 @@ struct ScreenInfo
     WindowBox *FirstWindowBox;	/* pointer to window boxes list */
     char *IconDirectory;	/* icon directory to search */
     char *PixmapDirectory;	/* Pixmap directory to search */
+    char *ImageCacheDirectory;	/* where to keep decoded images */
     int SizeStringOffset;	/* x offset in size window for drawing */
     int SizeStringWidth;	/* minimum width of size window */
     int BorderWidth;		/* border width of twm windows */
@@ -420,6 +435,7 @@ struct ScreenInfo
     short WarpCursor;		/* warp cursor on de-iconify ? */
     short ForceIcon;		/* force the icon to the user specified */
     short NoGrabServer;		/* don't do server grabs */
+    short CompressMotion;	/* take motion from events, not the server */
     short NoRaiseMove;		/* don't raise window following move */
     short NoRaiseResize;	/* don't raise window following resize */
     short NoRaiseDeicon;	/* don't raise window on deiconify */
@@ -445,6 +461,7 @@ struct ScreenInfo
     short RandomPlacement;	/* randomly place windows that no give hints */
     short RandomDisplacementX;	/* randomly displace by this much horizontally */
     short RandomDisplacementY;	/* randomly displace by this much vertically */
+    short SmartPlacement;	/* place windows where they overlap the least */
     short OpaqueMove;		/* move the window rather than outline */
     short DoOpaqueMove;		/* move the window rather than outline */
     short OpaqueMoveThreshold;		/*  */
@@ -487,6 +504,8 @@ struct ScreenInfo
 
     FuncKey FuncKeyRoot;
     FuncButton FuncButtonRoot;
+    FuncKey *FuncKeyHash [BINDING_HASH_SIZE];
+    FuncButton *FuncButtonHash [BINDING_HASH_SIZE];
 
     Bool showingDesktop;
 #ifdef GNOME
@@ -129,6 +129,7 @@
 #include "icons.h"
 #include "screen.h"
 #include "session.h"
+#include "util.h"
 
 SmcConn smcConn = NULL;
 XtInputId iceInputId;
@@ -157,7 +158,7 @@ char *GetClientID (Window window)
     unsigned long bytes_after;
     unsigned char *prop = NULL;
 
-    if (XGetWindowProperty (dpy, window, _XA_WM_CLIENT_LEADER,
+    if (TwmGetWindowProperty (dpy, window, _XA_WM_CLIENT_LEADER,
 	0L, 1L, False, AnyPropertyType,	&actual_type, &actual_format,
 	&nitems, &bytes_after, &prop) == Success)
     {
@@ -189,7 +190,7 @@ char *GetWindowRole (Window window)
 {
     XTextProperty tp;
 
-    if (XGetTextProperty (dpy, window, &tp, _XA_WM_WINDOW_ROLE))
+    if (TwmGetTextProperty (dpy, window, &tp, _XA_WM_WINDOW_ROLE))
     {
 	if (tp.encoding == XA_STRING && tp.format == 8 && tp.nitems != 0)
 	    return ((char *) tp.value);
@@ -81,6 +81,7 @@
 #include <X11/Intrinsic.h>
 #include <X11/cursorfont.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/sync.h>
 #include <X11/Xfuncs.h>
 #endif	/* VMS */
 #include "types.h"
@@ -170,6 +171,12 @@ typedef SIGNAL_T (*SigProc)(int); /* type of function returned by signal() */
 #define MOD_SIZE	((ShiftMask | ControlMask | Mod1Mask \
 			  | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask) + 1)
 
+/* the events selected on every client window, see AddWindow */
+#define CLIENT_EVENT_MASK	(StructureNotifyMask | PropertyChangeMask |\
+				 ColormapChangeMask | VisibilityChangeMask |\
+				 FocusChangeMask |\
+				 EnterWindowMask | LeaveWindowMask)
+
 #define TITLE_BAR_SPACE         1	/* 2 pixel space bordering chars */
 #define TITLE_BAR_FONT_HEIGHT   15	/* max of 15 pixel high chars */
 #define TITLE_BAR_HEIGHT        (TITLE_BAR_FONT_HEIGHT+(2*TITLE_BAR_SPACE))
@@ -364,10 +371,60 @@ union WindowDecorations {
 /* for each window that is on the display, one of these structures
  * is allocated and linked into a list 
  */
+/*
+ * Membership of a window in the boolean name lists of the screen.  It is
+ * evaluated once by GetWindowPolicy() when the window is managed, and
+ * again only when WM_NAME, WM_ICON_NAME or WM_CLASS change, so that the
+ * event handlers never have to walk the lists themselves.
+ */
+struct WindowPolicy
+{
+    unsigned ignore_transient : 1;	/* IgnoreTransient */
+    unsigned no_highlight : 1;		/* NoHighlight */
+    unsigned no_stack_mode : 1;		/* NoStackMode */
+    unsigned always_on_top : 1;		/* AlwaysOnTop */
+    unsigned no_title_highlight : 1;	/* NoTitleHighlight */
+    unsigned auto_raise : 1;		/* AutoRaise */
+    unsigned auto_lower : 1;		/* AutoLower */
+    unsigned dont_iconify : 1;		/* DontIconifyByUnmapping */
+    unsigned iconify_by_unmapping : 1;	/* IconifyByUnmapping */
+    unsigned unmap_by_moving_far_away : 1;	/* UnmapByMovingFarAway */
+    unsigned dont_set_inactive : 1;	/* DontSetInactive */
+    unsigned auto_squeeze : 1;		/* AutoSqueeze */
+    unsigned start_squeezed : 1;	/* StartSqueezed */
+    unsigned always_squeeze_to_gravity : 1;	/* AlwaysSqueezeToGravity */
+    unsigned window_ring : 1;		/* WindowRing */
+    unsigned window_ring_exclude : 1;	/* WindowRingExclude */
+    unsigned dont_squeeze_title : 1;	/* DontSqueezeTitle */
+    unsigned no_border : 1;		/* NoBorder */
+    unsigned make_title : 1;		/* MakeTitle */
+    unsigned no_title : 1;		/* NoTitle */
+    unsigned opaque_move : 1;		/* OpaqueMove */
+    unsigned no_opaque_move : 1;	/* NoOpaqueMove */
+    unsigned opaque_resize : 1;		/* OpaqueResize */
+    unsigned no_opaque_resize : 1;	/* NoOpaqueResize */
+    unsigned start_iconified : 1;	/* StartIconified */
+    unsigned no_icon_title : 1;		/* NoIconTitle, by name or class */
+    unsigned no_icon_title_icon : 1;	/* NoIconTitle, by icon name */
+    unsigned warp_on_deiconify : 1;	/* WarpOnDeIconify */
+    unsigned warp_cursor : 1;		/* WarpCursor */
+    unsigned icon_mgr_no_show : 1;	/* IconManagerDontShow */
+    unsigned icon_mgr_show : 1;		/* IconManagerShow */
+    unsigned icon_menu_dont_show : 1;	/* IconMenuDontShow */
+    unsigned occupy_all : 1;		/* OccupyAll */
+};
+
 struct TwmWindow
 {
     struct TwmWindow *next;	/* next twm window */
     struct TwmWindow *prev;	/* previous twm window */
+    struct TwmWindow *stack_above;	/* next frame up in stacking order */
+    struct TwmWindow *stack_below;	/* next frame down in stacking order */
+    struct TwmWindow *layer_above;	/* same, within the stacking layer */
+    struct TwmWindow *layer_below;
+    unsigned long stack_rank;	/* grows from bottom to top */
+    short stack_layer;		/* layer the frame is filed under */
+    Window stack_parent;	/* parent of the frame */
     Window w;			/* the child window */
     int old_bw;			/* border width before reparenting */
     Window frame;		/* the frame window */
@@ -390,6 +447,9 @@ struct TwmWindow
     int actual_frame_y;		/* save frame_x of frame when squeezed */
     unsigned int actual_frame_width;  /* save width of frame when squeezed */
     unsigned int actual_frame_height; /* save height of frame when squeezed */
+    struct SpatialIndex *sindex;	/* spatial index the frame is filed in */
+    short scell [4];		/* cells it covers: left, top, right, bottom */
+    unsigned long sstamp;	/* last spatial query that returned it */
     int title_x;
     int title_y;
     unsigned int title_height;	/* height of the title bar */
@@ -462,6 +522,10 @@ struct TwmWindow
     short DontSetInactive;
     Bool hasfocusvisible;	/* The window has visivle focus*/
     int  occupation;
+    struct winList *wmapentries;	/* its entries in the workspace maps */
+    long eventmask;			/* events we selected on w */
+    struct TwmWindow *wmapnext;	/* next window whose entries moved */
+    Bool wmappending;		/* on the list of moved windows */
     Image *HiliteImage;                /* focus highlight window background */
     Image *LoliteImage;                /* focus lowlight window background */
     WindowRegion *wr;
@@ -475,6 +539,7 @@ struct TwmWindow
     struct VirtualScreen *old_parent_vs;
     struct VirtualScreen *savevs;
 
+    WindowPolicy policy;	/* name lists this window belongs to */
     Bool nameChanged;	/* did WM_NAME ever change? */
     /* did the user ever change the width/height? {yes, no, or unknown} */
     Bool widthEverChangedByUser;
@@ -576,6 +641,8 @@ extern XtAppContext appContext;
 extern Window ResizeWindow;	/* the window we are resizing */
 extern int HasShape;		/* this server supports Shape extension */
 extern int ShapeEventBase, ShapeErrorBase;
+extern int HasSync;		/* this server supports Sync extension */
+extern int SyncEventBase, SyncErrorBase;
 
 extern int PreviousScreen;
 
@@ -647,6 +714,7 @@ extern Atom _XA_WM_CURRENTWORKSPACE;
 extern Atom _XA_WM_NOREDIRECT;
 extern Atom _XA_WM_OCCUPATION;
 extern Atom _XA_WM_ETWM_VSCREENMAP;
+extern Atom _XA_WM_ETWM_EVENT_STATS;
 extern Atom _XA_MANAGER;
 extern Atom _OL_WIN_ATTR;
 extern Atom _XA_KDE_WM_CHANGE_STATE;
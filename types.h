@@ -45,6 +45,7 @@ typedef struct IconMgr IconMgr;
 
 /* From list.h */
 typedef struct name_list name_list;
+typedef struct name_list_set name_list_set;
 
 /* From screen.h */
 typedef struct StdCmap StdCmap;
@@ -65,10 +66,12 @@ typedef struct WindowRegion WindowRegion;
 typedef struct WindowEntry WindowEntry;
 typedef struct WindowBox WindowBox;
 typedef struct TwmWindow TwmWindow;
+typedef struct WindowPolicy WindowPolicy;
 typedef struct TWMWinConfigEntry TWMWinConfigEntry;
 
 /* From util.h */
 typedef struct Image Image;
+typedef struct ImageCache ImageCache;
 
 /* From vscreen.h */
 typedef struct VirtualScreen VirtualScreen;
@@ -84,6 +84,7 @@
 #include "screen.h"
 #include "icons.h"
 #include "cursor.h"
+#include "version.h"
 #include <stdio.h>
 #ifdef VMS
 #include <decw$include/Xos.h>
@@ -133,6 +134,11 @@
 #include <signal.h>
 #ifndef VMS
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef USE_XCB
+#include <X11/Xlib-xcb.h>
 #endif
 
 #if defined (XPM)
@@ -156,6 +162,16 @@
   };
 
   typedef struct jpeg_error *jerr_ptr;
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# ifdef USE_THREADS
+#  include <pthread.h>
+  static void WaitForDecodedImage (char *name);
+  static Bool QueueDecodeJob (char *name, Image **imagep,
+			      void (*notify) (void *closure), void *closure);
+# endif
 #endif /* JPEG */
 
 #ifdef IMCONV
@@ -209,16 +225,17 @@ static int    reportfilenotfound = 1;
 static Colormap AlternateCmap = None;
 
 int  HotX, HotY;
+#if !defined(JPEG) || !defined(USE_THREADS)
+int  DecodePipe = -1;
+#endif
 
 int  Animating        = 0;
 int  AnimationSpeed   = 0;
 Bool AnimationActive  = False;
 Bool MaybeAnimate     = True;
-#ifdef USE_SIGNALS
+#ifdef VMS
    Bool AnimationPending = False;
-#else
-   struct timeval AnimateTimeout;
-#endif /* USE_SIGNALS */
+#endif /* VMS */
 
 /***********************************************************************
  *
@@ -354,20 +371,66 @@ void MoveOutline(Window root,
 /***********************************************************************
  *
  *  Procedure:
- *	Zoom - zoom in or out of an icon
+ *	ZoomIt - zoom an outline from one rectangle to another
  *
- *  Inputs:
- *	wf	- window to zoom from
- *	wt	- window to zoom to
+ *  The outline is a thin shaped window stepped through the ZoomCount
+ *  intermediate rectangles from a timer, so the zoom takes its time
+ *  without holding up the event loop; a window rather than XOR lines
+ *  means nothing is left behind when clients repaint under it.  When
+ *  the server lacks the Shape extension, the XOR rectangles are drawn
+ *  and undrawn in one go as they always were.
  *
  ***********************************************************************
  */
 
+#define ZOOM_INTERVAL	10		/* milliseconds between outlines */
+
+typedef struct ZoomOutline {
+    Window	w;
+    int		fx, fy;
+    long	fw, fh;
+    long	dx, dy, dw, dh;
+    long	i, z;
+} ZoomOutline;
+
+static void ZoomStep (void *closure)
+{
+    ZoomOutline *zs = (ZoomOutline *) closure;
+    XRectangle r [4];
+    int x, y;
+    unsigned width, height;
+
+    if (zs->i > zs->z) {
+	XDestroyWindow (dpy, zs->w);
+	XFlush (dpy);
+	free (zs);
+	return;
+    }
+    x      = zs->fx + (int) ((zs->dx * zs->i) / zs->z);
+    y      = zs->fy + (int) ((zs->dy * zs->i) / zs->z);
+    width  = (unsigned) (zs->fw + (zs->dw * zs->i) / zs->z) + 1;
+    height = (unsigned) (zs->fh + (zs->dh * zs->i) / zs->z) + 1;
+
+    r [0].x = 0;          r [0].y = 0;           r [0].width = width; r [0].height = 1;
+    r [1].x = 0;          r [1].y = height - 1;  r [1].width = width; r [1].height = 1;
+    r [2].x = 0;          r [2].y = 0;           r [2].width = 1;     r [2].height = height;
+    r [3].x = width - 1;  r [3].y = 0;           r [3].width = 1;     r [3].height = height;
+    XShapeCombineRectangles (dpy, zs->w, ShapeBounding, 0, 0, r, 4,
+			     ShapeSet, Unsorted);
+    XMoveResizeWindow (dpy, zs->w, x, y, width, height);
+    if (zs->i == 0) XMapRaised (dpy, zs->w);
+    XFlush (dpy);
+    zs->i++;
+    TimerSet (ZoomStep, closure, ZOOM_INTERVAL);
+}
+
 void ZoomIt(int fx, int fy , unsigned fw, unsigned fh, int tx, int ty, unsigned tw, unsigned th)
 {
     long dx, dy, dw, dh;
     long z;
     int j;
+    ZoomOutline *zs;
+    XSetWindowAttributes attr;
 
     dx = (long) tx - (long) fx;	/* going from -> to */
     dy = (long) ty - (long) fy;	/* going from -> to */
@@ -375,6 +438,29 @@ void ZoomIt(int fx, int fy , unsigned fw, unsigned fh, int tx, int ty, unsigned
     dh = (long) th - (long) fh;	/* going from -> to */
     z = (long) (Scr->ZoomCount + 1);
 
+    if (HasShape && (zs = (ZoomOutline *) malloc (sizeof (ZoomOutline))) != NULL) {
+	attr.override_redirect = True;
+	attr.save_under        = True;
+	attr.background_pixel  = Scr->DefaultC.fore;
+	zs->w  = XCreateWindow (dpy, Scr->Root, fx, fy, fw + 1, fh + 1, 0,
+				CopyFromParent, (unsigned int) CopyFromParent,
+				(Visual *) CopyFromParent,
+				CWOverrideRedirect | CWSaveUnder | CWBackPixel,
+				&attr);
+	zs->fx = fx;
+	zs->fy = fy;
+	zs->fw = fw;
+	zs->fh = fh;
+	zs->dx = dx;
+	zs->dy = dy;
+	zs->dw = dw;
+	zs->dh = dh;
+	zs->i  = 0;
+	zs->z  = z;
+	ZoomStep ((void *) zs);
+	return;
+    }
+
     for (j = 0; j < 2; j++) {
 	long i;
 
@@ -392,6 +478,18 @@ void ZoomIt(int fx, int fy , unsigned fw, unsigned fh, int tx, int ty, unsigned
     }
 }
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	Zoom - zoom in or out of an icon
+ *
+ *  Inputs:
+ *	wf	- window to zoom from
+ *	wt	- window to zoom to
+ *
+ ***********************************************************************
+ */
+
 void Zoom(Window wf, Window wt)
 {
     int fx, fy, tx, ty;			/* from, to */
@@ -631,6 +729,37 @@ char *ExpandFilePath (char *path)
     return ret;
 }
 
+/***********************************************************************
+ *
+ *  Procedure:
+ *	ImageCacheDirectory - get the directory for decoded images
+ *
+ *  Returned Value:
+ *	the expanded directory, $XDG_CACHE_HOME/etwm or ~/.cache/etwm
+ *	if dir is empty
+ *
+ *  Inputs:
+ *	dir	- the ImageCacheDirectory string
+ *
+ ***********************************************************************
+ */
+
+char *ImageCacheDirectory (char *dir)
+{
+    char *xdg, *ret;
+
+    if (*dir) return ExpandFilePath (dir);
+    xdg = getenv ("XDG_CACHE_HOME");
+    if (xdg && *xdg) {
+	ret = (char*) malloc (strlen (xdg) + 6);
+	sprintf (ret, "%s/etwm", xdg);
+    } else {
+	ret = (char*) malloc (HomeLen + 13);
+	sprintf (ret, "%s/.cache/etwm", Home);
+    }
+    return ret;
+}
+
 /***********************************************************************
  *
  *  Procedure:
@@ -1175,7 +1304,7 @@ void UnmaskScreen (void)
 	}
 	XFreeColors   (dpy, cmap, pixels, 256, 0L);
 	XFreeGC       (dpy, Scr->WelcomeGC);
-	FreeImage     (Scr->WelcomeImage);
+	ReleaseImage  (Scr->WelcomeImage);
     }
     if (Scr->Monochrome != COLOR) goto fin;
 
@@ -1327,96 +1456,91 @@ void AnimateHandler (void)
     status = sys$setimr (timefi, &tv, AnimateHandler, TIMID);
     if (status != SS$_NORMAL) lib$signal(status);
 }
-#else /* VMS */
 
-#ifdef USE_SIGNALS
-SIGNAL_T AnimateHandler ();
-#endif
+/*
+ * There is no select() on the display here: EtwmNextEvent waits on the
+ * animation event flag, so have the system timer set it again when the
+ * next TimerSet() deadline comes up (msec as returned by TimerNext).
+ */
+#define TIMERID 13L
 
-#ifndef USE_SIGNALS
-void TryToAnimate (void)
+static unsigned int timertv[2];
+
+static void TimerWakeHandler (void)
 {
-    struct timeval  tp;
-    struct timezone tzp;
-    static unsigned long lastsec;
-    static long lastusec;
-    unsigned long gap;
+    sys$setef(timefe);
+}
 
-    if (Animating > 1) return;	/* rate limiting */
+void TimerWake (long msec)
+{
+    sys$cantim(TIMERID, PSL$C_USER);
+    if (msec < 0) return;
 
-    gettimeofday (&tp, &tzp);
-    gap = ((tp.tv_sec - lastsec) * 1000000) + (tp.tv_usec - lastusec);
-    if (tracefile) {
-	fprintf (tracefile, "Time = %lu, %ld, %ld, %ld, %lu\n", lastsec,
-		lastusec, (long)tp.tv_sec, (long)tp.tv_usec, gap);
-	fflush (tracefile);
+    if (!timefi) lib$get_ef(&timefi);
+    if (!timefe) lib$get_ef(&timefe);
+    if (msec == 0) {
+	sys$setef(timefe);
+	return;
     }
-    gap *= AnimationSpeed;
-    if (gap < 1000000) return;
+    timertv[1] = 0xFFFFFFFF;		/* quadword negative for relative */
+    timertv[0] = -(msec * 10000);	/* time. In units of 100ns. */
+    status = sys$setimr (timefi, &timertv, TimerWakeHandler, TIMERID);
+    if (status != SS$_NORMAL) lib$signal(status);
+}
+#else /* VMS */
+
+/***********************************************************************
+ *
+ *  Animation is driven by a repeating timer on the timer wheel below.
+ *  The timer is only kept armed while something can actually animate
+ *  (MaybeAnimate), so an idle etwm does not wake up to find nothing
+ *  to do; EtwmNextEvent calls ScheduleAnimation before blocking.
+ *
+ ***********************************************************************
+ */
+
+static Bool AnimationArmed = False;
+
+static long AnimationInterval (void)
+{
+    if (AnimationSpeed <= 1) return (1000);
+    return (1000 / AnimationSpeed);
+}
+
+static void AnimateTimer (void *closure)
+{
+    AnimationArmed = False;
     if (tracefile) {
 	fprintf (tracefile, "Animate\n");
 	fflush (tracefile);
     }
     Animate ();
-    lastsec  = tp.tv_sec;
-    lastusec = tp.tv_usec;
+    ScheduleAnimation ();
 }
-#endif /* USE_SIGNALS */
 
-void StartAnimation (void)
+void ScheduleAnimation (void)
 {
-#ifdef USE_SIGNALS
-    struct itimerval tv;
-#endif
+    if (AnimationArmed || ! AnimationActive || ! MaybeAnimate) return;
+    if (AnimationSpeed <= 0) return;
+    TimerSet (AnimateTimer, NULL, AnimationInterval ());
+    AnimationArmed = True;
+}
 
+void StartAnimation (void)
+{
     if (AnimationSpeed > MAXANIMATIONSPEED) AnimationSpeed = MAXANIMATIONSPEED;
     if (AnimationSpeed <= 0) AnimationSpeed = 0;
     if (AnimationActive) return;
-#ifdef USE_SIGNALS
     if (AnimationSpeed == 0) return;
-    signal (SIGALRM, AnimateHandler);
-    if (AnimationSpeed == 1) {
-	tv.it_interval.tv_sec  = 1;
-	tv.it_interval.tv_usec = 0;
-	tv.it_value.tv_sec     = 1;
-	tv.it_value.tv_usec    = 0;
-    }
-    else {
-	tv.it_interval.tv_sec  = 0;
-	tv.it_interval.tv_usec = 1000000 / AnimationSpeed;
-	tv.it_value.tv_sec     = 0;
-	tv.it_value.tv_usec    = 1000000 / AnimationSpeed;
-    }
-    setitimer (ITIMER_REAL, &tv, (struct itimerval*) NULL);
-#else /* USE_SIGNALS */
-    switch (AnimationSpeed) {
-	case 0 :
-	    return;
-	case 1 :
-	    AnimateTimeout.tv_sec  = 1;
-	    AnimateTimeout.tv_usec = 0;
-	    break;
-	default :
-	    AnimateTimeout.tv_sec  = 0;
-	    AnimateTimeout.tv_usec = 1000000 / AnimationSpeed;
-    }
-#endif /* USE_SIGNALS */
     AnimationActive = True;
+    ScheduleAnimation ();
 }
 
 void StopAnimation (void)
 {
-#ifdef USE_SIGNALS
-    struct itimerval tv;
-
-    if (AnimationSpeed <= 0) return;
     if (! AnimationActive) return;
-    signal (SIGALRM, SIG_IGN);
-
-    tv.it_value.tv_sec     = 0;
-    tv.it_value.tv_usec    = 0;
-    setitimer (ITIMER_REAL, &tv, (struct itimerval*) NULL);
-#endif
+    TimerClear (AnimateTimer, NULL);
+    AnimationArmed  = False;
     AnimationActive = False;
 }
 
@@ -1428,10 +1552,6 @@ void SetAnimationSpeed (int speed)
 
 void ModifyAnimationSpeed (int incr)
 {
-#ifdef USE_SIGNALS
-    struct itimerval tv;
-#endif
-
     if ((AnimationSpeed + incr) < 0) return;
     if ((AnimationSpeed + incr) == 0) {
 	if (AnimationActive) StopAnimation ();
@@ -1441,41 +1561,12 @@ void ModifyAnimationSpeed (int incr)
     AnimationSpeed += incr;
     if (AnimationSpeed > MAXANIMATIONSPEED) AnimationSpeed = MAXANIMATIONSPEED;
 
-#ifdef USE_SIGNALS
-    signal (SIGALRM, AnimateHandler);
-    if (AnimationSpeed == 1) {
-	tv.it_interval.tv_sec  = 1;
-	tv.it_interval.tv_usec = 0;
-	tv.it_value.tv_sec     = 1;
-	tv.it_value.tv_usec    = 0;
-    }
-    else {
-	tv.it_interval.tv_sec  = 0;
-	tv.it_interval.tv_usec = 1000000 / AnimationSpeed;
-	tv.it_value.tv_sec     = 0;
-	tv.it_value.tv_usec    = 1000000 / AnimationSpeed;
-    }
-    setitimer (ITIMER_REAL, &tv, (struct itimerval*) NULL);
-#else /* USE_SIGNALS */
-    if (AnimationSpeed == 1) {
-	AnimateTimeout.tv_sec  = 1;
-	AnimateTimeout.tv_usec = 0;
-    }
-    else {
-	AnimateTimeout.tv_sec  = 0;
-	AnimateTimeout.tv_usec = 1000000 / AnimationSpeed;
-    }
-#endif /* USE_SIGNALS */
+    /* restart the timer with the new interval */
+    TimerClear (AnimateTimer, NULL);
+    AnimationArmed  = False;
     AnimationActive = True;
+    ScheduleAnimation ();
 }
-
-#ifdef USE_SIGNALS
-SIGNAL_T AnimateHandler (int dummy)
-{
-    signal (SIGALRM, AnimateHandler);
-    AnimationPending = True;
-}
-#endif
 #endif /* VMS */
 
 void Animate (void)
@@ -1489,7 +1580,7 @@ void Animate (void)
 
     if (AnimationSpeed == 0) return;
     if (Animating > 1) return;	/* rate limiting */
-#ifdef USE_SIGNALS
+#ifdef VMS
     AnimationPending = False;
 #endif
 
@@ -1534,6 +1625,408 @@ void Animate (void)
     return;
 }
 
+/***********************************************************************
+ *
+ *  Timers
+ *
+ *  Everything that has to happen at some later time (animation frames,
+ *  delayed auto-raise, _NET_WM_PING and startup notification timeouts,
+ *  effects) schedules a deadline here instead of polling or blocking.
+ *  EtwmNextEvent uses TimerNext to bound its select() and calls
+ *  TimerRun whenever the X queue is empty.
+ *
+ *  Pending timers hang off a hashed timing wheel of TIMER_SLOTS slots,
+ *  each TIMER_TICK milliseconds of the monotonic clock wide, so that
+ *  running the expired ones only looks at the slots the clock has
+ *  passed since the last run.  A timer is named by its (proc, closure)
+ *  pair: setting it again reschedules it and clearing it is harmless
+ *  when it is not pending.  Callbacks may set and clear timers freely.
+ *
+ ***********************************************************************
+ */
+
+#define TIMER_TICK	8		/* milliseconds per slot */
+#define TIMER_SLOTS	256		/* slots per revolution */
+
+typedef struct TwmTimer {
+    struct TwmTimer	*next;		/* same slot */
+    struct TwmTimer	**prev;
+    struct TwmTimer	*lnext;		/* all pending timers */
+    struct TwmTimer	**lprev;
+    unsigned long	deadline;	/* TimerNow () milliseconds */
+    TimerProc		proc;
+    void		*closure;
+} TwmTimer;
+
+static TwmTimer		*TimerWheel [TIMER_SLOTS];
+static TwmTimer		*TimerList = NULL;
+static unsigned long	TimerTick  = 0;		/* last tick run */
+
+unsigned long TimerNow (void)
+{
+    struct timeval tv;
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+	return ((unsigned long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+    gettimeofday (&tv, NULL);
+    return ((unsigned long) tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+/*
+ * The same clock, in microseconds, for measuring rather than scheduling.
+ */
+unsigned long TimerNowUsec (void)
+{
+    struct timeval tv;
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+	return ((unsigned long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+    gettimeofday (&tv, NULL);
+    return ((unsigned long) tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+static TwmTimer *TimerFind (TimerProc proc, void *closure)
+{
+    TwmTimer *t;
+
+    for (t = TimerList; t != NULL; t = t->lnext)
+	if (t->proc == proc && t->closure == closure) return (t);
+    return (NULL);
+}
+
+static void TimerUnlink (TwmTimer *t)
+{
+    if ((*t->prev = t->next) != NULL) t->next->prev = t->prev;
+    if ((*t->lprev = t->lnext) != NULL) t->lnext->lprev = t->lprev;
+}
+
+void TimerSet (TimerProc proc, void *closure, long msec)
+{
+    TwmTimer *t;
+    TwmTimer **slot;
+
+    if ((t = TimerFind (proc, closure)) != NULL) {
+	TimerUnlink (t);
+    } else {
+	t = (TwmTimer *) malloc (sizeof (TwmTimer));
+	if (t == NULL) {
+	    fprintf (stderr, "%s: unable to allocate %lu bytes for timer\n",
+		     ProgramName, (unsigned long) sizeof (TwmTimer));
+	    return;
+	}
+	t->proc    = proc;
+	t->closure = closure;
+    }
+    /* never due in the same TimerRun pass that set it */
+    if (msec < 1) msec = 1;
+    t->deadline = TimerNow () + msec;
+
+    slot = &TimerWheel [(t->deadline / TIMER_TICK) % TIMER_SLOTS];
+    if ((t->next = *slot) != NULL) t->next->prev = &t->next;
+    t->prev = slot;
+    *slot = t;
+    if ((t->lnext = TimerList) != NULL) t->lnext->lprev = &t->lnext;
+    t->lprev = &TimerList;
+    TimerList = t;
+}
+
+void TimerClear (TimerProc proc, void *closure)
+{
+    TwmTimer *t;
+
+    if ((t = TimerFind (proc, closure)) == NULL) return;
+    TimerUnlink (t);
+    free (t);
+}
+
+Bool TimerPending (TimerProc proc, void *closure)
+{
+    return (TimerFind (proc, closure) != NULL);
+}
+
+/*
+ * Milliseconds until the next deadline, 0 when one has already passed,
+ * or -1 when no timer is pending.  Timers more than a revolution away
+ * only bound the wait to one revolution.
+ */
+long TimerNext (void)
+{
+    unsigned long now, tick;
+    TwmTimer *t;
+    long wait, best;
+    int i;
+
+    if (TimerList == NULL) return (-1);
+    now  = TimerNow ();
+    tick = now / TIMER_TICK;
+    for (i = 0; i < TIMER_SLOTS; i++) {
+	best = -1;
+	for (t = TimerWheel [(tick + i) % TIMER_SLOTS]; t; t = t->next) {
+	    wait = (long) (t->deadline - now);
+	    if (wait <= 0) return (0);
+	    if (wait < (long) (i + 1) * TIMER_TICK && (best < 0 || wait < best))
+		best = wait;
+	}
+	if (best >= 0) return (best);
+    }
+    return ((long) TIMER_SLOTS * TIMER_TICK);
+}
+
+void TimerRun (void)
+{
+    unsigned long now, tick, n, i;
+    TwmTimer *t;
+    TimerProc proc;
+    void *closure;
+
+    if (TimerList == NULL) return;
+    now  = TimerNow ();
+    tick = now / TIMER_TICK;
+    n = tick - TimerTick + 1;
+    if (n > TIMER_SLOTS) n = TIMER_SLOTS;
+    for (i = 0; i < n; i++) {
+	TwmTimer **slot = &TimerWheel [(tick - i) % TIMER_SLOTS];
+again:
+	for (t = *slot; t != NULL; t = t->next) {
+	    if ((long) (t->deadline - now) > 0) continue;
+	    proc    = t->proc;
+	    closure = t->closure;
+	    TimerUnlink (t);
+	    free (t);
+	    (*proc) (closure);
+	    goto again;
+	}
+    }
+    TimerTick = tick;
+}
+
+/*
+ * Wait msec milliseconds, still running any timers that fall due in
+ * the meantime.  For effects that must pause between frames.
+ */
+void TimerSleep (long msec)
+{
+    unsigned long end = TimerNow () + msec;
+    struct timeval tv;
+    long wait, next;
+
+    while ((wait = (long) (end - TimerNow ())) > 0) {
+	next = TimerNext ();
+	if (next >= 0 && next < wait) wait = next;
+	tv.tv_sec  = wait / 1000;
+	tv.tv_usec = (wait % 1000) * 1000;
+	select (0, (void *) 0, (void *) 0, (void *) 0, &tv);
+	TimerRun ();
+    }
+}
+
+/***********************************************************************
+ *
+ *  Request accounting
+ *
+ *  CountRequests returns how many requests have been sent to the server
+ *  so far and how many of them were round trips, for callers to take
+ *  differences of.  Round trips are counted from Xlib's after function,
+ *  which Xlib calls at the end of every request: a request after which
+ *  Xlib has heard back about every request sent so far has waited for
+ *  the server.  The after function is only installed the first time
+ *  anyone asks.  Requests that etwm sends directly over XCB are not
+ *  counted.
+ *
+ ***********************************************************************
+ */
+
+static unsigned long	RoundTripCount = 0;
+static unsigned long	RoundTripKnown = 0;
+static Display		*CountDisplay  = NULL;
+static int		(*CountChained) (Display *display) = NULL;
+
+static int CountRoundTrip (Display *display)
+{
+    unsigned long known = LastKnownRequestProcessed (display);
+
+    if (known != RoundTripKnown) {
+	if (known + 1 == NextRequest (display)) RoundTripCount++;
+	RoundTripKnown = known;
+    }
+    return (CountChained ? (*CountChained) (display) : 0);
+}
+
+void CountRequests (unsigned long *requests, unsigned long *roundtrips)
+{
+    *requests   = 0;
+    *roundtrips = RoundTripCount;
+    if (dpy == NULL) return;
+    if (CountDisplay != dpy) {
+	CountDisplay   = dpy;
+	RoundTripKnown = LastKnownRequestProcessed (dpy);
+	CountChained   = XSetAfterFunction (dpy, CountRoundTrip);
+    }
+    *requests = NextRequest (dpy);
+}
+
+/***********************************************************************
+ *
+ *  Startup profile
+ *
+ *  With -profile file (or ETWM_PROFILE=file in the environment) etwm
+ *  times the phases of its startup, ProfileBegin to ProfileEnd, and
+ *  counts the protocol requests and the round trips each one made.
+ *  ProfileReport writes them out, as CSV if the file name ends in
+ *  ".csv" and as JSON otherwise, once etwm is ready to handle events.
+ *  A restart execs etwm anew with the same arguments and environment,
+ *  so it is profiled (and the report rewritten) the same way.
+ *
+ *  Phases nest; a phase begun several times (GetImage, say) is
+ *  reported once per screen with its total time and its call count.
+ *  Requests and round trips are counted by CountRequests.
+ *
+ ***********************************************************************
+ */
+
+#define MAXPROFILE	128
+#define MAXPROFILEDEPTH	16
+
+typedef struct ProfilePhase {
+    char		*name;
+    int			screen;		/* -1 before screens exist */
+    int			depth;
+    int			calls;
+    unsigned long	start;		/* microseconds since ProfileStart */
+    unsigned long	time;		/* microseconds, all calls */
+    unsigned long	requests;
+    unsigned long	roundtrips;
+} ProfilePhase;
+
+typedef struct ProfileFrame {
+    ProfilePhase	*phase;
+    unsigned long	start;
+    unsigned long	request;
+    unsigned long	roundtrips;
+} ProfileFrame;
+
+static char		*ProfileFile = NULL;
+static ProfilePhase	ProfileList [MAXPROFILE];
+static int		ProfileCount = 0;
+static ProfileFrame	ProfileStack [MAXPROFILEDEPTH];
+static int		ProfileDepth = 0;
+static unsigned long	ProfileOrigin;
+
+void ProfileStart (char *file)
+{
+    if (file == NULL || *file == '\0') return;
+    ProfileFile   = file;
+    ProfileOrigin = TimerNowUsec ();
+}
+
+void ProfileBegin (char *name)
+{
+    ProfilePhase *p = NULL;
+    ProfileFrame *f;
+    int screen = (Scr != NULL) ? Scr->screen : -1;
+    int i;
+
+    if (ProfileFile == NULL) return;
+    if (ProfileDepth == MAXPROFILEDEPTH) {
+	ProfileDepth++;		/* too deep: balanced by ProfileEnd */
+	return;
+    }
+    for (i = 0; i < ProfileCount; i++) {
+	if (ProfileList [i].screen == screen &&
+	    strcmp (ProfileList [i].name, name) == 0) {
+	    p = &ProfileList [i];
+	    break;
+	}
+    }
+    if (p == NULL && ProfileCount < MAXPROFILE) {
+	p = &ProfileList [ProfileCount++];
+	p->name       = name;
+	p->screen     = screen;
+	p->depth      = ProfileDepth;
+	p->calls      = 0;
+	p->start      = TimerNowUsec () - ProfileOrigin;
+	p->time       = 0;
+	p->requests   = 0;
+	p->roundtrips = 0;
+    }
+    f = &ProfileStack [ProfileDepth++];
+    f->phase = p;
+    CountRequests (&f->request, &f->roundtrips);
+    f->start = TimerNowUsec ();
+}
+
+void ProfileEnd (void)
+{
+    ProfileFrame *f;
+    ProfilePhase *p;
+    unsigned long request, roundtrips;
+
+    if (ProfileFile == NULL || ProfileDepth == 0) return;
+    if (ProfileDepth-- > MAXPROFILEDEPTH) return;
+    f = &ProfileStack [ProfileDepth];
+    if ((p = f->phase) == NULL) return;
+    CountRequests (&request, &roundtrips);
+    p->calls++;
+    p->time       += TimerNowUsec () - f->start;
+    p->requests   += request - f->request;
+    p->roundtrips += roundtrips - f->roundtrips;
+}
+
+void ProfileReport (void)
+{
+    FILE *file;
+    ProfilePhase *p;
+    unsigned long total, requests, roundtrips;
+    size_t len;
+    Bool csv;
+    int i;
+
+    if (ProfileFile == NULL) return;
+    total    = TimerNowUsec () - ProfileOrigin;
+    CountRequests (&requests, &roundtrips);
+    if ((file = fopen (ProfileFile, "w")) == NULL) {
+	fprintf (stderr, "%s: cannot write profile to \"%s\"\n",
+		 ProgramName, ProfileFile);
+	ProfileFile = NULL;
+	return;
+    }
+    len = strlen (ProfileFile);
+    csv = (len > 4 && strcmp (ProfileFile + len - 4, ".csv") == 0);
+
+    if (csv) {
+	fprintf (file, "phase,screen,depth,calls,start_us,time_us,requests,round_trips\n");
+	for (i = 0, p = ProfileList; i < ProfileCount; i++, p++)
+	    fprintf (file, "%s,%d,%d,%d,%lu,%lu,%lu,%lu\n",
+		     p->name, p->screen, p->depth, p->calls, p->start,
+		     p->time, p->requests, p->roundtrips);
+	fprintf (file, "total,-1,0,1,0,%lu,%lu,%lu\n",
+		 total, requests, roundtrips);
+    } else {
+	fprintf (file, "{\n  \"version\": \"%s\",\n  \"pid\": %ld,\n"
+		 "  \"time\": %ld,\n  \"total_us\": %lu,\n"
+		 "  \"requests\": %lu,\n  \"round_trips\": %lu,\n"
+		 "  \"phases\": [",
+		 VersionNumber, (long) getpid (), (long) time (NULL),
+		 total, requests, roundtrips);
+	for (i = 0, p = ProfileList; i < ProfileCount; i++, p++)
+	    fprintf (file, "%s\n    { \"phase\": \"%s\", \"screen\": %d, "
+		     "\"depth\": %d, \"calls\": %d, \"start_us\": %lu, "
+		     "\"time_us\": %lu, \"requests\": %lu, "
+		     "\"round_trips\": %lu }",
+		     i ? "," : "", p->name, p->screen, p->depth, p->calls,
+		     p->start, p->time, p->requests, p->roundtrips);
+	fprintf (file, "\n  ]\n}\n");
+    }
+    fclose (file);
+    ProfileFile = NULL;
+}
+
 void InsertRGBColormap (Atom a, XStandardColormap *maps, int nmaps,
 			Bool replace)
 {
@@ -1931,9 +2424,9 @@ void SetFocus (TwmWindow *tmp_win, Time	tim)
     }
     Scr->Focus = tmp_win;
 #ifdef EWMH
-    Upd_NET_ACTIVE_WINDOW(Scr);
+    Dfr_NET_ACTIVE_WINDOW(Scr);
     if (old_focus)
-	Upd_NET_WM_STATE(Scr, old_focus);
+	Dfr_NET_WM_STATE(Scr, old_focus);
 #endif				/* EWMH */
 #if 0
     /*
@@ -2948,7 +3441,7 @@ static void PaintAllDecoration (void)
 		!Scr->NoIconTitlebar    &&
 		tmp_win->icon           &&
 		tmp_win->icon->w        &&
-		! LookInList (Scr->NoIconTitle, tmp_win->full_name, &tmp_win->class)) {
+		! tmp_win->policy.no_icon_title) {
 	    PaintIcon (tmp_win);
 	}
     }
@@ -3412,34 +3905,201 @@ void SetBorderCursor (TwmWindow *tmp_win, int x, int y)
     tmp_win->curcurs = cursor;
 }
 
-Image *GetImage (char *name, ColorPair cp)
+/*
+ * Images loaded by GetImage are kept in a per screen hash table, keyed by
+ * their name, the colors they were built with and the screen depth.  Every
+ * GetImage takes a reference on the image, and ReleaseImage drops it.
+ * Unreferenced images stay in the table, on a least recently used list, as
+ * long as their pixmaps fit in ImageCacheSize bytes.
+ */
+#define IMAGE_CACHE_BUCKETS 256
+
+typedef struct ImageCacheEntry {
+    struct ImageCacheEntry *next;	/* hash chain, by name */
+    struct ImageCacheEntry *inext;	/* hash chain, by image */
+    struct ImageCacheEntry *lprev;	/* unreferenced entries, oldest first */
+    struct ImageCacheEntry *lnext;
+    char		*name;
+    Pixel		fore, back;
+    int			depth;
+    unsigned int	hash;
+    Image		*image;
+    int			refcount;
+    unsigned long	bytes;		/* server memory used by the pixmaps */
+} ImageCacheEntry;
+
+struct ImageCache {
+    ImageCacheEntry	*byname  [IMAGE_CACHE_BUCKETS];
+    ImageCacheEntry	*byimage [IMAGE_CACHE_BUCKETS];
+    ImageCacheEntry	*lru_head, *lru_tail;
+    unsigned long	unused_bytes;
+};
+
+static unsigned int ImageNameHash (char *name, Pixel fore, Pixel back, int depth)
 {
-    name_list **list;
-    char fullname [256];
-    Image *image;
+    unsigned int h = 5381;
 
-    if (name == NULL) return (None);
-    image = None;
+    while (*name) h = (h * 33) ^ (unsigned char) *name++;
+    h = (h * 33) ^ (unsigned int) fore;
+    h = (h * 33) ^ (unsigned int) back;
+    h = (h * 33) ^ (unsigned int) depth;
+    return (h);
+}
 
-    list = &Scr->ImageCache;
-#ifdef XPM
-    if ((name [0] == '@') || (strncmp (name, "xpm:", 4) == 0)) {
-	sprintf (fullname, "%s%dx%d", name, (int) cp.fore, (int) cp.back);
+static unsigned int ImagePointerHash (Image *image)
+{
+    return ((unsigned int) (((unsigned long) image) >> 4) % IMAGE_CACHE_BUCKETS);
+}
 
-	if ((image = (Image*) LookInNameList (*list, fullname)) == None) {
-	    int startn = (name [0] == '@') ? 1 : 4;
-	    if ((image = GetXpmImage (name + startn, cp)) != None) {
-	        AddToList (list, fullname, (char*) image);
-	    }
-	}
-    }
-    else
-#endif
+static unsigned long ImageBytes (Image *image)
+{
+    Image *im;
+    unsigned long bytes = 0;
+
+    im = image;
+    do {
+	bytes += (unsigned long) im->width * im->height * ((Scr->d_depth + 7) / 8);
+	if (im->mask) bytes += (unsigned long) ((im->width + 7) / 8) * im->height;
+	im = im->next;
+    } while ((im != None) && (im != image));
+    return (bytes);
+}
+
+static void LruRemove (ImageCache *ic, ImageCacheEntry *e)
+{
+    if (e->lprev) e->lprev->lnext = e->lnext; else ic->lru_head = e->lnext;
+    if (e->lnext) e->lnext->lprev = e->lprev; else ic->lru_tail = e->lprev;
+    e->lprev = e->lnext = NULL;
+    ic->unused_bytes -= e->bytes;
+}
+
+static void LruAppend (ImageCache *ic, ImageCacheEntry *e)
+{
+    e->lnext = NULL;
+    e->lprev = ic->lru_tail;
+    if (ic->lru_tail) ic->lru_tail->lnext = e; else ic->lru_head = e;
+    ic->lru_tail = e;
+    ic->unused_bytes += e->bytes;
+}
+
+static void EvictImages (ImageCache *ic)
+{
+    ImageCacheEntry *e, **pe;
+
+    while (ic->lru_head && (ic->unused_bytes > (unsigned long) Scr->ImageCacheSize)) {
+	e = ic->lru_head;
+	LruRemove (ic, e);
+	for (pe = &ic->byname [e->hash % IMAGE_CACHE_BUCKETS]; *pe; pe = &(*pe)->next)
+	    if (*pe == e) { *pe = e->next; break; }
+	for (pe = &ic->byimage [ImagePointerHash (e->image)]; *pe; pe = &(*pe)->inext)
+	    if (*pe == e) { *pe = e->inext; break; }
+	FreeImage (e->image);
+	free (e->name);
+	free ((char*) e);
+    }
+}
+
+static Image *LookupImage (char *name, Pixel fore, Pixel back)
+{
+    ImageCache *ic = Scr->ImageCache;
+    ImageCacheEntry *e;
+    unsigned int h;
+
+    if (ic == NULL) return (None);
+    h = ImageNameHash (name, fore, back, Scr->d_depth);
+    for (e = ic->byname [h % IMAGE_CACHE_BUCKETS]; e != NULL; e = e->next) {
+	if ((e->hash == h) && (e->fore == fore) && (e->back == back) &&
+	    (e->depth == Scr->d_depth) && (strcmp (e->name, name) == 0)) {
+	    if (e->refcount++ == 0) LruRemove (ic, e);
+	    return (e->image);
+	}
+    }
+    return (None);
+}
+
+static void CacheImage (char *name, Pixel fore, Pixel back, Image *image)
+{
+    ImageCache *ic;
+    ImageCacheEntry *e;
+    unsigned int i;
+
+    if (image == None) return;
+    if (Scr->ImageCache == NULL) {
+	Scr->ImageCache = (ImageCache*) calloc (1, sizeof (ImageCache));
+	if (Scr->ImageCache == NULL) return;
+    }
+    ic = Scr->ImageCache;
+    e = (ImageCacheEntry*) calloc (1, sizeof (ImageCacheEntry));
+    if (e == NULL) return;
+    e->name     = strdup (name);
+    e->fore     = fore;
+    e->back     = back;
+    e->depth    = Scr->d_depth;
+    e->hash     = ImageNameHash (name, fore, back, Scr->d_depth);
+    e->image    = image;
+    e->refcount = 1;
+    e->bytes    = ImageBytes (image);
+
+    e->next = ic->byname [e->hash % IMAGE_CACHE_BUCKETS];
+    ic->byname [e->hash % IMAGE_CACHE_BUCKETS] = e;
+    i = ImagePointerHash (image);
+    e->inext = ic->byimage [i];
+    ic->byimage [i] = e;
+}
+
+/*
+ * Drop a reference taken by GetImage.  The image may be any frame of an
+ * animation, since the users of animated images step through them.
+ * Images which do not come from GetImage are ignored.
+ */
+void ReleaseImage (Image *image)
+{
+    ImageCache *ic = Scr->ImageCache;
+    ImageCacheEntry *e;
+    Image *im;
+
+    if ((image == None) || (ic == NULL)) return;
+    im = image;
+    do {
+	for (e = ic->byimage [ImagePointerHash (im)]; e != NULL; e = e->inext) {
+	    if (e->image == im) {
+		if ((e->refcount > 0) && (--e->refcount == 0)) {
+		    LruAppend (ic, e);
+		    EvictImages (ic);
+		}
+		return;
+	    }
+	}
+	im = im->next;
+    } while ((im != None) && (im != image));
+}
+
+static Image *FetchImage (char *name, ColorPair cp)
+{
+    Image *image;
+
+    if (name == NULL) return (None);
+    image = None;
+
+#ifdef XPM
+    if ((name [0] == '@') || (strncmp (name, "xpm:", 4) == 0)) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
+	    int startn = (name [0] == '@') ? 1 : 4;
+	    if ((image = GetXpmImage (name + startn, cp)) != None) {
+	        CacheImage (name, cp.fore, cp.back, image);
+	    }
+	}
+    }
+    else
+#endif
 #ifdef JPEG
     if (strncmp (name, "jpeg:", 5) == 0) {
-	if ((image = (Image*) LookInNameList (*list, name)) == None) {
+#ifdef USE_THREADS
+	WaitForDecodedImage (name);
+#endif
+	if ((image = LookupImage (name, 0, 0)) == None) {
 	    if ((image = GetJpegImage (&name [5])) != None) {
-		AddToList (list, name, (char*) image);
+		CacheImage (name, 0, 0, image);
 	    }
 	}
     }
@@ -3447,9 +4107,9 @@ Image *GetImage (char *name, ColorPair cp)
 #endif
 #ifdef IMCONV
     if (strncmp (name, "im:", 3) == 0) {
-	if ((image = (Image*) LookInNameList (*list, name)) == None) {
+	if ((image = LookupImage (name, 0, 0)) == None) {
 	    if ((image = GetImconvImage (&name [3])) != None) {
-		AddToList (list, name, (char*) image);
+		CacheImage (name, 0, 0, image);
 	    }
 	}
     }
@@ -3458,9 +4118,9 @@ Image *GetImage (char *name, ColorPair cp)
 #if !defined(VMS) || defined(HAVE_XWDFILE_H)
     if ((strncmp (name, "xwd:", 4) == 0) || (name [0] == '|')) {
 	int startn = (name [0] == '|') ? 0 : 4;
-	if ((image = (Image*) LookInNameList (*list, name)) == None) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
 	    if ((image = GetXwdImage (&name [startn], cp)) != None) {
-		AddToList (list, name, (char*) image);
+		CacheImage (name, cp.fore, cp.back, image);
 	    }
 	}
     }
@@ -3484,8 +4144,7 @@ Image *GetImage (char *name, ColorPair cp)
 	    { TBPM_3DBOX,       Create3DBoxImage }
 	};
 	
-	sprintf (fullname, "%s%dx%d", name, (int) cp.fore, (int) cp.back);
-	if ((image = (Image*) LookInNameList (*list, fullname)) == None) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
 	    for (i = 0; i < (sizeof pmtab) / (sizeof pmtab[0]); i++) {
 		if (XmuCompareISOLatin1 (pmtab[i].name, name) == 0) {
 		    image = (*pmtab[i].proc) (cp);
@@ -3501,7 +4160,7 @@ Image *GetImage (char *name, ColorPair cp)
 		fprintf (stderr, "%s:  no such built-in pixmap \"%s\"\n", ProgramName, name);
 		return (None);
 	    }
-	    AddToList (list, fullname, (char*) image);
+	    CacheImage (name, cp.fore, cp.back, image);
 	}
     }
     else
@@ -3525,8 +4184,7 @@ Image *GetImage (char *name, ColorPair cp)
 	    { "%xpm:zoom-inout", Create3DZoomInOutAnimation }
 	};
 	
-	sprintf (fullname, "%s%dx%d", name, (int) cp.fore, (int) cp.back);
-	if ((image = (Image*) LookInNameList (*list, fullname)) == None) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
 	    for (i = 0; i < (sizeof pmtab) / (sizeof pmtab[0]); i++) {
 		if (XmuCompareISOLatin1 (pmtab[i].name, name) == 0) {
 		    image = (*pmtab[i].proc) (cp);
@@ -3542,7 +4200,7 @@ Image *GetImage (char *name, ColorPair cp)
 		fprintf (stderr, "%s:  no such built-in pixmap \"%s\"\n", ProgramName, name);
 		return (None);
 	    }
-	    AddToList (list, fullname, (char*) image);
+	    CacheImage (name, cp.fore, cp.back, image);
 	}
     }
     else
@@ -3564,8 +4222,7 @@ Image *GetImage (char *name, ColorPair cp)
 	    { TBPM_QUESTION,	CreateQuestionPixmap },
 	};
 	
-	sprintf (fullname, "%s%dx%d", name, (int) cp.fore, (int) cp.back);
-	if ((image = (Image*) LookInNameList (*list, fullname)) == None) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
 	    for (i = 0; i < (sizeof pmtab) / (sizeof pmtab[0]); i++) {
 		if (XmuCompareISOLatin1 (pmtab[i].name, name) == 0) {
 		    pm = (*pmtab[i].proc) (&width, &height);
@@ -3593,20 +4250,55 @@ Image *GetImage (char *name, ColorPair cp)
 	    image->width  = width;
 	    image->height = height;
 	    image->next   = None;
-	    AddToList (list, fullname, (char*) image);
+	    CacheImage (name, cp.fore, cp.back, image);
 	}
     }
     else {
-	sprintf (fullname, "%s%dx%d", name, (int) cp.fore, (int) cp.back);
-	if ((image = (Image*) LookInNameList (*list, fullname)) == None) {
+	if ((image = LookupImage (name, cp.fore, cp.back)) == None) {
 	    if ((image = GetBitmapImage (name, cp)) != None) {
-		AddToList (list, fullname, (char*) image);
+		CacheImage (name, cp.fore, cp.back, image);
 	    }
 	}
     }
     return (image);
 }
 
+Image *GetImage (char *name, ColorPair cp)
+{
+    Image *image;
+
+    ProfileBegin ("GetImage");
+    image = FetchImage (name, cp);
+    ProfileEnd ();
+    return (image);
+}
+
+/*
+ * Like GetImage, but images that can be decoded in the background are
+ * returned later: *imagep is then set from the event loop and notify is
+ * called with closure.  Returns False if the image can't be had at all.
+ */
+Bool RequestImage (char *name, ColorPair cp, Image **imagep,
+		   void (*notify) (void *closure), void *closure)
+{
+    *imagep = None;
+    if (name == NULL) return (False);
+#if defined(JPEG) && defined(USE_THREADS)
+    if (strncmp (name, "jpeg:", 5) == 0) {
+	if ((*imagep = LookupImage (name, 0, 0)) != None) return (True);
+	if (QueueDecodeJob (name, imagep, notify, closure)) return (True);
+    }
+#endif
+    *imagep = GetImage (name, cp);
+    return (*imagep != None);
+}
+
+#if !defined(JPEG) || !defined(USE_THREADS)
+void HandleDecodedImages (void)
+{
+}
+#endif
+
 static void FreeImage (Image *image)
 {
     Image *im, *im2;
@@ -3618,6 +4310,7 @@ static void FreeImage (Image *image)
 	im2 = im->next;
 	free (im);
 	im = im2;
+	if (im == image) break;		/* animations loop on themselves */
     }
 }
 
@@ -4156,6 +4849,491 @@ static void swaplong (char *bp, unsigned n)
     }
 }
 
+/***********************************************************************
+ *
+ *  Property prefetch
+ *
+ *  Managing a window reads a couple of dozen of its properties, and
+ *  every XGetWindowProperty is a round trip of its own.  AddWindow
+ *  first hands the whole list to PrefetchProperties; the Twm* getters
+ *  below then answer from what was prefetched for that window until
+ *  ReleaseProperties.  Any number of windows may be prefetched at
+ *  once, so that startup can queue everything for every client before
+ *  it adopts the first one.  With USE_XCB all the GetProperty requests
+ *  go out at once on the XCB side of the connection and the replies
+ *  are picked up as they are asked for.  Without it, one
+ *  XListProperties per window tells which properties are absent, and
+ *  those (the bulk of them) are answered without asking the server.
+ *
+ *  Setting or deleting a prefetched property through the Twm* setters
+ *  forgets it, so that it is read back from the server afterwards.
+ *
+ ***********************************************************************
+ */
+
+#define PREFETCH_LENGTH	0x1fffffffL	/* 32-bit units: everything */
+
+typedef struct PropCache {
+    Atom		atom;
+    Bool		known;		/* the fields below are valid */
+#ifdef USE_XCB
+    Bool		pending;	/* reply not collected yet */
+    xcb_get_property_cookie_t cookie;
+#endif
+    Atom		type;		/* None when absent */
+    int			format;
+    unsigned long	nitems;
+    unsigned char	*data;		/* laid out as Xlib returns it */
+} PropCache;
+
+typedef struct PropWindow {
+    Window		w;
+    PropCache		*props;
+    int			count, size;
+#ifndef USE_XCB
+    Atom		*present;	/* from XListProperties */
+    int			npresent;
+#endif
+    struct PropWindow	*next;
+} PropWindow;
+
+static PropWindow	*PrefetchList = NULL;
+
+static PropWindow *PrefetchFindWindow (Window w)
+{
+    PropWindow *pw, **pp;
+
+    for (pp = &PrefetchList; (pw = *pp) != NULL; pp = &pw->next) {
+	if (pw->w != w) continue;
+	if (pp != &PrefetchList) {	/* most recently used first */
+	    *pp = pw->next;
+	    pw->next = PrefetchList;
+	    PrefetchList = pw;
+	}
+	return (pw);
+    }
+    return (NULL);
+}
+
+static PropCache *PrefetchFind (Window w, Atom atom)
+{
+    PropWindow *pw;
+    int i;
+
+    if (w == None || (pw = PrefetchFindWindow (w)) == NULL) return (NULL);
+    for (i = 0; i < pw->count; i++)
+	if (pw->props [i].atom == atom) return (&pw->props [i]);
+    return (NULL);
+}
+
+static int PrefetchItemSize (int format)
+{
+    switch (format) {
+	case 32: return (sizeof (long));
+	case 16: return (sizeof (short));
+	default: return (1);
+    }
+}
+
+#ifdef USE_XCB
+static void PrefetchCollect (PropCache *p)
+{
+    xcb_get_property_reply_t *r;
+    xcb_generic_error_t *e = NULL;
+    unsigned char *v;
+    unsigned long i;
+
+    p->pending = False;
+    r = xcb_get_property_reply (XGetXCBConnection (dpy), p->cookie, &e);
+    if (e != NULL) free (e);
+    if (r == NULL) return;	/* let Xlib ask again and report it */
+    p->known  = True;
+    p->type   = r->type;
+    p->format = r->format;
+    p->nitems = 0;
+    if (r->type != None && r->value_len > 0) {
+	v = (unsigned char *) xcb_get_property_value (r);
+	p->data = (unsigned char *) malloc (r->value_len * PrefetchItemSize (r->format));
+	if (p->data == NULL) {
+	    p->known = False;
+	    free (r);
+	    return;
+	}
+	p->nitems = r->value_len;
+	for (i = 0; i < p->nitems; i++) {
+	    switch (r->format) {
+		case 32: ((long *)  p->data) [i] = (long) ((int *) v) [i]; break;
+		case 16: ((short *) p->data) [i] = ((short *) v) [i];      break;
+		default: p->data [i] = v [i];                               break;
+	    }
+	}
+    }
+    free (r);
+}
+#endif /* USE_XCB */
+
+static void PrefetchDrop (PropCache *p)
+{
+#ifdef USE_XCB
+    if (p->pending)
+	xcb_discard_reply (XGetXCBConnection (dpy), p->cookie.sequence);
+    p->pending = False;
+#endif
+    free (p->data);
+    p->data  = NULL;
+    p->known = False;
+}
+
+static void PrefetchForget (Window w, Atom atom)
+{
+    PropCache *p;
+
+    if ((p = PrefetchFind (w, atom)) != NULL) PrefetchDrop (p);
+}
+
+void PrefetchProperties (Window w, Atom *atoms, int n)
+{
+    PropWindow *pw;
+    PropCache *p;
+    int i;
+#ifdef USE_XCB
+    xcb_connection_t *c = XGetXCBConnection (dpy);
+#else
+    int j;
+#endif
+
+    if (w == None) return;
+    if ((pw = PrefetchFindWindow (w)) == NULL) {
+	if ((pw = (PropWindow *) calloc (1, sizeof (PropWindow))) == NULL)
+	    return;
+	pw->w    = w;
+#ifndef USE_XCB
+	pw->present = XListProperties (dpy, w, &pw->npresent);
+#endif
+	pw->next = PrefetchList;
+	PrefetchList = pw;
+    }
+    if (pw->count + n > pw->size) {
+	p = (PropCache *) realloc (pw->props,
+				   (pw->count + n) * sizeof (PropCache));
+	if (p == NULL) return;
+	pw->props = p;
+	pw->size  = pw->count + n;
+    }
+    for (i = 0; i < n; i++) {
+	if (atoms [i] == None || PrefetchFind (w, atoms [i]) != NULL) continue;
+	p = &pw->props [pw->count++];
+	p->atom   = atoms [i];
+	p->known  = False;
+	p->type   = None;
+	p->format = 0;
+	p->nitems = 0;
+	p->data   = NULL;
+#ifdef USE_XCB
+	p->cookie  = xcb_get_property (c, 0, w, atoms [i],
+				       XCB_GET_PROPERTY_TYPE_ANY, 0,
+				       PREFETCH_LENGTH);
+	p->pending = True;
+#else
+	for (j = 0; j < pw->npresent; j++)
+	    if (pw->present [j] == atoms [i]) break;
+	p->known = (j == pw->npresent);	/* absent */
+#endif
+    }
+}
+
+void ReleaseProperties (Window w)
+{
+    PropWindow *pw;
+    int i;
+
+    if ((pw = PrefetchFindWindow (w)) == NULL) return;
+    PrefetchList = pw->next;		/* found ones are moved first */
+    for (i = 0; i < pw->count; i++)
+	PrefetchDrop (&pw->props [i]);
+    free (pw->props);
+#ifndef USE_XCB
+    if (pw->present != NULL) XFree (pw->present);
+#endif
+    free (pw);
+}
+
+/*
+ * Same contract as XGetWindowProperty.
+ */
+int TwmGetWindowProperty (Display *display, Window w, Atom property,
+			  long long_offset, long long_length, Bool delete,
+			  Atom req_type, Atom *actual_type_return,
+			  int *actual_format_return,
+			  unsigned long *nitems_return,
+			  unsigned long *bytes_after_return,
+			  unsigned char **prop_return)
+{
+    PropCache *p;
+    unsigned long unit, total, start, count, size;
+
+    p = delete ? NULL : PrefetchFind (w, property);
+#ifdef USE_XCB
+    if (p != NULL && p->pending) PrefetchCollect (p);
+#endif
+    if (p == NULL || ! p->known)
+	return (XGetWindowProperty (display, w, property, long_offset,
+				    long_length, delete, req_type,
+				    actual_type_return, actual_format_return,
+				    nitems_return, bytes_after_return,
+				    prop_return));
+
+    *actual_type_return   = p->type;
+    *actual_format_return = p->format;
+    *nitems_return        = 0;
+    *bytes_after_return   = 0;
+    *prop_return          = NULL;
+    if (p->type == None) return (Success);
+
+    unit  = p->format / 8;
+    total = p->nitems * unit;
+    if (req_type != AnyPropertyType && req_type != p->type) {
+	*bytes_after_return = total;
+	return (Success);
+    }
+    start = 4 * (unsigned long) long_offset;
+    if (long_offset < 0 || start > total) return (BadValue);
+    count = total - start;
+    if (long_length >= 0 && count > 4 * (unsigned long) long_length)
+	count = 4 * (unsigned long) long_length;
+    *bytes_after_return = total - start - count;
+
+    count /= unit;
+    size   = count * PrefetchItemSize (p->format);
+    if ((*prop_return = (unsigned char *) malloc (size + 1)) == NULL)
+	return (BadAlloc);
+    if (size > 0)
+	memcpy (*prop_return,
+		p->data + (start / unit) * PrefetchItemSize (p->format), size);
+    (*prop_return) [size] = '\0';
+    *nitems_return = count;
+    return (Success);
+}
+
+int TwmChangeProperty (Display *display, Window w, Atom property, Atom type,
+		       int format, int mode, unsigned char *data, int nelements)
+{
+    PrefetchForget (w, property);
+    return (XChangeProperty (display, w, property, type, format, mode,
+			     data, nelements));
+}
+
+int TwmDeleteProperty (Display *display, Window w, Atom property)
+{
+    PrefetchForget (w, property);
+    return (XDeleteProperty (display, w, property));
+}
+
+/*
+ * The Xlib convenience getters, on top of TwmGetWindowProperty.
+ */
+Status TwmGetTextProperty (Display *display, Window w, XTextProperty *tp,
+			   Atom property)
+{
+    Atom actual_type;
+    int actual_format = 0;
+    unsigned long nitems = 0L, leftover = 0L;
+    unsigned char *prop = NULL;
+
+    if (TwmGetWindowProperty (display, w, property, 0L, 1000000L, False,
+			      AnyPropertyType, &actual_type, &actual_format,
+			      &nitems, &leftover, &prop) == Success &&
+	actual_type != None) {
+	tp->value    = prop;
+	tp->encoding = actual_type;
+	tp->format   = actual_format;
+	tp->nitems   = nitems;
+	return (True);
+    }
+    tp->value    = NULL;
+    tp->encoding = None;
+    tp->format   = 0;
+    tp->nitems   = 0;
+    return (False);
+}
+
+void TwmSetTextProperty (Display *display, Window w, XTextProperty *tp,
+			 Atom property)
+{
+    PrefetchForget (w, property);
+    XSetTextProperty (display, w, tp, property);
+}
+
+Status TwmGetClassHint (Display *display, Window w, XClassHint *classhint)
+{
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, leftover;
+    unsigned char *data = NULL;
+    int len_name, len_class;
+
+    if (TwmGetWindowProperty (display, w, XA_WM_CLASS, 0L, (long) BUFSIZ,
+			      False, XA_STRING, &actual_type, &actual_format,
+			      &nitems, &leftover, &data) != Success)
+	return (0);
+    if (actual_type == XA_STRING && actual_format == 8) {
+	len_name = strlen ((char *) data);
+	if ((classhint->res_name = malloc (len_name + 1)) == NULL) {
+	    XFree (data);
+	    return (0);
+	}
+	strcpy (classhint->res_name, (char *) data);
+	if (len_name == nitems) len_name--;
+	len_class = strlen ((char *) (data + len_name + 1));
+	if ((classhint->res_class = malloc (len_class + 1)) == NULL) {
+	    XFree (classhint->res_name);
+	    classhint->res_name = NULL;
+	    XFree (data);
+	    return (0);
+	}
+	strcpy (classhint->res_class, (char *) (data + len_name + 1));
+	XFree (data);
+	return (1);
+    }
+    if (data) XFree (data);
+    return (0);
+}
+
+XWMHints *TwmGetWMHints (Display *display, Window w)
+{
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, leftover;
+    long *prop = NULL;
+    XWMHints *hints;
+
+    if (TwmGetWindowProperty (display, w, XA_WM_HINTS, 0L, 9L, False,
+			      XA_WM_HINTS, &actual_type, &actual_format,
+			      &nitems, &leftover,
+			      (unsigned char **) &prop) != Success)
+	return (NULL);
+    if (actual_type != XA_WM_HINTS || nitems < 8 || actual_format != 32) {
+	if (prop) XFree (prop);
+	return (NULL);
+    }
+    if ((hints = (XWMHints *) calloc (1, sizeof (XWMHints))) != NULL) {
+	hints->flags         = prop [0];
+	hints->input         = (prop [1] ? True : False);
+	hints->initial_state = (int) prop [2];
+	hints->icon_pixmap   = prop [3];
+	hints->icon_window   = prop [4];
+	hints->icon_x        = (int) prop [5];
+	hints->icon_y        = (int) prop [6];
+	hints->icon_mask     = prop [7];
+	hints->window_group  = (nitems >= 9) ? prop [8] : 0;
+    }
+    XFree (prop);
+    return (hints);
+}
+
+Status TwmGetWMNormalHints (Display *display, Window w, XSizeHints *hints,
+			    long *supplied)
+{
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, leftover;
+    long *prop = NULL;
+
+    if (TwmGetWindowProperty (display, w, XA_WM_NORMAL_HINTS, 0L, 18L, False,
+			      XA_WM_SIZE_HINTS, &actual_type, &actual_format,
+			      &nitems, &leftover,
+			      (unsigned char **) &prop) != Success)
+	return (False);
+    if (actual_type != XA_WM_SIZE_HINTS || nitems < 15 || actual_format != 32) {
+	if (prop) XFree (prop);
+	return (False);
+    }
+    hints->flags        = prop [0];
+    hints->x            = (int) prop [1];
+    hints->y            = (int) prop [2];
+    hints->width        = (int) prop [3];
+    hints->height       = (int) prop [4];
+    hints->min_width    = (int) prop [5];
+    hints->min_height   = (int) prop [6];
+    hints->max_width    = (int) prop [7];
+    hints->max_height   = (int) prop [8];
+    hints->width_inc    = (int) prop [9];
+    hints->height_inc   = (int) prop [10];
+    hints->min_aspect.x = (int) prop [11];
+    hints->min_aspect.y = (int) prop [12];
+    hints->max_aspect.x = (int) prop [13];
+    hints->max_aspect.y = (int) prop [14];
+    *supplied = (USPosition | USSize | PAllHints);
+    if (nitems >= 18) {
+	hints->base_width  = (int) prop [15];
+	hints->base_height = (int) prop [16];
+	hints->win_gravity = (int) prop [17];
+	*supplied |= (PBaseSize | PWinGravity);
+    }
+    hints->flags &= (*supplied);
+    XFree (prop);
+    return (True);
+}
+
+static Status TwmGetWindowList (Window w, Atom property, Atom type,
+				unsigned long **list, int *count)
+{
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, leftover;
+    unsigned long *data = NULL;
+
+    if (TwmGetWindowProperty (dpy, w, property, 0L, 1000000L, False, type,
+			      &actual_type, &actual_format, &nitems,
+			      &leftover, (unsigned char **) &data) != Success)
+	return (False);
+    if (actual_type != type || actual_format != 32) {
+	if (data) XFree (data);
+	return (False);
+    }
+    *list  = data;
+    *count = (int) nitems;
+    return (True);
+}
+
+Status TwmGetWMProtocols (Display *display, Window w, Atom **protocols,
+			  int *count)
+{
+    return (TwmGetWindowList (w, _XA_WM_PROTOCOLS, XA_ATOM,
+			      (unsigned long **) protocols, count));
+}
+
+Status TwmGetWMColormapWindows (Display *display, Window w, Window **windows,
+				int *count)
+{
+    return (TwmGetWindowList (w, _XA_WM_COLORMAP_WINDOWS, XA_WINDOW,
+			      (unsigned long **) windows, count));
+}
+
+Status TwmGetTransientForHint (Display *display, Window w, Window *propw)
+{
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, leftover;
+    Window *data = NULL;
+
+    if (TwmGetWindowProperty (display, w, XA_WM_TRANSIENT_FOR, 0L, 1L, False,
+			      XA_WINDOW, &actual_type, &actual_format,
+			      &nitems, &leftover,
+			      (unsigned char **) &data) != Success) {
+	*propw = None;
+	return (False);
+    }
+    if (actual_type == XA_WINDOW && actual_format == 32 && nitems != 0) {
+	*propw = data [0];
+	XFree (data);
+	return (True);
+    }
+    *propw = None;
+    if (data) XFree (data);
+    return (False);
+}
+
 /***********************************************************************
  *
  *  Procedure:
@@ -4181,7 +5359,7 @@ unsigned char *GetWMPropertyString(Window w, Atom prop)
     unsigned char	*stringptr;
     int			status, len = -1;
 
-    (void)XGetTextProperty(dpy, w, &text_prop, prop);
+    (void)TwmGetTextProperty(dpy, w, &text_prop, prop);
     if (text_prop.value != NULL) {
 	if (text_prop.encoding == XA_STRING
 	    || text_prop.encoding == XA_COMPOUND_TEXT) {
@@ -4306,17 +5484,229 @@ void ConstrainByBorders (TwmWindow *twmwin,
     }
 }
 
+/***********************************************************************
+ *
+ *  Spatial index
+ *
+ *  Each screen files the frames of its windows in a uniform grid of
+ *  SPATIAL_CELL pixels squares covering the root window, so that pack,
+ *  push and constraint lookups only look at the windows near the area
+ *  they are interested in instead of the whole window list.  A frame is
+ *  filed in every cell it covers, coordinates outside the root window
+ *  being clamped to the border cells.  SetupFrame keeps the grid up to
+ *  date, and HandleDestroyNotify takes the window out of it.  Frame
+ *  coordinates are relative to the virtual screen or window box the
+ *  window lives in, so callers still check that the windows they get
+ *  back are the ones they want.
+ *
+ ***********************************************************************
+ */
+
+#define SPATIAL_CELL	256
+
+typedef struct SpatialCell {
+    TwmWindow	**wins;
+    int		count;
+    int		size;
+} SpatialCell;
+
+struct SpatialIndex {
+    int			cols, rows;
+    SpatialCell		*cells;
+    unsigned long	stamp;
+};
+
+static int SpatialClamp (int v, int n)
+{
+    if (v < 0) return 0;
+    v /= SPATIAL_CELL;
+    return (v >= n) ? n - 1 : v;
+}
+
+static struct SpatialIndex *SpatialCreate (void)
+{
+    struct SpatialIndex *si;
+
+    si = (struct SpatialIndex*) calloc (1, sizeof (struct SpatialIndex));
+    if (si == NULL) return NULL;
+    si->cols  = (Scr->rootw + SPATIAL_CELL - 1) / SPATIAL_CELL;
+    si->rows  = (Scr->rooth + SPATIAL_CELL - 1) / SPATIAL_CELL;
+    if (si->cols < 1) si->cols = 1;
+    if (si->rows < 1) si->rows = 1;
+    si->cells = (SpatialCell*) calloc (si->cols * si->rows, sizeof (SpatialCell));
+    if (si->cells == NULL) {
+	free (si);
+	return NULL;
+    }
+    return si;
+}
+
+void SpatialRemove (TwmWindow *tmp_win)
+{
+    struct SpatialIndex *si = tmp_win->sindex;
+    SpatialCell	*cell;
+    int		cx, cy, i;
+
+    if (si == NULL) return;
+    for (cy = tmp_win->scell [1]; cy <= tmp_win->scell [3]; cy++) {
+	for (cx = tmp_win->scell [0]; cx <= tmp_win->scell [2]; cx++) {
+	    cell = &si->cells [cy * si->cols + cx];
+	    for (i = 0; i < cell->count; i++) {
+		if (cell->wins [i] != tmp_win) continue;
+		cell->wins [i] = cell->wins [--cell->count];
+		break;
+	    }
+	}
+    }
+    tmp_win->sindex = NULL;
+}
+
+void SpatialUpdate (TwmWindow *tmp_win)
+{
+    struct SpatialIndex *si;
+    SpatialCell	*cell;
+    TwmWindow	**wins;
+    int		x0, y0, x1, y1, cx, cy, size;
+
+    if (Scr->Spatial == NULL) Scr->Spatial = SpatialCreate ();
+    si = Scr->Spatial;
+    if (si == NULL) return;
+
+    x0 = SpatialClamp (tmp_win->frame_x, si->cols);
+    y0 = SpatialClamp (tmp_win->frame_y, si->rows);
+    x1 = SpatialClamp (tmp_win->frame_x + (int) tmp_win->frame_width  +
+		       2 * tmp_win->frame_bw - 1, si->cols);
+    y1 = SpatialClamp (tmp_win->frame_y + (int) tmp_win->frame_height +
+		       2 * tmp_win->frame_bw - 1, si->rows);
+    if (tmp_win->sindex == si &&
+	tmp_win->scell [0] == x0 && tmp_win->scell [1] == y0 &&
+	tmp_win->scell [2] == x1 && tmp_win->scell [3] == y1) return;
+
+    SpatialRemove (tmp_win);
+    for (cy = y0; cy <= y1; cy++) {
+	for (cx = x0; cx <= x1; cx++) {
+	    cell = &si->cells [cy * si->cols + cx];
+	    if (cell->count == cell->size) {
+		size = cell->size ? 2 * cell->size : 8;
+		wins = (TwmWindow**) realloc (cell->wins, size * sizeof (TwmWindow*));
+		if (wins == NULL) continue;
+		cell->wins = wins;
+		cell->size = size;
+	    }
+	    cell->wins [cell->count++] = tmp_win;
+	}
+    }
+    tmp_win->sindex   = si;
+    tmp_win->scell [0] = x0;
+    tmp_win->scell [1] = y0;
+    tmp_win->scell [2] = x1;
+    tmp_win->scell [3] = y1;
+}
+
+/*
+ * Returns the windows filed in the cells covered by the given rectangle,
+ * each of them once, in a malloc'ed array the caller frees.  The windows
+ * are only known to be near the rectangle, not inside it.
+ */
+TwmWindow **SpatialQuery (int x, int y, int width, int height, int *countp)
+{
+    struct SpatialIndex *si = Scr->Spatial;
+    SpatialCell	*cell;
+    TwmWindow	**wins, **more, *t;
+    int		x0, y0, x1, y1, cx, cy, i, n, size;
+
+    *countp = 0;
+    if (si == NULL || width <= 0 || height <= 0) return NULL;
+    x0 = SpatialClamp (x, si->cols);
+    y0 = SpatialClamp (y, si->rows);
+    x1 = SpatialClamp (x + width  - 1, si->cols);
+    y1 = SpatialClamp (y + height - 1, si->rows);
+
+    si->stamp++;
+    wins = NULL;
+    n = size = 0;
+    for (cy = y0; cy <= y1; cy++) {
+	for (cx = x0; cx <= x1; cx++) {
+	    cell = &si->cells [cy * si->cols + cx];
+	    for (i = 0; i < cell->count; i++) {
+		t = cell->wins [i];
+		if (t->sstamp == si->stamp) continue;
+		t->sstamp = si->stamp;
+		if (n == size) {
+		    size = size ? 2 * size : 16;
+		    more = (TwmWindow**) realloc (wins, size * sizeof (TwmWindow*));
+		    if (more == NULL) {
+			*countp = n;
+			return wins;
+		    }
+		    wins = more;
+		}
+		wins [n++] = t;
+	    }
+	}
+    }
+    *countp = n;
+    return wins;
+}
+
 #ifdef JPEG
 
-unsigned short int *buffer_16bpp;
-long *buffer_32bpp;
+/*
+ * JPEG scanlines are converted to the XImage format a whole row at a
+ * time, the converter being chosen once per image from the depth and
+ * byte order of the screen.  The loops are kept simple enough for the
+ * compiler to vectorize them.  With libjpeg-turbo, 32 bits images are
+ * decoded straight into the XImage by the library and need no
+ * conversion at all.
+ */
+typedef void (*JpegRowProc) (unsigned char *src, unsigned char *dst, int width);
 
-static void convert_for_16 (int w, int x, int y, int r, int g, int b) {
-  buffer_16bpp [y * w + x] = ((r >> 3) << 11) + ((g >> 2) << 5) + (b >> 3);
+static void jpeg_row_565_lsb (unsigned char *src, unsigned char *dst, int width)
+{
+  int x;
+  unsigned int p;
+
+  for (x = 0; x < width; x++, src += 3, dst += 2) {
+    p = ((src [0] >> 3) << 11) | ((src [1] >> 2) << 5) | (src [2] >> 3);
+    dst [0] = p & 0xff;
+    dst [1] = p >> 8;
+  }
 }
 
-static void convert_for_32 (int w, int x, int y, int r, int g, int b) {
-  buffer_32bpp [y * w + x] = ((r << 16) + (g << 8) + b) & 0xFFFFFFFF; 
+static void jpeg_row_565_msb (unsigned char *src, unsigned char *dst, int width)
+{
+  int x;
+  unsigned int p;
+
+  for (x = 0; x < width; x++, src += 3, dst += 2) {
+    p = ((src [0] >> 3) << 11) | ((src [1] >> 2) << 5) | (src [2] >> 3);
+    dst [0] = p >> 8;
+    dst [1] = p & 0xff;
+  }
+}
+
+static void jpeg_row_888_lsb (unsigned char *src, unsigned char *dst, int width)
+{
+  int x;
+
+  for (x = 0; x < width; x++, src += 3, dst += 4) {
+    dst [0] = src [2];
+    dst [1] = src [1];
+    dst [2] = src [0];
+    dst [3] = 0;
+  }
+}
+
+static void jpeg_row_888_msb (unsigned char *src, unsigned char *dst, int width)
+{
+  int x;
+
+  for (x = 0; x < width; x++, src += 3, dst += 4) {
+    dst [0] = 0;
+    dst [1] = src [0];
+    dst [2] = src [1];
+    dst [3] = src [2];
+  }
 }
 
 static void jpeg_error_exit (j_common_ptr cinfo) {
@@ -4358,95 +5748,276 @@ static Image *GetJpegImage (char *name)
     return (image);
 }
 
-static Image *LoadJpegImage (char *name)
+/*
+ * Decode a JPEG file into a buffer of pixels laid out as a ZPixmap
+ * XImage of bpp bytes per pixel.  This does not touch the display, so
+ * it may run on a decoding thread.
+ */
+static char *DecodeJpegFile (char *fullname, int bpp, int lsb, int report,
+			     int *widthp, int *heightp)
 {
-  char   *fullname;
-  XImage *ximage;
   FILE   *infile;
-  Image  *image;
-  Pixmap pixret;
-  void   (*store_data) (int w, int x, int y, int r, int g, int b);
+  char   * volatile data;	/* survives the longjmp */
+  JpegRowProc convert_row;
   struct jpeg_decompress_struct cinfo;
   struct jpeg_error jerr;
   JSAMPARRAY buffer;
-  int width, height;
-  int row_stride;
-  int g, i, a;
-  int bpix;
-  GC  gc;
-
-  fullname = ExpandPixmapPath (name);
-  if (! fullname) return (None);
-
-  image = (Image *) malloc (sizeof (Image));
-  if (image == None) return (None);
+  JSAMPROW row;
+  int width, height, stride;
 
   if ((infile = fopen (fullname, "rb")) == NULL) {
-    if (!reportfilenotfound) fprintf (stderr, "unable to locate %s\n", fullname);
+    if (report) fprintf (stderr, "unable to locate %s\n", fullname);
     fflush (stdout);
-    return None;
+    return NULL;
   }
+  data = NULL;
   cinfo.err = jpeg_std_error (&jerr.pub);
   jerr.pub.error_exit = jpeg_error_exit;
 
   if (sigsetjmp(jerr.setjmp_buffer, 1)) {
     jpeg_destroy_decompress (&cinfo);
     fclose (infile);
-    return None;
+    if (data) free (data);
+    return NULL;
   }
   jpeg_create_decompress (&cinfo);
   jpeg_stdio_src (&cinfo, infile);
   jpeg_read_header (&cinfo, FALSE);
   cinfo.do_fancy_upsampling = FALSE;
   cinfo.do_block_smoothing = FALSE;
+  cinfo.out_color_space = JCS_RGB;		/* grayscale files too */
+  if (bpp == 2)
+    convert_row = lsb ? jpeg_row_565_lsb : jpeg_row_565_msb;
+  else {
+    convert_row = lsb ? jpeg_row_888_lsb : jpeg_row_888_msb;
+#ifdef JCS_EXTENSIONS
+    cinfo.out_color_space = lsb ? JCS_EXT_BGRX : JCS_EXT_XRGB;
+    convert_row = NULL;
+#endif
+  }
   jpeg_start_decompress (&cinfo);
   width  = cinfo.output_width;
   height = cinfo.output_height;
+  stride = width * bpp;
 
-  if (Scr->d_depth == 16) {
-    store_data = &convert_for_16;
-    buffer_16bpp = (unsigned short int *) malloc ((width) * (height) * 2);
-    ximage = XCreateImage (dpy, CopyFromParent, Scr->d_depth, ZPixmap, 0,
-			   (char *) buffer_16bpp, width, height, 16, width * 2);
-  } else {
-    if (Scr->d_depth == 24) {
-      store_data = &convert_for_32;
-      buffer_32bpp = malloc (width * height * 4);
-      ximage = XCreateImage (dpy, CopyFromParent, Scr->d_depth, ZPixmap, 0,
-			     (char *) buffer_32bpp, width, height, 32, width * 4);
-    } else
-    if (Scr->d_depth == 32) {
-      store_data = &convert_for_32;
-      buffer_32bpp = malloc (width * height * 4);
-      ximage = XCreateImage (dpy, CopyFromParent, Scr->d_depth, ZPixmap, 0,
-			     (char *) buffer_32bpp, width, height, 32, width * 4);
-    } else {
-      fprintf (stderr, "Image %s unsupported depth : %d\n", name, Scr->d_depth);
-      return None;
-    }
-  }
-  if (ximage == None) {
-    fprintf (stderr, "cannot create image for %s\n", name);
+  data = malloc ((size_t) stride * height);
+  if (data == NULL) {
+    fprintf (stderr, "cannot create image for %s\n", fullname);
+    jpeg_destroy_decompress (&cinfo);
+    fclose (infile);
+    return NULL;
   }
-  g = 0;
-  row_stride = cinfo.output_width * cinfo.output_components;
-  buffer = (*cinfo.mem->alloc_sarray)
-    ((j_common_ptr) & cinfo, JPOOL_IMAGE, row_stride, 1);
+  buffer = NULL;
+  if (convert_row)
+    buffer = (*cinfo.mem->alloc_sarray)
+      ((j_common_ptr) & cinfo, JPOOL_IMAGE, width * cinfo.output_components, 1);
 
-  bpix = cinfo.output_components;
   while (cinfo.output_scanline < cinfo.output_height) {
-    jpeg_read_scanlines (&cinfo, buffer, 1);
-    a = 0;
-    for (i = 0; i < bpix * cinfo.output_width; i += bpix) {
-      (*store_data) (width, a, g, buffer[0][i],  buffer[0][i + 1], buffer[0][i + 2]);
-      a++;
-    }
-    g++;
+    row = (JSAMPROW) (data + cinfo.output_scanline * stride);
+    if (convert_row) {
+      jpeg_read_scanlines (&cinfo, buffer, 1);
+      (*convert_row) (buffer [0], row, width);
+    } else
+      jpeg_read_scanlines (&cinfo, &row, 1);
   }
   jpeg_finish_decompress (&cinfo);
   jpeg_destroy_decompress (&cinfo);
   fclose (infile);
 
+  *widthp  = width;
+  *heightp = height;
+  return data;
+}
+
+/*
+ * Decoded pixels may be kept in the directory named by the
+ * ImageCacheDirectory variable, so that a restart does not decode the
+ * same files again.  A cache file holds the pixels for one source file
+ * and one depth, bytes per pixel and byte order, and is only used while
+ * the size and modification time of the source match.  The files are
+ * mapped and given to XPutImage as they are.  Like the decoder, none of
+ * this touches the display.
+ */
+#define IMAGE_FILE_MAGIC	"etwmimg1"
+
+typedef struct JpegPixels {
+    char	*data;
+    int		width, height;
+    void	*map;			/* mapped cache file, if any */
+    size_t	maplen;
+} JpegPixels;
+
+struct ImageFileHeader {
+    char	magic [8];
+    int		depth, bpp, lsb;
+    int		width, height;
+    int		namelen;
+    long	offset;			/* of the pixels */
+    long	srcsize;
+    long	srcmtime;
+};
+
+static char *ImageCacheFile (char *dir, char *fullname, int depth, int bpp, int lsb)
+{
+    unsigned int h;
+    char         *p, *ret;
+
+    h = 2166136261u;
+    for (p = fullname; *p; p++) h = (h ^ (unsigned char) *p) * 16777619u;
+    ret = (char*) malloc (strlen (dir) + 32);
+    if (ret == NULL) return NULL;
+    sprintf (ret, "%s/%08x-%d-%d%c", dir, h, depth, bpp, lsb ? 'l' : 'm');
+    return ret;
+}
+
+static int ReadImageCache (char *file, char *fullname, struct stat *st,
+			   int depth, int bpp, int lsb, JpegPixels *px)
+{
+    struct ImageFileHeader hdr;
+    struct stat cst;
+    int         fd, namelen;
+    char        *map;
+
+    if ((fd = open (file, O_RDONLY)) < 0) return 0;
+    namelen = strlen (fullname);
+    if ((read (fd, &hdr, sizeof (hdr)) != sizeof (hdr)) ||
+	(memcmp (hdr.magic, IMAGE_FILE_MAGIC, 8) != 0) ||
+	(hdr.depth != depth) || (hdr.bpp != bpp) || (hdr.lsb != lsb) ||
+	(hdr.namelen != namelen) ||
+	(hdr.srcsize != (long) st->st_size) ||
+	(hdr.srcmtime != (long) st->st_mtime) ||
+	(fstat (fd, &cst) < 0) ||
+	(cst.st_size != hdr.offset + (long) hdr.width * hdr.height * bpp)) {
+	close (fd);
+	return 0;
+    }
+    map = mmap (NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) return 0;
+    if (memcmp (map + sizeof (hdr), fullname, namelen) != 0) {
+	munmap (map, cst.st_size);
+	return 0;
+    }
+    px->data   = map + hdr.offset;
+    px->width  = hdr.width;
+    px->height = hdr.height;
+    px->map    = map;
+    px->maplen = cst.st_size;
+    return 1;
+}
+
+static void WriteImageCache (char *dir, char *file, char *fullname,
+			     struct stat *st, int depth, int bpp, int lsb,
+			     JpegPixels *px)
+{
+    struct ImageFileHeader hdr;
+    static char zero [8];
+    char        *tmp, *p;
+    int         fd, ok;
+    size_t      len;
+
+    tmp = (char*) malloc (strlen (file) + 8);
+    if (tmp == NULL) return;
+
+    /* create the directory and its parent, e.g. ~/.cache/etwm */
+    strcpy (tmp, dir);
+    if ((p = strrchr (tmp, '/')) != NULL && p != tmp) {
+	*p = '\0';
+	mkdir (tmp, 0700);
+    }
+    mkdir (dir, 0700);
+
+    sprintf (tmp, "%sXXXXXX", file);
+    if ((fd = mkstemp (tmp)) < 0) {
+	free (tmp);
+	return;
+    }
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, IMAGE_FILE_MAGIC, 8);
+    hdr.depth    = depth;
+    hdr.bpp      = bpp;
+    hdr.lsb      = lsb;
+    hdr.width    = px->width;
+    hdr.height   = px->height;
+    hdr.namelen  = strlen (fullname);
+    hdr.offset   = (sizeof (hdr) + hdr.namelen + 7) & ~7;
+    hdr.srcsize  = (long) st->st_size;
+    hdr.srcmtime = (long) st->st_mtime;
+    len = (size_t) px->width * px->height * bpp;
+
+    ok = (write (fd, &hdr, sizeof (hdr)) == sizeof (hdr)) &&
+	 (write (fd, fullname, hdr.namelen) == hdr.namelen) &&
+	 (write (fd, zero, hdr.offset - sizeof (hdr) - hdr.namelen) ==
+	  hdr.offset - sizeof (hdr) - hdr.namelen) &&
+	 (write (fd, px->data, len) == len);
+    if ((close (fd) < 0) || ! ok || (rename (tmp, file) < 0)) unlink (tmp);
+    free (tmp);
+}
+
+/*
+ * Get the pixels of a JPEG file, from the cache directory if possible.
+ */
+static int LoadJpegPixels (char *fullname, char *cachedir,
+			   int depth, int bpp, int lsb, int report,
+			   JpegPixels *px)
+{
+    struct stat st;
+    char        *file;
+
+    px->data = NULL;
+    px->map  = NULL;
+    file = NULL;
+    if (cachedir && (stat (fullname, &st) == 0) &&
+	(file = ImageCacheFile (cachedir, fullname, depth, bpp, lsb)) != NULL &&
+	ReadImageCache (file, fullname, &st, depth, bpp, lsb, px)) {
+	free (file);
+	return 1;
+    }
+    px->data = DecodeJpegFile (fullname, bpp, lsb, report,
+			       &px->width, &px->height);
+    if (file && px->data)
+	WriteImageCache (cachedir, file, fullname, &st, depth, bpp, lsb, px);
+    if (file) free (file);
+    return (px->data != NULL);
+}
+
+static void FreeJpegPixels (JpegPixels *px)
+{
+    if (px->map)
+	munmap (px->map, px->maplen);
+    else if (px->data)
+	free (px->data);
+    px->data = NULL;
+    px->map  = NULL;
+}
+
+/*
+ * Turn the pixels returned by LoadJpegPixels into an Image.  The pixels
+ * are released whatever the outcome.
+ */
+static Image *JpegPixelsToImage (char *name, JpegPixels *px, int bpp)
+{
+  XImage *ximage;
+  Image  *image;
+  Pixmap pixret;
+  GC     gc;
+  int    width  = px->width;
+  int    height = px->height;
+
+  image = (Image *) malloc (sizeof (Image));
+  ximage = XCreateImage (dpy, CopyFromParent, Scr->d_depth, ZPixmap, 0,
+			 px->data, width, height, bpp * 8, width * bpp);
+  if ((image == None) || (ximage == None)) {
+    fprintf (stderr, "cannot create image for %s\n", name);
+    if (ximage) {
+      ximage->data = NULL;
+      XDestroyImage (ximage);
+    }
+    FreeJpegPixels (px);
+    if (image) free (image);
+    return None;
+  }
+
   gc = DefaultGC (dpy, Scr->screen);
   if ((width > (Scr->rootw / 2)) || (height > (Scr->rooth / 2))) {
     int x, y;
@@ -4464,7 +6035,9 @@ static Image *LoadJpegImage (char *name)
     image->width  = width;
     image->height = height;
   }
+  ximage->data = NULL;
   XDestroyImage (ximage);
+  FreeJpegPixels (px);
   image->pixmap = pixret;
   image->mask   = None;
   image->next   = None;
@@ -4472,4 +6045,303 @@ static Image *LoadJpegImage (char *name)
   return image;
 }
 
+static int JpegImageFormat (char *name, int *bppp, int *lsbp)
+{
+  if ((Scr->d_depth != 16) && (Scr->d_depth != 24) && (Scr->d_depth != 32)) {
+    fprintf (stderr, "Image %s unsupported depth : %d\n", name, Scr->d_depth);
+    return 0;
+  }
+  *bppp = (Scr->d_depth == 16) ? 2 : 4;
+  *lsbp = (ImageByteOrder (dpy) == LSBFirst);
+  return 1;
+}
+
+static Image *LoadJpegImage (char *name)
+{
+  char *fullname;
+  int  bpp, lsb, ok;
+  JpegPixels px;
+
+  fullname = ExpandPixmapPath (name);
+  if (! fullname) return (None);
+
+  if (! JpegImageFormat (name, &bpp, &lsb)) {
+    free (fullname);
+    return None;
+  }
+  ok = LoadJpegPixels (fullname, Scr->ImageCacheDirectory, Scr->d_depth,
+		       bpp, lsb, ! reportfilenotfound, &px);
+  free (fullname);
+  if (! ok) return None;
+  return JpegPixelsToImage (name, &px, bpp);
+}
+
+#ifdef USE_THREADS
+/*
+ * Background decoding of JPEG images.
+ *
+ * RequestImage () hands single frame JPEG images to a small pool of
+ * threads which decode them into client side pixels.  Each finished
+ * job writes a byte on a pipe that EtwmNextEvent () waits on along
+ * with the X connection, and HandleDecodedImages () then does the
+ * XPutImage, enters the image in the cache and tells the requesters.
+ * A GetImage () of a name that is still being decoded waits for it.
+ */
+#define DECODE_QUEUED	0
+#define DECODE_RUNNING	1
+#define DECODE_DONE	2
+#define MAXDECODETHREADS 4
+
+typedef struct DecodeRequest {
+    Image		 **imagep;
+    void		 (*notify) (void *closure);
+    void		 *closure;
+    struct DecodeRequest *next;
+} DecodeRequest;
+
+typedef struct DecodeJob {
+    char	     *name;		/* cache key, with the "jpeg:" prefix */
+    char	     *fullname;
+    ScreenInfo	     *scr;
+    char	     *cachedir;
+    int		     depth, bpp, lsb;
+    int		     state;
+    JpegPixels	     pixels;
+    DecodeRequest    *requests;
+    struct DecodeJob *next;
+} DecodeJob;
+
+static DecodeJob	*DecodeJobs = NULL;
+static int		DecodeThreads = 0;
+static int		DecodeWritePipe = -1;
+static pthread_mutex_t	DecodeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	DecodeWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	DecodeDone = PTHREAD_COND_INITIALIZER;
+
+int DecodePipe = -1;
+
+static void RunDecodeJob (DecodeJob *job)
+{
+    JpegPixels px;
+
+    LoadJpegPixels (job->fullname, job->cachedir, job->depth,
+		    job->bpp, job->lsb, 0, &px);
+    pthread_mutex_lock (&DecodeLock);
+    job->pixels = px;
+    job->state  = DECODE_DONE;
+    pthread_cond_broadcast (&DecodeDone);
+    pthread_mutex_unlock (&DecodeLock);
+    if (write (DecodeWritePipe, "", 1) < 0) {
+	/* the pipe is full, so the main loop is already woken up */
+    }
+}
+
+static void *DecodeThread (void *arg)
+{
+    DecodeJob *job;
+
+    pthread_mutex_lock (&DecodeLock);
+    while (1) {
+	for (job = DecodeJobs; job != NULL; job = job->next)
+	    if (job->state == DECODE_QUEUED) break;
+	if (job == NULL) {
+	    pthread_cond_wait (&DecodeWork, &DecodeLock);
+	    continue;
+	}
+	job->state = DECODE_RUNNING;
+	pthread_mutex_unlock (&DecodeLock);
+	RunDecodeJob (job);
+	pthread_mutex_lock (&DecodeLock);
+    }
+    return NULL;
+}
+
+static Bool StartDecodeThreads (void)
+{
+    int       fds [2];
+    int       i, n;
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t  all, old;
+
+    if (DecodeThreads > 0) return True;
+    if (DecodeThreads < 0) return False;
+    DecodeThreads = -1;
+    if (pipe (fds) < 0) return False;
+    for (i = 0; i < 2; i++) {
+	fcntl (fds [i], F_SETFD, FD_CLOEXEC);
+	fcntl (fds [i], F_SETFL, fcntl (fds [i], F_GETFL) | O_NONBLOCK);
+    }
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > MAXDECODETHREADS) n = MAXDECODETHREADS;
+
+    /* the threads must not steal the signals meant for the event loop */
+    sigfillset (&all);
+    pthread_sigmask (SIG_SETMASK, &all, &old);
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < n; i++) {
+	if (pthread_create (&thread, &attr, DecodeThread, NULL) != 0) break;
+    }
+    pthread_attr_destroy (&attr);
+    pthread_sigmask (SIG_SETMASK, &old, NULL);
+    if (i == 0) {
+	close (fds [0]);
+	close (fds [1]);
+	return False;
+    }
+    DecodePipe      = fds [0];
+    DecodeWritePipe = fds [1];
+    DecodeThreads   = i;
+    return True;
+}
+
+static void FinishDecodeJob (DecodeJob *job)
+{
+    ScreenInfo    *savedScr = Scr;
+    DecodeRequest *req, *next;
+    Image         *image;
+
+    Scr = job->scr;
+    image = None;
+    if (job->pixels.data != NULL)
+	image = JpegPixelsToImage (job->name, &job->pixels, job->bpp);
+    if (image != None) {
+	CacheImage (job->name, 0, 0, image);
+	for (req = job->requests; req != NULL; req = req->next) {
+	    *req->imagep = LookupImage (job->name, 0, 0);
+	    if (req->notify) (*req->notify) (req->closure);
+	}
+	ReleaseImage (image);
+    }
+    for (req = job->requests; req != NULL; req = next) {
+	next = req->next;
+	free (req);
+    }
+    free (job->name);
+    free (job->fullname);
+    free (job);
+    Scr = savedScr;
+}
+
+/*
+ * Called from the event loop when DecodePipe is readable.
+ */
+void HandleDecodedImages (void)
+{
+    DecodeJob *job, **prev, *done, **tail;
+    char      buf [64];
+
+    while (read (DecodePipe, buf, sizeof (buf)) > 0);
+
+    done = NULL;
+    tail = &done;
+    pthread_mutex_lock (&DecodeLock);
+    prev = &DecodeJobs;
+    while ((job = *prev) != NULL) {
+	if (job->state == DECODE_DONE) {
+	    *prev = job->next;
+	    job->next = NULL;
+	    *tail = job;
+	    tail = &job->next;
+	} else
+	    prev = &job->next;
+    }
+    pthread_mutex_unlock (&DecodeLock);
+
+    while ((job = done) != NULL) {
+	done = job->next;
+	FinishDecodeJob (job);
+    }
+    XFlush (dpy);
+}
+
+/*
+ * Wait for a pending decoding of name, doing it here if no thread has
+ * picked it up yet, and put the result in the cache.
+ */
+static void WaitForDecodedImage (char *name)
+{
+    DecodeJob *job, **prev;
+
+    pthread_mutex_lock (&DecodeLock);
+    for (prev = &DecodeJobs; (job = *prev) != NULL; prev = &job->next)
+	if ((job->scr == Scr) && (strcmp (job->name, name) == 0)) break;
+    if (job == NULL) {
+	pthread_mutex_unlock (&DecodeLock);
+	return;
+    }
+    if (job->state == DECODE_QUEUED) {
+	job->state = DECODE_RUNNING;
+	pthread_mutex_unlock (&DecodeLock);
+	RunDecodeJob (job);
+	pthread_mutex_lock (&DecodeLock);
+    }
+    while (job->state != DECODE_DONE)
+	pthread_cond_wait (&DecodeDone, &DecodeLock);
+    for (prev = &DecodeJobs; *prev != job; prev = &(*prev)->next);
+    *prev = job->next;
+    pthread_mutex_unlock (&DecodeLock);
+    FinishDecodeJob (job);
+}
+
+static Bool QueueDecodeJob (char *name, Image **imagep,
+			    void (*notify) (void *closure), void *closure)
+{
+    DecodeJob     *job;
+    DecodeRequest *req;
+    char          *fullname;
+    int           bpp, lsb;
+
+    if (strchr (name, '%')) return False;	/* animations stay synchronous */
+    if (! StartDecodeThreads ()) return False;
+    req = (DecodeRequest*) malloc (sizeof (DecodeRequest));
+    if (req == NULL) return False;
+    req->imagep  = imagep;
+    req->notify  = notify;
+    req->closure = closure;
+
+    pthread_mutex_lock (&DecodeLock);
+    for (job = DecodeJobs; job != NULL; job = job->next) {
+	if ((job->scr == Scr) && (strcmp (job->name, name) == 0)) {
+	    req->next = job->requests;
+	    job->requests = req;
+	    pthread_mutex_unlock (&DecodeLock);
+	    return True;
+	}
+    }
+    pthread_mutex_unlock (&DecodeLock);
+
+    if (! JpegImageFormat (name, &bpp, &lsb) ||
+	(fullname = ExpandPixmapPath (&name [5])) == NULL) {
+	free (req);
+	return False;
+    }
+    job = (DecodeJob*) calloc (1, sizeof (DecodeJob));
+    if (job == NULL) {
+	free (fullname);
+	free (req);
+	return False;
+    }
+    job->name     = strdup (name);
+    job->fullname = fullname;
+    job->scr      = Scr;
+    job->cachedir = Scr->ImageCacheDirectory;
+    job->depth    = Scr->d_depth;
+    job->bpp      = bpp;
+    job->lsb      = lsb;
+    job->state    = DECODE_QUEUED;
+    req->next     = NULL;
+    job->requests = req;
+
+    pthread_mutex_lock (&DecodeLock);
+    job->next  = DecodeJobs;
+    DecodeJobs = job;
+    pthread_cond_signal (&DecodeWork);
+    pthread_mutex_unlock (&DecodeLock);
+    return True;
+}
+#endif /* USE_THREADS */
+
 #endif /* JPEG */
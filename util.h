@@ -86,11 +86,12 @@ extern int Animating;
 extern Bool AnimationActive;
 extern Bool MaybeAnimate;
 extern int AnimationSpeed;
-#ifdef USE_SIGNALS
+#ifdef VMS
 extern Bool AnimationPending;
-#else
-extern struct timeval AnimateTimeout;
-#endif /* USE_SIGNALS */
+extern void TimerWake (long msec);
+#endif /* VMS */
+
+typedef void (*TimerProc) (void *closure);
 
 extern void	Zoom(Window wf, Window wt);
 extern void	ZoomTo(Window wf, TwmWindow *twm_win);
@@ -107,6 +108,7 @@ extern Pixmap	FindBitmap(char *name,
 extern void	GetUnknownIcon(char *name);
 extern char	*ExpandFilename(char *name);
 extern char	*ExpandFilePath(char *path);
+extern char	*ImageCacheDirectory(char *dir);
 extern char	*ExpandPixmapPath (char *name);
 
 void MaskScreen (char *file);
@@ -116,7 +118,20 @@ void StopAnimation (void);
 void SetAnimationSpeed (int speed);
 void ModifyAnimationSpeed (int incr);
 void Animate (void);
-void TryToAnimate (void);
+void ScheduleAnimation (void);
+unsigned long TimerNow (void);
+unsigned long TimerNowUsec (void);
+void TimerSet (TimerProc proc, void *closure, long msec);
+void TimerClear (TimerProc proc, void *closure);
+Bool TimerPending (TimerProc proc, void *closure);
+long TimerNext (void);
+void TimerRun (void);
+void TimerSleep (long msec);
+void CountRequests (unsigned long *requests, unsigned long *roundtrips);
+void ProfileStart (char *file);
+void ProfileBegin (char *name);
+void ProfileEnd (void);
+void ProfileReport (void);
 void InsertRGBColormap (Atom a, XStandardColormap *maps, int nmaps,
 			Bool replace);
 void RemoveRGBColormap (Atom a);
@@ -150,6 +165,7 @@ void DebugTrace (char *file);
 void SetBorderCursor (TwmWindow *tmp_win, int x, int y);
 
 extern int HotX, HotY;
+extern int DecodePipe;
 
 struct Image {
     Pixmap pixmap;
@@ -160,6 +176,40 @@ struct Image {
 };
 
 extern Image *GetImage (char *name, ColorPair cp);
+extern void   ReleaseImage (Image *image);
+extern Bool   RequestImage (char *name, ColorPair cp, Image **imagep,
+			    void (*notify) (void *closure), void *closure);
+extern void   HandleDecodedImages (void);
+
+extern void   PrefetchProperties (Window w, Atom *atoms, int n);
+extern void   ReleaseProperties (Window w);
+extern int    TwmGetWindowProperty (Display *display, Window w, Atom property,
+				    long long_offset, long long_length,
+				    Bool delete, Atom req_type,
+				    Atom *actual_type_return,
+				    int *actual_format_return,
+				    unsigned long *nitems_return,
+				    unsigned long *bytes_after_return,
+				    unsigned char **prop_return);
+extern int    TwmChangeProperty (Display *display, Window w, Atom property,
+				 Atom type, int format, int mode,
+				 unsigned char *data, int nelements);
+extern int    TwmDeleteProperty (Display *display, Window w, Atom property);
+extern Status TwmGetTextProperty (Display *display, Window w,
+				  XTextProperty *tp, Atom property);
+extern void   TwmSetTextProperty (Display *display, Window w,
+				  XTextProperty *tp, Atom property);
+extern Status TwmGetClassHint (Display *display, Window w,
+			       XClassHint *classhint);
+extern XWMHints *TwmGetWMHints (Display *display, Window w);
+extern Status TwmGetWMNormalHints (Display *display, Window w,
+				   XSizeHints *hints, long *supplied);
+extern Status TwmGetWMProtocols (Display *display, Window w,
+				 Atom **protocols, int *count);
+extern Status TwmGetWMColormapWindows (Display *display, Window w,
+				       Window **windows, int *count);
+extern Status TwmGetTransientForHint (Display *display, Window w,
+				      Window *propw);
 
 extern unsigned char *GetWMPropertyString(Window w, Atom prop);
 extern void FreeWMPropertyString(char *prop);
@@ -167,5 +217,9 @@ extern void ConstrainByBorders1 (int *left, int width, int *top, int height);
 extern void ConstrainByBorders (TwmWindow *twmwin,
 				int *left, int width,
 				int *top, int height);
+extern void SpatialUpdate (TwmWindow *tmp_win);
+extern void SpatialRemove (TwmWindow *tmp_win);
+extern TwmWindow **SpatialQuery (int x, int y, int width, int height,
+				 int *countp);
 
 #endif /* _UTIL_ */
@@ -154,6 +154,11 @@ void InitVirtualScreens (ScreenInfo *scr) {
     } else {
       scr->VirtualScreens = (name_list*) malloc (sizeof (name_list));
       scr->VirtualScreens->next = NULL;
+      scr->VirtualScreens->ptr  = NULL;
+#ifdef USE_GNU_REGEX
+      scr->VirtualScreens->re   = NULL;
+#endif
+      scr->VirtualScreens->cache = NULL;
       scr->VirtualScreens->name = (char*) malloc (64);
       sprintf (scr->VirtualScreens->name, "%dx%d+0+0", scr->rootw, scr->rooth);
     }
@@ -131,6 +131,29 @@ void ConstrainedToWinBox (TwmWindow *twmwin, int x, int y, int *nx, int *ny)
     if (y > attr.height - 1) *ny = attr.height - 1;
 }
 
+/*
+ * Translate a position on Root to the inside of the window box, from the
+ * geometry kept for the box rather than by asking the server.
+ */
+void RootToWinBox (WindowBox *winbox, int x, int y, int *nx, int *ny)
+{
+    TwmWindow *box = winbox->twmwin;
+    Window    junkW;
+
+    if (box == NULL) {
+	XTranslateCoordinates (dpy, Scr->Root, winbox->window, x, y,
+			       nx, ny, &junkW);
+	return;
+    }
+    x -= box->frame_x + box->frame_bw + box->frame_bw3D;
+    y -= box->frame_y + box->frame_bw + box->frame_bw3D + box->title_height;
+    if (box->vs && box->vs->window != Scr->Root) {
+	x -= box->vs->x;
+	y -= box->vs->y;
+    }
+    *nx = x; *ny = y;
+}
+
 void fittocontent (TwmWindow *twmwin)
 {
     TwmWindow	*t;
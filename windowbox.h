@@ -46,6 +46,8 @@ extern WindowBox *findWindowBox (TwmWindow *twmwin);
 
 extern void ConstrainedToWinBox (TwmWindow *twmwin,
 				 int x, int y, int *nx, int *ny);
+extern void RootToWinBox (WindowBox *winbox,
+			 int x, int y, int *nx, int *ny);
 extern void fittocontent (TwmWindow *twmwin);
 
 #endif /* _WINDOW_BOX_ */
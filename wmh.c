@@ -20,6 +20,8 @@
   * - Ret_*	retrieves the root or window property and synchronizes the
   *		setting with the window manager
   * - Del_*	deltes the property from the root or window
+  * - Dfr_*	marks the root property stale, so that the next FlushWmh()
+  *		updates it only once however many times it changed
   * - Rcv_*	processes a client message
   * - Snd_*	sends a client message
   */
@@ -539,6 +541,16 @@ Upd_WIN_CLIENT_LIST(ScreenInfo *scr)
 	free(clients);
 }
 
+/** @brief Defer updating the client window list.
+  *
+  * The list is only rebuilt by the next FlushWmh().
+  */
+void
+Dfr_WIN_CLIENT_LIST(ScreenInfo *scr)
+{
+    scr->wmh.dirty._WIN_CLIENT_LIST = 1;
+}
+
 /** @brief Initialize the client window list.
   * @param scr - screen
   *
@@ -2580,7 +2592,7 @@ AddWindowWmh(ScreenInfo *scr, TwmWindow *twin)
     // Ret_WIN_FOCUS(twin);
 
     /* Update the client list because a window was added. */
-    Upd_WIN_CLIENT_LIST(scr);
+    Dfr_WIN_CLIENT_LIST(scr);
 }
 
 void
@@ -2597,7 +2609,7 @@ UpdWindowWmh(ScreenInfo *scr, TwmWindow *twin)
     // Upd_WIN_CLIENT_MOVING(twin);
     // Upd_WIN_MAXIMIZED_GEOMETRY(twin);
 
-    Upd_WIN_CLIENT_LIST(scr);
+    Dfr_WIN_CLIENT_LIST(scr);
 }
 
 /** @brief Withdraw a window in the WMH sense.
@@ -2631,7 +2643,7 @@ DelWindowWmh(ScreenInfo *scr, TwmWindow *twin)
     // Del_WIN_FOCUS(twin);
 
     /* Update the client list because a window was removed. */
-    Upd_WIN_CLIENT_LIST(scr);
+    Dfr_WIN_CLIENT_LIST(scr);
     /* Do not worry about property notifications, the context that would
        deliver them will be removed before the event loop is reentered. */
 
@@ -2645,6 +2657,21 @@ DelWindowWmh(ScreenInfo *scr, TwmWindow *twin)
 
 }
 
+/** @brief Publish the properties marked stale by the Dfr_* functions.
+  * @param scr - screen
+  *
+  * Called by the event loop once the event queue is drained.
+  */
+void
+FlushWmh(ScreenInfo *scr)
+{
+    static const struct WinScreenBits clean;
+
+    if (scr->wmh.dirty._WIN_CLIENT_LIST)
+	Upd_WIN_CLIENT_LIST(scr);
+    scr->wmh.dirty = clean;
+}
+
 /** @} */
 
 /** @name Event loop hooks
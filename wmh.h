@@ -231,6 +231,7 @@ typedef struct WmhScreen {
     struct WinArea area;		/* _WIN_AREA */
     struct WinWorkarea workarea;	/* _WIN_WORKAREA */
     Window *vroots;			/* __SWM_ROOT */
+    struct WinScreenBits dirty;		/* which properties FlushWmh() updates */
 } WmhScreen;
 
 Bool Get_WIN_WORKSPACE(Window window, int *workspace);
@@ -252,6 +253,8 @@ void Upd_WIN_WORKSPACES(ScreenInfo *scr, TwmWindow *twin);
 void Upd_WIN_MAXIMIZED_GEOMETRY(ScreenInfo *scr, TwmWindow *twin);
 void Upd__SWM_VROOT(ScreenInfo *scr);
 
+void Dfr_WIN_CLIENT_LIST(ScreenInfo *scr);
+
 void Snd_WIN_DESKTOP_BUTTON_PROXY(ScreenInfo *scr, XEvent *event);
 
 void InitWmh(ScreenInfo *scr);
@@ -262,6 +265,7 @@ void TermWmh(ScreenInfo *scr);
 void AddWindowWmh(ScreenInfo *scr, TwmWindow *twin);
 void UpdWindowWmh(ScreenInfo *scr, TwmWindow *twin);
 void DelWindowWmh(ScreenInfo *scr, TwmWindow *twin);
+void FlushWmh(ScreenInfo *scr);
 
 Bool HandleWinClientMessage(ScreenInfo *scr, TwmWindow *twin, XEvent *event);
 Bool HandleWinPropertyNotify(ScreenInfo *scr, TwmWindow *twin, XEvent *event);
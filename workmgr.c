@@ -104,8 +104,19 @@ static void ResizeOccupyWindow		(TwmWindow *win);
 static WorkSpace *GetWorkspace		(char *wname);
 static void WMapRedrawWindow		(Window window, int width, int height,
 					 ColorPair cp, char *label);
+static void WMapDrawEntry		(Drawable d, int dx, int dy,
+					 int width, int height,
+					 ColorPair cp, char *label);
+static void WMapSetBackground		(VirtualScreen *vs, WorkSpace *ws,
+					 Pixel color, Pixmap pixmap);
+static void WMapDamage			(VirtualScreen *vs, WorkSpace *ws);
+static void WMapShowEntry		(WinList wl, Bool raise);
+static void WMapHideEntry		(WinList wl);
+static WinList WMapFindEntry		(MapSubwindow *msw, int x, int y);
 void safecopy                           (char *dest, char *src, int size);
 
+static Bool WMapFlushNeeded = False;
+
 static Atom _XA_WM_ETWMSLIST;
 
 int       fullOccupation    = 0;
@@ -248,10 +259,10 @@ void CreateWorkSpaceManager (void)
       MapSubwindow *msw = wsw->mswl [ws2->number];
       if (Scr->workSpaceMgr.curImage == None) {
 	if (Scr->workSpaceMgr.curPaint) {
-	  XSetWindowBackground (dpy, msw->w, Scr->workSpaceMgr.curColors.back);
+	  WMapSetBackground (vs, ws2, Scr->workSpaceMgr.curColors.back, None);
 	}
       } else {
-	XSetWindowBackgroundPixmap (dpy, msw->w, Scr->workSpaceMgr.curImage->pixmap);
+	WMapSetBackground (vs, ws2, 0, Scr->workSpaceMgr.curImage->pixmap);
       }
       XSetWindowBorder (dpy, msw->w, Scr->workSpaceMgr.curBorderColor);
       XClearWindow (dpy, msw->w);
@@ -445,7 +456,6 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
     WList		 *wl, *wl1;
     WinList		 winl;
     XSetWindowAttributes attr;
-    XWindowAttributes    winattrs;
     unsigned long	 eventMask;
     IconMgr		 *iconmgr;
     Window		 oldw;
@@ -494,43 +504,21 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
      * when switching workspaces.
      */
     if (Scr->workSpaceMgr.switchWorkspacesOrdered) {
-	Window	root, parent, *children;
-	unsigned int number, i;
-	TwmWindow *prev = NULL;
+	TwmWindow *win, *prev = NULL;
 
 	/*
-	 * XQueryTree() returns the child windows in back-to-front order.
+	 * The stacking model holds the frames in back-to-front order.
 	 * Exactly the order we want to unmap windows in.
-	 *
-	 * TODO: somehow keep track of this information without needing
-	 * to do an XQueryTree() (which involves a round-trip to the
-	 * server). This might be fairly difficult to do right.
 	 */
-	number = 0;
-	XQueryTree (dpy, Scr->Root, &root, &parent, &children, &number);
-
-	for (i = 0; i < number; i++) {
-	    TwmWindow *win = GetTwmWindow(children[i]);
-#ifdef DEBUG
-	    fprintf(stderr, "Child #%d twm %p id %lx\n", i, win, children[i]);
-#endif
-	    if (win == NULL)			/* skip unmanaged windows */
-		continue;
-	    if (win->frame != children [i]) {	/* skip icons */
-#ifdef DEBUG
-		fprintf(stderr, "Icon? Child %d: %p, id %lx, frame id %lx\n",
-			i, win, children[i], win->frame);
-#endif
-		continue;
-	    }
+	for (win = StackBottomWindow (Scr); win != NULL; win = win->stack_above) {
 	    move_to_after(win, prev);
 	    prev = win;
 	}
 
 #ifdef DEBUG
 	/*
-	 * Any remaining TwmWindows following 'prev' must have been
-	 * un-found. Maybe that is Weird? No, the IconManager could be here.
+	 * Any remaining TwmWindows following 'prev' are not in the
+	 * stacking model. Maybe that is Weird?
 	 */
 	if (prev && prev->next) {
 	    fprintf(stderr, "Windows left after the last one!\n");
@@ -541,8 +529,6 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
 
 	}
 #endif	/* DEBUG */
-
-	XFree(children);
     }
 
     /* Start by making unwanted windows invisible */
@@ -634,24 +620,24 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
     neww = vs->wsw->mswl [newws->number]->w;
     if (useBackgroundInfo) {
 	if (oldws->image == None || Scr->NoImagesInWorkSpaceManager)
-	    XSetWindowBackground       (dpy, oldw, oldws->backcp.back);
+	    WMapSetBackground (vs, oldws, oldws->backcp.back, None);
 	else
-	    XSetWindowBackgroundPixmap (dpy, oldw, oldws->image->pixmap);
+	    WMapSetBackground (vs, oldws, 0, oldws->image->pixmap);
     }
     else {
 	if (Scr->workSpaceMgr.defImage == None || Scr->NoImagesInWorkSpaceManager)
-	    XSetWindowBackground       (dpy, oldw, Scr->workSpaceMgr.defColors.back);
+	    WMapSetBackground (vs, oldws, Scr->workSpaceMgr.defColors.back, None);
 	else
-	    XSetWindowBackgroundPixmap (dpy, oldw, Scr->workSpaceMgr.defImage->pixmap);
+	    WMapSetBackground (vs, oldws, 0, Scr->workSpaceMgr.defImage->pixmap);
     }
     attr.border_pixel = Scr->workSpaceMgr.defBorderColor;
     XChangeWindowAttributes (dpy, oldw, CWBorderPixel, &attr);
 
     if (Scr->workSpaceMgr.curImage == None) {
-	if (Scr->workSpaceMgr.curPaint) XSetWindowBackground (dpy, neww, Scr->workSpaceMgr.curColors.back);
+	if (Scr->workSpaceMgr.curPaint) WMapSetBackground (vs, newws, Scr->workSpaceMgr.curColors.back, None);
     }
     else {
-	XSetWindowBackgroundPixmap (dpy, neww, Scr->workSpaceMgr.curImage->pixmap);
+	WMapSetBackground (vs, newws, 0, Scr->workSpaceMgr.curImage->pixmap);
     }
     attr.border_pixel =  Scr->workSpaceMgr.curBorderColor;
     XChangeWindowAttributes (dpy, neww, CWBorderPixel, &attr);
@@ -659,8 +645,7 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
     XClearWindow (dpy, oldw);
     XClearWindow (dpy, neww);
 
-    XGetWindowAttributes(dpy, Scr->Root, &winattrs);
-    eventMask = winattrs.your_event_mask;
+    eventMask = Scr->RootEventMask;
     XSelectInput(dpy, Scr->Root, eventMask & ~PropertyChangeMask);
 
     XChangeProperty (dpy, Scr->Root, _XA_WM_CURRENTWORKSPACE, XA_STRING, 8, 
@@ -713,7 +698,11 @@ void GotoWorkSpace (VirtualScreen *vs, WorkSpace *ws)
     /* keep track of the order of the workspaces across restarts */
     EtwmSetVScreenMap(dpy, Scr->Root, Scr->vScreenList);
 
-    XSync (dpy, 0);
+    /*
+     * Nothing above waits for the server, so the whole switch goes out
+     * in one batch here.
+     */
+    XFlush (dpy);
     if (Scr->ClickToFocus || Scr->SloppyFocus) set_last_window (newws);
     MaybeAnimate = True;
 }
@@ -725,12 +714,40 @@ char *GetCurrentWorkSpaceName (VirtualScreen *vs)
     return vs->wsw->currentwspc->name;
 }
 
+/*
+ * Called when the background image of ws, decoded in the background,
+ * becomes available after the workspace manager has been set up.
+ */
+static void WorkSpaceImageReady (void *closure)
+{
+    WorkSpace     *ws = (WorkSpace*) closure;
+    VirtualScreen *vs;
+    Window        mapsw;
+    Bool          current;
+
+    if (ws->image == None) return;
+    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
+	if (vs->wsw == NULL || vs->wsw->mswl == NULL ||
+	    vs->wsw->mswl [ws->number] == NULL) continue;
+	current = (vs->wsw->currentwspc == ws);
+	if (current && ! Scr->DontPaintRootWindow) {
+	    XSetWindowBackgroundPixmap (dpy, vs->window, ws->image->pixmap);
+	    XClearWindow (dpy, vs->window);
+	}
+	if (Scr->NoImagesInWorkSpaceManager) continue;
+	if (current && ((Scr->workSpaceMgr.curImage != None) ||
+			 Scr->workSpaceMgr.curPaint)) continue;
+	mapsw = vs->wsw->mswl [ws->number]->w;
+	WMapSetBackground (vs, ws, 0, ws->image->pixmap);
+	XClearWindow (dpy, mapsw);
+    }
+}
+
 void AddWorkSpace (char *name, char *background, char *foreground,
 		   char *backback, char *backfore, char *backpix)
 {
     WorkSpace *ws;
     int	      wsnum;
-    Image     *image;
 
     wsnum = Scr->workSpaceMgr.count;
     if (wsnum == MAXWORKSPACE) return;
@@ -787,13 +804,10 @@ void AddWorkSpace (char *name, char *background, char *foreground,
 	GetColor (Scr->Monochrome, &(ws->backcp.fore), backfore);
 	useBackgroundInfo = True;
     }
-    if ((image = GetImage (backpix, ws->backcp)) != None) {
-	ws->image = image;
+    if (RequestImage (backpix, ws->backcp, &(ws->image),
+		      WorkSpaceImageReady, (void*) ws)) {
 	useBackgroundInfo = True;
     }
-    else {
-	ws->image = None;
-    }
     ws->next   = NULL;
     ws->number = wsnum;
     Scr->workSpaceMgr.count++;
@@ -831,7 +845,6 @@ void SetupOccupation (TwmWindow *twm_win,
     char		wrkSpcList [512];
     int			len;
     WorkSpace    	*ws;
-    XWindowAttributes winattrs;
     unsigned long     eventMask;
     XrmDatabase       db = NULL;
     VirtualScreen     *vs;
@@ -869,7 +882,7 @@ void SetupOccupation (TwmWindow *twm_win,
 	}
     }
 
-    if (LookInList (Scr->OccupyAll, twm_win->full_name, &twm_win->class)) {
+    if (twm_win->policy.occupy_all) {
         twm_win->occupation = fullOccupation;
     }
 
@@ -1014,8 +1027,7 @@ void SetupOccupation (TwmWindow *twm_win,
 	
     len = GetPropertyFromMask (twm_win->occupation, wrkSpcList, &gwkspc);
 
-    if (!XGetWindowAttributes(dpy, twm_win->w, &winattrs)) return;
-    eventMask = winattrs.your_event_mask;
+    eventMask = twm_win->eventmask;
     XSelectInput(dpy, twm_win->w, eventMask & ~PropertyChangeMask);
 
     XChangeProperty (dpy, twm_win->w, _XA_WM_OCCUPATION, XA_STRING, 8, 
@@ -1201,6 +1213,7 @@ void Occupy (TwmWindow *twm_win)
     occupyWindow->twm_win->occupation = twm_win->occupation;
     if (occupyWindow->twm_win->vs != Scr->currentvs) {
 	XReparentWindow(dpy, occupyWindow->twm_win->frame, Scr->Root, x, y);
+	StackReparented(occupyWindow->twm_win, Scr->Root);
 	occupyWindow->twm_win->vs = Scr->currentvs;
     } else
 	XMoveWindow(dpy, occupyWindow->twm_win->frame, x, y);
@@ -1208,6 +1221,7 @@ void Occupy (TwmWindow *twm_win)
     SetMapStateProp (occupyWindow->twm_win, NormalState);
     XMapWindow      (dpy, occupyWindow->w);
     XMapRaised      (dpy, occupyWindow->twm_win->frame);
+    StackRaised     (occupyWindow->twm_win);
     occupyWindow->twm_win->mapped = TRUE;
     occupyWin = twm_win;
 }
@@ -1451,17 +1465,18 @@ static void ReparentFrameAndIcon(VirtualScreen *vs, TwmWindow *tmp_win)
 {
     XReparentWindow(dpy, tmp_win->frame, vs->window,
 		    tmp_win->frame_x, tmp_win->frame_y);
+    StackReparented(tmp_win, vs->window);
     if (tmp_win->icon && tmp_win->icon->w) {
 	struct Icon *icon = tmp_win->icon;
 	XReparentWindow(dpy, icon->w, vs->window,
 			icon->w_x, icon->w_y);
+	icon->parent = vs->window;
     }
     tmp_win->old_parent_vs = vs;
 }
 
 static void Vanish (VirtualScreen *vs, TwmWindow *tmp_win)
 {
-    XWindowAttributes winattrs;
     unsigned long     eventMask;
 
     if (vs && tmp_win->vs && tmp_win->vs != vs)
@@ -1469,8 +1484,7 @@ static void Vanish (VirtualScreen *vs, TwmWindow *tmp_win)
     if (tmp_win->UnmapByMovingFarAway) {
 	XMoveWindow (dpy, tmp_win->frame, Scr->rootw + 1, Scr->rooth + 1);
     } else if (tmp_win->mapped) {
-	XGetWindowAttributes(dpy, tmp_win->w, &winattrs);
-	eventMask = winattrs.your_event_mask;
+	eventMask = tmp_win->eventmask;
 	XSelectInput (dpy, tmp_win->w, eventMask & ~StructureNotifyMask);
 	XUnmapWindow (dpy, tmp_win->w);
 	XUnmapWindow (dpy, tmp_win->frame);
@@ -1519,7 +1533,6 @@ static void Vanish (VirtualScreen *vs, TwmWindow *tmp_win)
 
 static void DisplayWin (VirtualScreen *vs, TwmWindow *tmp_win)
 {
-    XWindowAttributes	winattrs;
     unsigned long	eventMask;
 
     /*
@@ -1550,12 +1563,12 @@ static void DisplayWin (VirtualScreen *vs, TwmWindow *tmp_win)
         if (vs)	{	/* XXX I don't believe the handling of UnmapByMovingFarAway is quite correct */
 	    XReparentWindow (dpy, tmp_win->frame, vs->window,
 		tmp_win->frame_x, tmp_win->frame_y);
+	    StackReparented (tmp_win, vs->window);
 	} else
 	    XMoveWindow (dpy, tmp_win->frame, tmp_win->frame_x, tmp_win->frame_y);
     } else {
 	if (!tmp_win->squeezed) {
-	    XGetWindowAttributes(dpy, tmp_win->w, &winattrs);
-	    eventMask = winattrs.your_event_mask;
+	    eventMask = tmp_win->eventmask;
 	    XSelectInput (dpy, tmp_win->w, eventMask & ~StructureNotifyMask);
 	    XMapWindow   (dpy, tmp_win->w);
 	    XSelectInput (dpy, tmp_win->w, eventMask);
@@ -1577,7 +1590,6 @@ void ChangeOccupation (TwmWindow *tmp_win, int newoccupation)
     char      namelist [512];
     int	      len;
     int	      final_x, final_y;
-    XWindowAttributes winattrs;
     unsigned long     eventMask;
     long      gwkspc = 0; /* for gnome - the workspace of this window */
     int changedoccupation;
@@ -1591,8 +1603,7 @@ void ChangeOccupation (TwmWindow *tmp_win, int newoccupation)
     if ((newoccupation == 0) || /* in case the property has been broken by another client */
 	(newoccupation == tmp_win->occupation)) {
 	len = GetPropertyFromMask (tmp_win->occupation, namelist, &gwkspc);
-	XGetWindowAttributes(dpy, tmp_win->w, &winattrs);
-	eventMask = winattrs.your_event_mask;
+	eventMask = tmp_win->eventmask;
 	XSelectInput(dpy, tmp_win->w, eventMask & ~PropertyChangeMask);
 
 	XChangeProperty (dpy, tmp_win->w, _XA_WM_OCCUPATION, XA_STRING, 8, 
@@ -1660,8 +1671,7 @@ void ChangeOccupation (TwmWindow *tmp_win, int newoccupation)
 	}
     }
     len = GetPropertyFromMask (newoccupation, namelist, &gwkspc);
-    XGetWindowAttributes(dpy, tmp_win->w, &winattrs);
-    eventMask = winattrs.your_event_mask;
+    eventMask = tmp_win->eventmask;
     XSelectInput(dpy, tmp_win->w, eventMask & ~PropertyChangeMask);
 
     XChangeProperty (dpy, tmp_win->w, _XA_WM_OCCUPATION, XA_STRING, 8, 
@@ -1739,7 +1749,7 @@ void WmgrRedoOccupation (TwmWindow *win)
     WorkSpace *ws;
     int       newoccupation;
 
-    if (LookInList (Scr->OccupyAll, win->full_name, &win->class)) {
+    if (win->policy.occupy_all) {
 	newoccupation = fullOccupation;
     }
     else {
@@ -1816,7 +1826,6 @@ static void CreateWorkSpaceManagerWindow (VirtualScreen *vs)
     unsigned long border;
     TwmWindow	  *tmp_win;
     XSetWindowAttributes	attr;
-    XWindowAttributes		wattr;
     unsigned long		attrmask;
     XSizeHints	  sizehints;
     XWMHints	  wmhints;
@@ -1931,18 +1940,23 @@ static void CreateWorkSpaceManagerWindow (VirtualScreen *vs)
 	else
 	    XMapWindow (dpy, mapsw);
 
-	vs->wsw->mswl [ws->number]->wl = NULL;
+	msw->wl       = NULL;
+	msw->pixmap   = None;
+	msw->pwidth   = msw->pheight = 0;
+	msw->bgcolor  = ws->cp.back;
+	msw->bgpixmap = None;
+	msw->damaged  = False;
 	if (useBackgroundInfo) {
 	    if (ws->image == None || Scr->NoImagesInWorkSpaceManager)
-		XSetWindowBackground       (dpy, mapsw, ws->backcp.back);
+		WMapSetBackground (vs, ws, ws->backcp.back, None);
 	    else
-		XSetWindowBackgroundPixmap (dpy, mapsw, ws->image->pixmap);
+		WMapSetBackground (vs, ws, 0, ws->image->pixmap);
 	}
 	else {
 	    if (Scr->workSpaceMgr.defImage == None || Scr->NoImagesInWorkSpaceManager)
-		XSetWindowBackground       (dpy, mapsw, Scr->workSpaceMgr.defColors.back);
+		WMapSetBackground (vs, ws, Scr->workSpaceMgr.defColors.back, None);
 	    else
-		XSetWindowBackgroundPixmap (dpy, mapsw, Scr->workSpaceMgr.defImage->pixmap);
+		WMapSetBackground (vs, ws, 0, Scr->workSpaceMgr.defImage->pixmap);
 	}
 	XClearWindow (dpy, butsw);
 	i++;
@@ -1987,9 +2001,8 @@ static void CreateWorkSpaceManagerWindow (VirtualScreen *vs)
     attrmask |= CWWinGravity;
     XChangeWindowAttributes (dpy, vs->wsw->w, attrmask, &attr);
 
-    XGetWindowAttributes (dpy, vs->wsw->w, &wattr);
-    attrmask = wattr.your_event_mask | KeyPressMask | KeyReleaseMask | ExposureMask;
-    XSelectInput (dpy, vs->wsw->w, attrmask);
+    tmp_win->eventmask |= KeyPressMask | KeyReleaseMask | ExposureMask;
+    XSelectInput (dpy, vs->wsw->w, tmp_win->eventmask);
 
     for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
         Window buttonw = vs->wsw->bswl [ws->number]->w;
@@ -2096,7 +2109,6 @@ static void CreateOccupyWindow (void) {
     XWMHints      wmhints;
     MyFont	  font;
     XSetWindowAttributes attr;
-    XWindowAttributes	 wattr;
     unsigned long attrmask;
     OccupyWindow  *occwin;
     VirtualScreen *vs;
@@ -2214,9 +2226,8 @@ static void CreateOccupyWindow (void) {
     attrmask |= CWCursor;
     XChangeWindowAttributes (dpy, w, attrmask, &attr);
 
-    XGetWindowAttributes (dpy, w, &wattr);
-    attrmask = wattr.your_event_mask | KeyPressMask | KeyReleaseMask | ExposureMask;
-    XSelectInput (dpy, w, attrmask);
+    tmp_win->eventmask |= KeyPressMask | KeyReleaseMask | ExposureMask;
+    XSelectInput (dpy, w, tmp_win->eventmask);
 
     for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
         Window bw = occwin->obuttonw [ws->number];
@@ -2570,6 +2581,18 @@ void WMapDestroyWindow (TwmWindow *win)
     for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
 	if (OCCUPY (win, ws)) WMapRemoveFromList (win, ws);
     }
+    if (win->wmappending) {
+	TwmWindow **prev;
+
+	for (prev = &Scr->workSpaceMgr.pending; *prev != NULL; prev = &(*prev)->wmapnext) {
+	    if (*prev == win) {
+		*prev = win->wmapnext;
+		break;
+	    }
+	}
+	win->wmapnext    = NULL;
+	win->wmappending = False;
+    }
     if (win == occupyWin) {
 	OccupyWindow *occwin = Scr->workSpaceMgr.occupyWindow;
 	XUnmapWindow (dpy, occwin->twm_win->frame);
@@ -2581,27 +2604,17 @@ void WMapDestroyWindow (TwmWindow *win)
 
 void WMapMapWindow (TwmWindow *win)
 {
-    VirtualScreen *vs;
-    WorkSpace *ws;
     WinList   wl;
 
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-      for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
-	for (wl = vs->wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
-	    if (wl->twm_win == win) {
-		XMapWindow (dpy, wl->w);
-		WMapRedrawName (vs, wl);
-		break;
-	    }
-	}
-      }
+    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+	WMapShowEntry (wl, False);
+	WMapRedrawName (wl->vs, wl);
     }
 }
 
 void WMapSetupWindow (TwmWindow *win, int x, int y, int w, int h)
 {
     VirtualScreen *vs;
-    WorkSpace     *ws;
     WinList	  wl;
     float	  wf, hf;
 
@@ -2618,77 +2631,52 @@ void WMapSetupWindow (TwmWindow *win, int x, int y, int w, int h)
 	ResizeOccupyWindow (win);
 	return;
     }
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-      WorkSpaceWindow *wsw = vs->wsw;
-      wf = (float) (wsw->wwidth  - 2) / (float) vs->w;
-      hf = (float) (wsw->wheight - 2) / (float) vs->h;
-      for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
-	for (wl = wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
-	    if (win == wl->twm_win) {
-		wl->x = (int) (x * wf);
-		wl->y = (int) (y * hf);
-		if (w == -1) {
-		    XMoveWindow (dpy, wl->w, wl->x, wl->y);
-		}
-		else {
-		    wl->width  = (unsigned int) ((w * wf) + 0.5);
-		    wl->height = (unsigned int) ((h * hf) + 0.5);
-		    if (!Scr->use3Dwmap) {
-			wl->width  -= 2;
-			wl->height -= 2;
-		    }
-		    if (wl->width  < 1) wl->width  = 1;
-		    if (wl->height < 1) wl->height = 1;
-		    XMoveResizeWindow (dpy, wl->w, wl->x, wl->y, wl->width, wl->height);
-		}
-		break;
+    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+	vs = wl->vs;
+	wf = (float) (vs->wsw->wwidth  - 2) / (float) vs->w;
+	hf = (float) (vs->wsw->wheight - 2) / (float) vs->h;
+	wl->x = (int) (x * wf);
+	wl->y = (int) (y * hf);
+	if (w != -1) {
+	    wl->width  = (unsigned int) ((w * wf) + 0.5);
+	    wl->height = (unsigned int) ((h * hf) + 0.5);
+	    if (!Scr->use3Dwmap) {
+		wl->width  -= 2;
+		wl->height -= 2;
 	    }
+	    if (wl->width  < 1) wl->width  = 1;
+	    if (wl->height < 1) wl->height = 1;
 	}
-      }
+    }
+    /* the small windows follow in WMapFlush */
+    if (win->wmapentries && !win->wmappending) {
+	win->wmappending = True;
+	win->wmapnext    = Scr->workSpaceMgr.pending;
+	Scr->workSpaceMgr.pending = win;
+	WMapFlushNeeded  = True;
     }
 }
 
 void WMapIconify (TwmWindow *win)
 {
-    VirtualScreen *vs;
-    WorkSpace *ws;
     WinList    wl;
 
     if (!win->vs) return;
 
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-	for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
-	    for (wl = vs->wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
-		if (win == wl->twm_win) {
-		    XUnmapWindow (dpy, wl->w);
-		    break;
-		}
-	    }
-	}
+    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+	WMapHideEntry (wl);
     }
 }
 
 void WMapDeIconify (TwmWindow *win)
 {
-    VirtualScreen *vs;
-    WorkSpace *ws;
     WinList    wl;
 
     if (!win->vs) return;
 
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-	for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
-	    for (wl = vs->wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
-		if (win == wl->twm_win) {
-		    if (Scr->NoRaiseDeicon)
-			XMapWindow (dpy, wl->w);
-		    else
-			XMapRaised (dpy, wl->w);
-		    WMapRedrawName (win->vs, wl);
-		    break;
-		}
-	    }
-	}
+    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+	WMapShowEntry (wl, !Scr->NoRaiseDeicon);
+	WMapRedrawName (wl->vs, wl);
     }
 }
 
@@ -2724,34 +2712,38 @@ void WMapRestack (WorkSpace *ws)
     VirtualScreen *vs;
     TwmWindow	*win;
     WinList	wl;
-    Window	root;
-    Window	parent;
-    Window	*children, *smallws;
-    unsigned int number;
-    int		i, j;
+    Window	*smallws;
+    int		number, j;
 
+    if (Scr->FlatWorkSpaceMap) {
+	/* the cells are drawn in the order of the stacking model */
+	for (vs = Scr->vScreenList; vs != NULL; vs = vs->next)
+	    WMapDamage (vs, ws);
+#ifdef EWMH
+	Dfr_NET_CLIENT_LIST_STACKING(Scr);
+#endif				/* EWMH */
+	return;
+    }
     number = 0;
-    XQueryTree (dpy, Scr->Root, &root, &parent, &children, &number);
-    smallws = (Window*) malloc (number * sizeof (Window));
+    for (win = Scr->FirstWindow; win != NULL; win = win->next) number++;
+    smallws = (Window*) malloc ((number + 1) * sizeof (Window));
 
+    /* the stacking model gives the frames without asking the server */
+    StackBottomWindow (Scr);
     for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
       j = 0;
-      for (i = number - 1; i >= 0; i--) {
-	if (!(win = GetTwmWindow(children [i]))) {
-	    continue;
-	}
-	if (win->frame != children [i]) continue; /* skip icons */
+      for (win = Scr->StackTop; win != NULL; win = win->stack_below) {
 	if (! OCCUPY (win, ws)) continue;
 	if (tracefile) {
-	    fprintf (tracefile, "WMapRestack : w = %lx, win = %p\n", children [i], (void *)win);
+	    fprintf (tracefile, "WMapRestack : w = %lx, win = %p\n", win->frame, (void *)win);
 	    fflush (tracefile);
 	}
-	for (wl = vs->wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
+	for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
 	if (tracefile) {
 	    fprintf (tracefile, "WMapRestack : wl = %p, twm_win = %p\n", (void *)wl, (void *)wl->twm_win);
 	    fflush (tracefile);
 	}
-	    if (win == wl->twm_win) {
+	    if (wl->vs == vs && wl->wlist == ws) {
 		smallws [j++] = wl->w;
 		break;
 	    }
@@ -2759,29 +2751,19 @@ void WMapRestack (WorkSpace *ws)
       }
       XRestackWindows (dpy, smallws, j);
     }
-    XFree ((char *) children);
     free  (smallws);
 #ifdef EWMH
-    Upd_NET_CLIENT_LIST_STACKING(Scr);
+    Dfr_NET_CLIENT_LIST_STACKING(Scr);
 #endif				/* EWMH */
     return;
 }
 
 void WMapUpdateIconName (TwmWindow *win)
 {
-    VirtualScreen *vs;
-    WorkSpace *ws;
     WinList   wl;
 
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-      for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
-	for (wl = vs->wsw->mswl [ws->number]->wl; wl != NULL; wl = wl->next) {
-	    if (win == wl->twm_win) {
-		WMapRedrawName (vs, wl);
-		break;
-	    }
-	}
-      }
+    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+	WMapRedrawName (wl->vs, wl);
     }
 }
 
@@ -2875,7 +2857,6 @@ void WMgrHandleButtonEvent (VirtualScreen *vs, XEvent *event)
     int			X0, Y0, X1, Y1, XW, YW, XSW, YSW;
     Position		newX = 0, newY = 0, winX = 0, winY = 0;
     Window		junkW;
-    unsigned int	junk;
     unsigned int	button;
     unsigned int	modifier;
     XSetWindowAttributes attrs;
@@ -2903,17 +2884,29 @@ void WMgrHandleButtonEvent (VirtualScreen *vs, XEvent *event)
 	if (vs->wsw->mswl [ws->number]->w == parent) break;
     }
     if (ws == NULL) return;
-    if (sw == (Window) 0) {
-	GotoWorkSpace (vs, ws);
-	return;
+    if (Scr->FlatWorkSpaceMap) {
+	wl = WMapFindEntry (vs->wsw->mswl [ws->number],
+			    event->xbutton.x, event->xbutton.y);
+	if (wl == NULL) {
+	    GotoWorkSpace (vs, ws);
+	    return;
+	}
+    } else {
+	if (sw == (Window) 0) {
+	    GotoWorkSpace (vs, ws);
+	    return;
+	}
+	if (XFindContext (dpy, sw, MapWListContext, (XPointer *) &wl) == XCNOENT) return;
     }
     oldws = ws;
-
-    if (XFindContext (dpy, sw, MapWListContext, (XPointer *) &wl) == XCNOENT) return;
     win = wl->twm_win;
     if ((! Scr->TransientHasOccupation) && win->transient) return;
 
-    XTranslateCoordinates (dpy, Scr->Root, sw, event->xbutton.x_root, event->xbutton.y_root,
+    if (Scr->FlatWorkSpaceMap) {
+	XW = event->xbutton.x - wl->x;
+	YW = event->xbutton.y - wl->y;
+    } else
+	XTranslateCoordinates (dpy, Scr->Root, sw, event->xbutton.x_root, event->xbutton.y_root,
 				&XW, &YW, &junkW);
     realmovemode = ( Scr->ReallyMoveInWorkspaceManager && !(modifier & ShiftMask)) ||
 		   (!Scr->ReallyMoveInWorkspaceManager &&  (modifier & ShiftMask));
@@ -2932,10 +2925,14 @@ void WMgrHandleButtonEvent (VirtualScreen *vs, XEvent *event)
     }
     switch (button) {
 	case 1 :
-	    XUnmapWindow (dpy, sw);
+	    WMapHideEntry (wl);
 
 	case 2 :
-	    XGetGeometry (dpy, sw, &junkW, &X0, &Y0, &W0, &H0, &bw, &junk);
+	    X0 = wl->x;
+	    Y0 = wl->y;
+	    W0 = wl->width;
+	    H0 = wl->height;
+	    bw = Scr->use3Dwmap ? 0 : 1;
 	    XTranslateCoordinates (dpy, vs->wsw->mswl [oldws->number]->w,
 				mw->w, X0, Y0, &X1, &Y1, &junkW);
 
@@ -2982,6 +2979,7 @@ void WMgrHandleButtonEvent (VirtualScreen *vs, XEvent *event)
     cont = TRUE;
     while (cont) {
         MapSubwindow *msw;
+	WMapFlush ();
 	XMaskEvent (dpy, ButtonPressMask | ButtonMotionMask |
 			 ButtonReleaseMask | ExposureMask, &ev);
 	switch (ev.xany.type) {
@@ -3119,7 +3117,7 @@ move:		XMoveWindow (dpy, w, newX - XW, newY - YW);
 	KeySym  control_L_sym,  control_R_sym;
 	char keys [32];
 
-	XMapWindow (dpy, sw);
+	WMapShowEntry (wl, False);
 	XDestroyWindow (dpy, w);
 	GotoWorkSpace (vs, ws);
 	if (!Scr->DontWarpCursorInWMap) WarpToWindow (win, Scr->RaiseOnWarp);
@@ -3146,7 +3144,7 @@ move:		XMoveWindow (dpy, w, newX - XW, newY - YW);
     switch (button) {
 	case 1 :
 	    if ((newws == NULL) || (newws == oldws) || OCCUPY (wl->twm_win, newws)) {
-		XMapWindow (dpy, sw);
+		WMapShowEntry (wl, False);
 		break;
 	    }
 	    occupation = (win->occupation | (1 << newws->number)) & ~(1 << oldws->number);
@@ -3196,6 +3194,10 @@ void WMapRedrawName (VirtualScreen *vs, WinList wl)
     ColorPair cp;
     char      *label;
 
+    if (Scr->FlatWorkSpaceMap) {
+	WMapDamage (wl->vs, wl->wlist);
+	return;
+    }
     label  = wl->twm_win->icon_name;
      cp     = wl->cp;
 
@@ -3207,6 +3209,13 @@ void WMapRedrawName (VirtualScreen *vs, WinList wl)
 
 static void WMapRedrawWindow (Window window, int width, int height,
 			      ColorPair cp, char *label)
+{
+    XClearWindow (dpy, window);
+    WMapDrawEntry (window, 0, 0, width, height, cp, label);
+}
+
+static void WMapDrawEntry (Drawable d, int dx, int dy, int width, int height,
+			   ColorPair cp, char *label)
 {
     int		x, y, strhei, strwid;
     MyFont	font;
@@ -3218,7 +3227,6 @@ static void WMapRedrawWindow (Window window, int width, int height,
     int descent;
     int fnum;
 
-    XClearWindow (dpy, window);
     font = Scr->workSpaceMgr.windowFont;
 
     XmbTextExtents(font.font_set, label, strlen (label),
@@ -3239,17 +3247,17 @@ static void WMapRedrawWindow (Window window, int width, int height,
     y = ((height + strhei) / 2) - descent;
 
     if (Scr->use3Dwmap) {
-	Draw3DBorder (window, 0, 0, width, height, 1, cp, off, True, False);
+	Draw3DBorder (d, dx, dy, width, height, 1, cp, off, True, False);
 	FB(cp.fore, cp.back);
     } else {
 	FB (cp.back, cp.fore);
-	XFillRectangle (dpy, window, Scr->NormalGC, 0, 0, width, height);
+	XFillRectangle (dpy, d, Scr->NormalGC, dx, dy, width, height);
 	FB (cp.fore, cp.back);
     }
     if (Scr->Monochrome != COLOR) {
-	XmbDrawImageString (dpy, window, font.font_set, Scr->NormalGC, x, y, label, strlen (label));
+	XmbDrawImageString (dpy, d, font.font_set, Scr->NormalGC, dx + x, dy + y, label, strlen (label));
     } else {
-	XmbDrawString (dpy, window, font.font_set,Scr->NormalGC, x, y, label, strlen (label));
+	XmbDrawString (dpy, d, font.font_set,Scr->NormalGC, dx + x, dy + y, label, strlen (label));
     }
 }
 
@@ -3293,6 +3301,19 @@ static void WMapAddToList (TwmWindow *win, WorkSpace *ws)
       }
       if (wl->width  < 1) wl->width  = 1;
       if (wl->height < 1) wl->height = 1;
+      wl->vs      = vs;
+      wl->shown   = win->mapped;
+      wl->twm_win = win;
+      wl->cp      = cp;
+      wl->next    = vs->wsw->mswl [ws->number]->wl;
+      vs->wsw->mswl [ws->number]->wl = wl;
+      wl->wnext   = win->wmapentries;
+      win->wmapentries = wl;
+      if (Scr->FlatWorkSpaceMap) {
+	wl->w = None;
+	WMapDamage (vs, ws);
+	continue;
+      }
       wl->w = XCreateSimpleWindow (dpy, vs->wsw->mswl [ws->number]->w, wl->x, wl->y,
 				   wl->width, wl->height, bw, Scr->Black, cp.back);
       attrmask = 0;
@@ -3307,10 +3328,6 @@ static void WMapAddToList (TwmWindow *win, WorkSpace *ws)
       XSaveContext (dpy, wl->w, TwmContext, (XPointer) vs->wsw->twm_win);
       XSaveContext (dpy, wl->w, ScreenContext, (XPointer) Scr);
       XSaveContext (dpy, wl->w, MapWListContext, (XPointer) wl);
-      wl->twm_win = win;
-      wl->cp      = cp;
-      wl->next    = vs->wsw->mswl [ws->number]->wl;
-      vs->wsw->mswl [ws->number]->wl = wl;
       if (win->mapped) XMapWindow (dpy, wl->w);
     }
 }
@@ -3318,27 +3335,244 @@ static void WMapAddToList (TwmWindow *win, WorkSpace *ws)
 static void WMapRemoveFromList (TwmWindow *win, WorkSpace *ws)
 {
     VirtualScreen *vs;
-    WinList wl, *prev;
+    WinList wl, *prev, *wprev;
 
-    for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
-	prev = &vs->wsw->mswl [ws->number]->wl;
-	wl = *prev;
-	while (wl != NULL) {
-	    if (win == wl->twm_win) {
+    wprev = &win->wmapentries;
+    while ((wl = *wprev) != NULL) {
+	if (wl->wlist != ws) {
+	    wprev = &wl->wnext;
+	    continue;
+	}
+	*wprev = wl->wnext;
+	vs = wl->vs;
+	for (prev = &vs->wsw->mswl [ws->number]->wl; *prev != NULL;
+	     prev = &(*prev)->next) {
+	    if (*prev == wl) {
 		*prev = wl->next;
-		XDeleteContext (dpy, wl->w, TwmContext);
-		XDeleteContext (dpy, wl->w, ScreenContext);
-		XDeleteContext (dpy, wl->w, MapWListContext);
-		XDestroyWindow (dpy, wl->w);
-		free (wl);
 		break;
 	    }
-	    prev = &wl->next;
-	    wl   = *prev;
 	}
+	if (Scr->FlatWorkSpaceMap) {
+	    WMapDamage (vs, ws);
+	} else {
+	    XDeleteContext (dpy, wl->w, TwmContext);
+	    XDeleteContext (dpy, wl->w, ScreenContext);
+	    XDeleteContext (dpy, wl->w, MapWListContext);
+	    XDestroyWindow (dpy, wl->w);
+	}
+	free (wl);
     }
 }
 
+/***********************************************************************
+ *
+ *  Flat workspace map
+ *
+ *  With FlatWorkSpaceMap, the windows in the workspace map have no X
+ *  window of their own.  Each workspace cell is drawn in a pixmap that
+ *  is the background of the cell window, so the server repaints exposed
+ *  cells by itself.  The winList entries are the scene: the functions
+ *  that used to map, move or restack the small windows mark the cell
+ *  damaged instead, and the damaged cells are redrawn at once from the
+ *  event loop.  Button presses are matched to the entries here.
+ *
+ ***********************************************************************
+ */
+
+static void WMapSetBackground (VirtualScreen *vs, WorkSpace *ws,
+			       Pixel color, Pixmap pixmap)
+{
+    MapSubwindow *msw = vs->wsw->mswl [ws->number];
+
+    if (Scr->FlatWorkSpaceMap) {
+	msw->bgcolor  = color;
+	msw->bgpixmap = pixmap;
+	WMapDamage (vs, ws);
+	return;
+    }
+    if (pixmap != None)
+	XSetWindowBackgroundPixmap (dpy, msw->w, pixmap);
+    else
+	XSetWindowBackground       (dpy, msw->w, color);
+}
+
+static void WMapDamage (VirtualScreen *vs, WorkSpace *ws)
+{
+    if (! Scr->FlatWorkSpaceMap) return;
+    vs->wsw->mswl [ws->number]->damaged = True;
+    WMapFlushNeeded = True;
+}
+
+static void WMapShowEntry (WinList wl, Bool raise)
+{
+    if (Scr->FlatWorkSpaceMap) {
+	wl->shown = True;
+	WMapDamage (wl->vs, wl->wlist);
+	return;
+    }
+    if (raise)
+	XMapRaised (dpy, wl->w);
+    else
+	XMapWindow (dpy, wl->w);
+}
+
+static void WMapHideEntry (WinList wl)
+{
+    if (Scr->FlatWorkSpaceMap) {
+	wl->shown = False;
+	WMapDamage (wl->vs, wl->wlist);
+	return;
+    }
+    XUnmapWindow (dpy, wl->w);
+}
+
+/*
+ * The stacking model orders the entries, ranks grow from bottom to top.
+ */
+static int WMapCompareRank (const void *a, const void *b)
+{
+    TwmWindow *wa = (*(WinList*) a)->twm_win;
+    TwmWindow *wb = (*(WinList*) b)->twm_win;
+
+    if (wa->stack_rank < wb->stack_rank) return -1;
+    if (wa->stack_rank > wb->stack_rank) return 1;
+    return 0;
+}
+
+/*
+ * Returns the top-most entry drawn at (x, y) in the cell.
+ */
+static WinList WMapFindEntry (MapSubwindow *msw, int x, int y)
+{
+    WinList wl, found;
+    int     bw = Scr->use3Dwmap ? 0 : 1;
+
+    StackBottomWindow (Scr);
+    found = NULL;
+    for (wl = msw->wl; wl != NULL; wl = wl->next) {
+	if (! wl->shown) continue;
+	if (x < wl->x || x >= wl->x + wl->width  + 2 * bw) continue;
+	if (y < wl->y || y >= wl->y + wl->height + 2 * bw) continue;
+	if (found == NULL ||
+	    wl->twm_win->stack_rank > found->twm_win->stack_rank) found = wl;
+    }
+    return found;
+}
+
+static void WMapPaintCell (VirtualScreen *vs, WorkSpace *ws)
+{
+    MapSubwindow *msw = vs->wsw->mswl [ws->number];
+    WinList	 wl, *list;
+    ColorPair	 cp;
+    XGCValues	 gcv;
+    XRectangle	 clip;
+    int		 width, height, bw, n, i;
+
+    msw->damaged = False;
+    width  = vs->wsw->wwidth  - 2;
+    height = vs->wsw->wheight - 2;
+    if (width < 1 || height < 1) return;
+    if (msw->pixmap == None || msw->pwidth != width || msw->pheight != height) {
+	if (msw->pixmap != None) XFreePixmap (dpy, msw->pixmap);
+	msw->pixmap  = XCreatePixmap (dpy, msw->w, width, height, Scr->d_depth);
+	msw->pwidth  = width;
+	msw->pheight = height;
+	XSetWindowBackgroundPixmap (dpy, msw->w, msw->pixmap);
+    }
+
+    if (msw->bgpixmap != None) {
+	gcv.fill_style  = FillTiled;
+	gcv.tile        = msw->bgpixmap;
+	gcv.ts_x_origin = 0;
+	gcv.ts_y_origin = 0;
+	XChangeGC (dpy, Scr->NormalGC,
+		   GCFillStyle | GCTile | GCTileStipXOrigin | GCTileStipYOrigin,
+		   &gcv);
+	XFillRectangle (dpy, msw->pixmap, Scr->NormalGC, 0, 0, width, height);
+	XSetFillStyle (dpy, Scr->NormalGC, FillSolid);
+    } else {
+	XSetForeground (dpy, Scr->NormalGC, msw->bgcolor);
+	XFillRectangle (dpy, msw->pixmap, Scr->NormalGC, 0, 0, width, height);
+    }
+
+    n = 0;
+    for (wl = msw->wl; wl != NULL; wl = wl->next) n++;
+    list = (WinList*) malloc ((n + 1) * sizeof (WinList));
+    if (list == NULL) return;
+    n = 0;
+    for (wl = msw->wl; wl != NULL; wl = wl->next) {
+	if (wl->shown) list [n++] = wl;
+    }
+    StackBottomWindow (Scr);
+    qsort (list, n, sizeof (WinList), WMapCompareRank);
+
+    bw = Scr->use3Dwmap ? 0 : 1;
+    for (i = 0; i < n; i++) {
+	wl = list [i];
+	if (bw) {
+	    XSetForeground (dpy, Scr->NormalGC, Scr->Black);
+	    XDrawRectangle (dpy, msw->pixmap, Scr->NormalGC,
+			    wl->x, wl->y, wl->width + 1, wl->height + 1);
+	}
+	clip.x      = wl->x + bw;
+	clip.y      = wl->y + bw;
+	clip.width  = wl->width;
+	clip.height = wl->height;
+	XSetForeground (dpy, Scr->NormalGC, wl->cp.back);
+	XFillRectangles (dpy, msw->pixmap, Scr->NormalGC, &clip, 1);
+	XSetClipRectangles (dpy, Scr->NormalGC, 0, 0, &clip, 1, YXBanded);
+	cp = wl->cp;
+	if (Scr->ReverseCurrentWorkspace && wl->wlist == vs->wsw->currentwspc) {
+	    InvertColorPair (&cp);
+	}
+	WMapDrawEntry (msw->pixmap, clip.x, clip.y, wl->width, wl->height,
+		       cp, wl->twm_win->icon_name);
+	XSetClipMask (dpy, Scr->NormalGC, None);
+    }
+    free (list);
+    XClearWindow (dpy, msw->w);
+}
+
+/*
+ * Called once per pass of the event loops : moves the small windows of
+ * the windows that moved since the last call, then repaints the damaged
+ * cells of flat maps.
+ */
+void WMapFlush (void)
+{
+    ScreenInfo    *savedScr = Scr;
+    VirtualScreen *vs;
+    WorkSpace     *ws;
+    TwmWindow     *win;
+    WinList       wl;
+    int           scrnum;
+
+    if (! WMapFlushNeeded) return;
+    for (scrnum = 0; scrnum < NumScreens; scrnum++) {
+	if ((Scr = ScreenList [scrnum]) == NULL) continue;
+	while ((win = Scr->workSpaceMgr.pending) != NULL) {
+	    Scr->workSpaceMgr.pending = win->wmapnext;
+	    win->wmapnext    = NULL;
+	    win->wmappending = False;
+	    for (wl = win->wmapentries; wl != NULL; wl = wl->wnext) {
+		if (Scr->FlatWorkSpaceMap)
+		    WMapDamage (wl->vs, wl->wlist);
+		else
+		    XMoveResizeWindow (dpy, wl->w, wl->x, wl->y, wl->width, wl->height);
+	    }
+	}
+	if (! Scr->FlatWorkSpaceMap) continue;
+	for (vs = Scr->vScreenList; vs != NULL; vs = vs->next) {
+	    if (vs->wsw == NULL || vs->wsw->mswl == NULL) continue;
+	    for (ws = Scr->workSpaceMgr.workSpaceList; ws != NULL; ws = ws->next) {
+		if (vs->wsw->mswl [ws->number]->damaged) WMapPaintCell (vs, ws);
+	    }
+	}
+    }
+    WMapFlushNeeded = False;
+    Scr = savedScr;
+}
+
 static void ResizeWorkSpaceManager (VirtualScreen *vs, TwmWindow *win)
 {
     int           bwidth, bheight;
@@ -3385,8 +3619,10 @@ static void ResizeWorkSpaceManager (VirtualScreen *vs, TwmWindow *win)
 	    wl->y      = (int) (tmp_win->frame_y * hf);
 	    wl->width  = (unsigned int) ((tmp_win->frame_width  * wf) + 0.5);
 	    wl->height = (unsigned int) ((tmp_win->frame_height * hf) + 0.5);
-	    XMoveResizeWindow (dpy, wl->w, wl->x, wl->y, wl->width, wl->height);
+	    if (!Scr->FlatWorkSpaceMap)
+		XMoveResizeWindow (dpy, wl->w, wl->x, wl->y, wl->width, wl->height);
 	}
+	WMapDamage (vs, ws);
 	i++;
 	if (i == columns) {i = 0; j++;};
     }
@@ -3546,8 +3782,16 @@ Bool AnimateRoot (void)
 
 	    if ((image == None) || (image->next == None)) continue;
 	    if (ws == vs->wsw->currentwspc) continue;
-	    XSetWindowBackgroundPixmap (dpy, vs->wsw->mswl [ws->number]->w, image->pixmap);
-	    XClearWindow (dpy, vs->wsw->mswl [ws->number]->w);
+	    if (scr->FlatWorkSpaceMap) {
+		ScreenInfo *savedScr = Scr;
+
+		Scr = scr;
+		WMapSetBackground (vs, ws, 0, image->pixmap);
+		Scr = savedScr;
+	    } else {
+		XSetWindowBackgroundPixmap (dpy, vs->wsw->mswl [ws->number]->w, image->pixmap);
+		XClearWindow (dpy, vs->wsw->mswl [ws->number]->w);
+	    }
 	    ws->image = image->next;
 	    maybeanimate = True;
 	  }
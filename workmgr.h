@@ -44,13 +44,16 @@
 
 struct winList {
     struct WorkSpace	*wlist;
-    Window		w;
+    struct VirtualScreen *vs;
+    Window		w;		/* None with FlatWorkSpaceMap */
+    Bool		shown;		/* drawn, with FlatWorkSpaceMap */
     int			x, y;
     int			width, height;
     TwmWindow		*twm_win;
     ColorPair		cp;
     MyFont		font;
     struct winList	*next;
+    struct winList	*wnext;		/* next entry of the same window */
 };
 
 struct WorkSpaceMgr {
@@ -83,6 +86,7 @@ struct WorkSpaceMgr {
     char	       *name;
     char	       *icon_name;
     int			switchWorkspacesOrdered;
+    TwmWindow		*pending;	/* windows whose map entries moved */
 };
 
 struct WorkSpace {
@@ -106,6 +110,13 @@ struct MapSubwindow {
   Window  w;
   int     x, y;
   WinList wl;
+  /* with FlatWorkSpaceMap, the cell is drawn in a pixmap set as the
+     background of w */
+  Pixmap  pixmap;
+  int     pwidth, pheight;
+  Pixel   bgcolor;
+  Pixmap  bgpixmap;
+  Bool    damaged;
 };
 
 struct ButtonSubwindow {
@@ -198,6 +209,7 @@ void WMapRaiseLower (TwmWindow *win);
 void WMapLower (TwmWindow *win);
 void WMapRaise (TwmWindow *win);
 void WMapRestack (WorkSpace *ws);
+void WMapFlush (void);
 void WMapUpdateIconName (TwmWindow *win);
 void WMgrHandleKeyReleaseEvent (VirtualScreen *vs, XEvent *event);
 void WMgrHandleKeyPressEvent (VirtualScreen *vs, XEvent *event);